@@ -0,0 +1,74 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "asyncScaler.h"
+
+#include <QtConcurrent/QtConcurrentRun>
+
+// return <image> scaled to <size> with <mode>
+static QImage scaledImage(const QImage& image, const QSize& size,
+                          Qt::TransformationMode mode) {
+
+  return image.scaled(size, Qt::IgnoreAspectRatio, mode);
+}
+
+void asyncScaler::scale(const QImage& image, const QSize& size,
+                        Qt::TransformationMode mode) {
+
+  pendingImage_ = image;
+  pendingSize_ = size;
+  pendingMode_ = mode;
+  havePending_ = true;
+  if (watcher_.isRunning()) {
+    // wait for it to finish, then start the newest request
+    runningWanted_ = false;
+  }
+  else {
+    startPending();
+  }
+}
+
+void asyncScaler::cancel() {
+
+  havePending_ = false;
+  pendingImage_ = QImage();
+  runningWanted_ = false;
+}
+
+void asyncScaler::startPending() {
+
+  havePending_ = false;
+  runningWanted_ = true;
+  watcher_.setFuture(QtConcurrent::run(::scaledImage, pendingImage_,
+                                       pendingSize_, pendingMode_));
+  // don't hold on to a copy of an image that may be replaced
+  pendingImage_ = QImage();
+}
+
+void asyncScaler::scaleFinished() {
+
+  if (runningWanted_ && watcher_.future().resultCount() > 0) {
+    runningWanted_ = false;
+    emit scaled(watcher_.future().result());
+  }
+  if (havePending_) {
+    startPending();
+  }
+}
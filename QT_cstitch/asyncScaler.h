@@ -0,0 +1,78 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef ASYNCSCALER_H
+#define ASYNCSCALER_H
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QObject>
+#include <QtCore/QSize>
+
+#include <QtGui/QImage>
+
+// asyncScaler scales images on a worker thread for a label that's being
+// zoomed.  At most one scale runs at a time: requests made while a scale
+// is running are coalesced (only the newest one is kept), and the running
+// scale's result is dropped instead of announced once a newer request
+// comes in, so a burst of wheel zooms costs at most two scales, not one
+// per wheel step.
+class asyncScaler : public QObject {
+
+  Q_OBJECT
+
+ public:
+  explicit asyncScaler(QObject* parent = NULL)
+    : QObject(parent), havePending_(false),
+      pendingMode_(Qt::SmoothTransformation), runningWanted_(false) {
+    connect(&watcher_, SIGNAL(finished()), this, SLOT(scaleFinished()));
+  }
+  // scale <image> to <size> with <mode>; scaled() is emitted with the
+  // result unless another request (or a cancel) comes in first
+  void scale(const QImage& image, const QSize& size,
+             Qt::TransformationMode mode = Qt::SmoothTransformation);
+  // forget the pending request and drop the running scale's result
+  void cancel();
+  // return true if a scale has been requested whose result hasn't been
+  // announced yet (and hasn't been canceled or superseded)
+  bool isBusy() const {
+    return havePending_ || (watcher_.isRunning() && runningWanted_);
+  }
+
+ signals:
+  void scaled(const QImage& image);
+
+ private slots:
+  void scaleFinished();
+
+ private:
+  // start the pending request
+  void startPending();
+
+ private:
+  QFutureWatcher<QImage> watcher_;
+  bool havePending_;
+  QImage pendingImage_;
+  QSize pendingSize_;
+  Qt::TransformationMode pendingMode_;
+  // false if the running scale has been superseded
+  bool runningWanted_;
+};
+
+#endif
@@ -0,0 +1,246 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "binaryUtility.h"
+
+#include <QtCore/QDataStream>
+
+#include "imageUtility.h"
+
+void writeVarint(QDataStream* stream, quint32 value) {
+
+  while (value >= 0x80) {
+    *stream << static_cast<quint8>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  *stream << static_cast<quint8>(value);
+}
+
+quint32 readVarint(QDataStream* stream) {
+
+  quint32 value = 0;
+  // at most five bytes for 32 bits
+  for (int shift = 0; shift < 35; shift += 7) {
+    quint8 byte = 0;
+    *stream >> byte;
+    if (stream->status() != QDataStream::Ok) {
+      return 0;
+    }
+    value |= static_cast<quint32>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+void writeBool(QDataStream* stream, bool b) {
+
+  *stream << static_cast<quint8>(b ? 1 : 0);
+}
+
+bool readBool(QDataStream* stream) {
+
+  quint8 b = 0;
+  *stream >> b;
+  return b != 0;
+}
+
+void writeRgb(QDataStream* stream, QRgb color) {
+
+  // drop alpha: square images are always opaque
+  *stream << static_cast<quint8>(qRed(color))
+          << static_cast<quint8>(qGreen(color))
+          << static_cast<quint8>(qBlue(color));
+}
+
+QRgb readRgb(QDataStream* stream) {
+
+  quint8 r = 0, g = 0, b = 0;
+  *stream >> r >> g >> b;
+  return qRgb(r, g, b);
+}
+
+void writeFlossType(QDataStream* stream, flossType type) {
+
+  *stream << static_cast<quint8>(type.value());
+}
+
+flossType readFlossType(QDataStream* stream) {
+
+  quint8 type = flossVariable;
+  *stream >> type;
+  if (type > flossVariable) {
+    return flossType(flossVariable);
+  }
+  return flossType(static_cast<flossTypeValue>(type));
+}
+
+void writeFlossColor(QDataStream* stream, const flossColor& color) {
+
+  ::writeRgb(stream, color.qrgb());
+  ::writeFlossType(stream, color.type());
+}
+
+flossColor readFlossColor(QDataStream* stream) {
+
+  const QRgb color = ::readRgb(stream);
+  return flossColor(color, ::readFlossType(stream));
+}
+
+void writeFlossSet(QDataStream* stream, const QSet<flossColor>& colors) {
+
+  ::writeVarint(stream, colors.size());
+  for (QSet<flossColor>::const_iterator it = colors.constBegin(),
+         end = colors.constEnd(); it != end; ++it) {
+    ::writeFlossColor(stream, *it);
+  }
+}
+
+QSet<flossColor> readFlossSet(QDataStream* stream) {
+
+  QSet<flossColor> returnSet;
+  const int size = ::readVarint(stream);
+  for (int i = 0; i < size && stream->status() == QDataStream::Ok; ++i) {
+    returnSet.insert(::readFlossColor(stream));
+  }
+  return returnSet;
+}
+
+void writeCoordinatesList(QDataStream* stream,
+                          const QVector<pairOfInts>& coordinates) {
+
+  ::writeVarint(stream, coordinates.size());
+  int lastX = 0;
+  int lastY = 0;
+  for (int i = 0, size = coordinates.size(); i < size; ++i) {
+    const pairOfInts& thisPair = coordinates[i];
+    ::writeSignedVarint(stream, thisPair.x() - lastX);
+    ::writeSignedVarint(stream, thisPair.y() - lastY);
+    lastX = thisPair.x();
+    lastY = thisPair.y();
+  }
+}
+
+QVector<pairOfInts> readCoordinatesList(QDataStream* stream) {
+
+  QVector<pairOfInts> returnList;
+  const int size = ::readVarint(stream);
+  returnList.reserve(size);
+  int x = 0;
+  int y = 0;
+  for (int i = 0; i < size && stream->status() == QDataStream::Ok; ++i) {
+    x += ::readSignedVarint(stream);
+    y += ::readSignedVarint(stream);
+    returnList.push_back(pairOfInts(x, y));
+  }
+  return returnList;
+}
+
+void writePixelList(QDataStream* stream, const QVector<pixel>& pixels) {
+
+  ::writeVarint(stream, pixels.size());
+  int lastX = 0;
+  int lastY = 0;
+  for (int i = 0, size = pixels.size(); i < size; ++i) {
+    const pixel& thisPixel = pixels[i];
+    ::writeSignedVarint(stream, thisPixel.x() - lastX);
+    ::writeSignedVarint(stream, thisPixel.y() - lastY);
+    ::writeRgb(stream, thisPixel.color());
+    lastX = thisPixel.x();
+    lastY = thisPixel.y();
+  }
+}
+
+QVector<pixel> readPixelList(QDataStream* stream) {
+
+  QVector<pixel> returnList;
+  const int size = ::readVarint(stream);
+  returnList.reserve(size);
+  int x = 0;
+  int y = 0;
+  for (int i = 0; i < size && stream->status() == QDataStream::Ok; ++i) {
+    x += ::readSignedVarint(stream);
+    y += ::readSignedVarint(stream);
+    returnList.push_back(pixel(::readRgb(stream), pairOfInts(x, y)));
+  }
+  return returnList;
+}
+
+void writeHistoryPixelList(QDataStream* stream,
+                           const QVector<historyPixel>& pixels) {
+
+  ::writeVarint(stream, pixels.size());
+  int lastX = 0;
+  int lastY = 0;
+  for (int i = 0, size = pixels.size(); i < size; ++i) {
+    const historyPixel& thisPixel = pixels[i];
+    ::writeSignedVarint(stream, thisPixel.x() - lastX);
+    ::writeSignedVarint(stream, thisPixel.y() - lastY);
+    ::writeRgb(stream, thisPixel.oldColor().qrgb());
+    ::writeRgb(stream, thisPixel.newColor().qrgb());
+    ::writeBool(stream, thisPixel.newColorIsNew());
+    lastX = thisPixel.x();
+    lastY = thisPixel.y();
+  }
+}
+
+QVector<historyPixel> readHistoryPixelList(QDataStream* stream) {
+
+  QVector<historyPixel> returnList;
+  const int size = ::readVarint(stream);
+  returnList.reserve(size);
+  int x = 0;
+  int y = 0;
+  for (int i = 0; i < size && stream->status() == QDataStream::Ok; ++i) {
+    x += ::readSignedVarint(stream);
+    y += ::readSignedVarint(stream);
+    const QRgb oldColor = ::readRgb(stream);
+    const QRgb newColor = ::readRgb(stream);
+    const bool newColorIsNew = ::readBool(stream);
+    returnList.push_back(historyPixel(pairOfInts(x, y), oldColor, newColor,
+                                      newColorIsNew));
+  }
+  return returnList;
+}
+
+void writeColorChangeList(QDataStream* stream,
+                          const QList<colorChange>& colorChanges) {
+
+  ::writeVarint(stream, colorChanges.size());
+  for (int i = 0, size = colorChanges.size(); i < size; ++i) {
+    ::writeRgb(stream, colorChanges[i].oldColor());
+    ::writeRgb(stream, colorChanges[i].newColor());
+    ::writeCoordinatesList(stream, colorChanges[i].coordinates());
+  }
+}
+
+QList<colorChange> readColorChangeList(QDataStream* stream) {
+
+  QList<colorChange> returnList;
+  const int size = ::readVarint(stream);
+  for (int i = 0; i < size && stream->status() == QDataStream::Ok; ++i) {
+    const QRgb oldColor = ::readRgb(stream);
+    const QRgb newColor = ::readRgb(stream);
+    returnList.push_back(colorChange(oldColor, newColor,
+                                     ::readCoordinatesList(stream)));
+  }
+  return returnList;
+}
@@ -0,0 +1,91 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef BINARYUTILITY_H
+#define BINARYUTILITY_H
+
+#include <QtCore/QVector>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+
+#include "triC.h"
+#include "floss.h"
+
+class pairOfInts;
+class pixel;
+class historyPixel;
+class colorChange;
+class QDataStream;
+
+// The binary counterparts of the xmlUtility list writers and readers.
+// They're used wherever history data has to be written often and read
+// back rarely (history spilling, the autosave journal), so they favor
+// size over readability: counts and coordinates are written as variable
+// length integers, and coordinates are written as deltas from the
+// previous coordinate on the list (tool histories list squares in
+// scan order, so most deltas fit in a single byte).
+
+// write <value> using 7 bits per byte, low bits first, with the high bit
+// of each byte set if more bytes follow
+void writeVarint(QDataStream* stream, quint32 value);
+quint32 readVarint(QDataStream* stream);
+
+// signed versions of the above (zig-zag encoded so that small negative
+// numbers stay small)
+inline void writeSignedVarint(QDataStream* stream, qint32 value) {
+  ::writeVarint(stream, (static_cast<quint32>(value) << 1) ^
+                static_cast<quint32>(value >> 31));
+}
+inline qint32 readSignedVarint(QDataStream* stream) {
+  const quint32 value = ::readVarint(stream);
+  return static_cast<qint32>(value >> 1) ^ -static_cast<qint32>(value & 1);
+}
+
+void writeBool(QDataStream* stream, bool b);
+bool readBool(QDataStream* stream);
+
+void writeRgb(QDataStream* stream, QRgb color);
+QRgb readRgb(QDataStream* stream);
+
+void writeFlossType(QDataStream* stream, flossType type);
+flossType readFlossType(QDataStream* stream);
+
+void writeFlossColor(QDataStream* stream, const flossColor& color);
+flossColor readFlossColor(QDataStream* stream);
+
+void writeFlossSet(QDataStream* stream, const QSet<flossColor>& colors);
+QSet<flossColor> readFlossSet(QDataStream* stream);
+
+void writeCoordinatesList(QDataStream* stream,
+                          const QVector<pairOfInts>& coordinates);
+QVector<pairOfInts> readCoordinatesList(QDataStream* stream);
+
+void writePixelList(QDataStream* stream, const QVector<pixel>& pixels);
+QVector<pixel> readPixelList(QDataStream* stream);
+
+void writeHistoryPixelList(QDataStream* stream,
+                           const QVector<historyPixel>& pixels);
+QVector<historyPixel> readHistoryPixelList(QDataStream* stream);
+
+void writeColorChangeList(QDataStream* stream,
+                          const QList<colorChange>& colorChanges);
+QList<colorChange> readColorChangeList(QDataStream* stream);
+
+#endif
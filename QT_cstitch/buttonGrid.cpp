@@ -26,6 +26,7 @@
 #include <QPainter>
 #include <QPen>
 #include <QMouseEvent>
+#include <QPaintEvent>
 //#include <QtWidgets/QDesktopWidget> 
 
 #include "triC.h"
@@ -44,14 +45,16 @@ buttonGrid::buttonGrid(const QVector<triC>& colors, int iconSize,
                        QWidget* parent)
   : QWidget(parent), gridX_(-1), gridY_(-1) {
 
-  QVector<QPixmap> colorPixmaps;
-  colorPixmaps.reserve(colors.size());
-  for (int i = 0, size = colors.size(); i < size; ++i) {
-    QPixmap pixmap(iconSize, iconSize);
-    pixmap.fill(colors[i].qc());
-    colorPixmaps.push_back(pixmap);
+  numButtons_ = colors.size();
+  swatchColors_.reserve(numButtons_);
+  for (int i = 0; i < numButtons_; ++i) {
+    swatchColors_.push_back(colors[i].qrgb());
   }
-  createSwatchGrid(colorPixmaps, windowTitle, buttonsPerRow);
+  swatchSize_ = iconSize;
+  buttonWidth_ = iconSize + 12;
+  buttonHeight_ = buttonWidth_;
+  createButtonFrame();
+  setGridDimensionsAndTitle(buttonsPerRow, windowTitle);
 }
 
 buttonGrid::buttonGrid(const QVector<floss>& flosses, flossType type, int iconSize,
@@ -71,32 +74,25 @@ int buttonGrid::getDescriptionWidth(const QString& text) {
   return metrics.horizontalAdvance(text);
 }
 
-void buttonGrid::createIconsDrawSwatches(const QVector<QPixmap>& swatches) {
+void buttonGrid::createButtonFrame() {
 
   const QPalette palette(QApplication::palette());
   const QColor windowColor(palette.color(QPalette::Window));
   const QColor darkColor(palette.color(QPalette::Dark));
-  for (int i = 0, size = swatches.size(); i < size; ++i) {
-    QPixmap pixmap(buttonWidth_, buttonHeight_);
-    pixmap.fill(windowColor);
-    QPainter painter(&pixmap);
-    painter.setPen(QPen(darkColor, 2));
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.drawPixmap(QPoint(6, 6), swatches[i]);
-    painter.drawRoundedRect(QRect(1, 1, buttonWidth_ - 2, buttonHeight_ - 2),
-                            3.5, 3.5);
-
-    icons_.push_back(pixmap);
-  }
+  buttonFrame_ = QPixmap(buttonWidth_, buttonHeight_);
+  buttonFrame_.fill(windowColor);
+  QPainter painter(&buttonFrame_);
+  painter.setPen(QPen(darkColor, 2));
+  painter.setRenderHint(QPainter::Antialiasing);
+  painter.drawRoundedRect(QRect(1, 1, buttonWidth_ - 2, buttonHeight_ - 2),
+                          3.5, 3.5);
 }
 
-void buttonGrid::addDescriptionsToIcons(const QVector<floss>& flosses,
-                                        int iconSize) {
+void buttonGrid::setDescriptions(const QVector<floss>& flosses) {
 
-  for (int i = 0, size = icons_.size(); i < size; ++i) {
+  descriptions_.reserve(flosses.size());
+  for (int i = 0, size = flosses.size(); i < size; ++i) {
     const floss thisFloss = flosses[i];
-    QPainter painter(&icons_[i]);
-    painter.setPen(descriptionsPen());
     QString flossDescription;
     if (thisFloss.code() > 0) {
       flossDescription = QString::number(thisFloss.code());
@@ -107,14 +103,14 @@ void buttonGrid::addDescriptionsToIcons(const QVector<floss>& flosses,
       }
       flossDescription += thisFloss.name();
     }
-    painter.drawText(QPoint(iconSize + 12, iconSize), flossDescription);
+    descriptions_.push_back(flossDescription);
   }
 }
 
 void buttonGrid::setGridDimensionsAndTitle(int buttonsPerRow,
                                            const QString& windowTitle) {
   
-  const int numIcons = icons_.size();
+  const int numIcons = numButtons_;
   buttonsPerRow_ = buttonsPerRow ? buttonsPerRow : ceil(sqrt(numIcons));
   if (buttonsPerRow == 0) {
     buttonsPerRow_ += buttonsPerRow_/4;
@@ -130,9 +126,12 @@ void buttonGrid::setGridDimensionsAndTitle(int buttonsPerRow,
 void buttonGrid::createSwatchGrid(const QVector<QPixmap>& swatches,
                                   const QString& windowTitle, int buttonsPerRow) {
 
-  buttonWidth_ = swatches.empty() ? 12 : swatches[0].width() + 12;
+  numButtons_ = swatches.size();
+  swatches_ = swatches;
+  swatchSize_ = swatches.empty() ? 0 : swatches[0].width();
+  buttonWidth_ = swatchSize_ + 12;
   buttonHeight_ = buttonWidth_;
-  createIconsDrawSwatches(swatches);
+  createButtonFrame();
   setGridDimensionsAndTitle(buttonsPerRow, windowTitle);
 }
 
@@ -157,38 +156,66 @@ void buttonGrid::createFlossGrid(const QVector<floss>& flosses, flossType type,
   buttonWidth_ = 6 + iconSize + 6 + descriptionLength + 6;
   buttonHeight_ = iconSize + 12;
 
-  QVector<QPixmap> icons;
-  icons.reserve(flosses.size());
-  for (int i = 0, size = flosses.size(); i < size; ++i) {
-    QPixmap pixmap(iconSize, iconSize);
-    pixmap.fill(flosses[i].color().qc());
-    icons.push_back(pixmap);
+  numButtons_ = flosses.size();
+  swatchColors_.reserve(numButtons_);
+  for (int i = 0; i < numButtons_; ++i) {
+    swatchColors_.push_back(flosses[i].color().qrgb());
   }
-  createIconsDrawSwatches(icons);
-  addDescriptionsToIcons(flosses, iconSize);
+  swatchSize_ = iconSize;
+  createButtonFrame();
+  setDescriptions(flosses);
   setGridDimensionsAndTitle(buttonsPerRow, windowTitle);
 }
 
 QSize buttonGrid::sizeHint() const {
 
-  int numRows = icons_.size()/buttonsPerRow_;
-  if (icons_.size() % buttonsPerRow_ != 0) {
+  int numRows = numButtons_/buttonsPerRow_;
+  if (numButtons_ % buttonsPerRow_ != 0) {
     ++numRows;
   }
   return QSize(buttonsPerRow_ * buttonWidth_,  numRows * buttonHeight_);
 }
 
-void buttonGrid::paintEvent(QPaintEvent* ) {
+void buttonGrid::drawButton(QPainter* painter, int index,
+                            const QPoint& corner) const {
+
+  painter->drawPixmap(corner, buttonFrame_);
+  const QPoint swatchCorner = corner + QPoint(6, 6);
+  if (!swatches_.isEmpty()) {
+    painter->drawPixmap(swatchCorner, swatches_[index]);
+  }
+  else {
+    painter->fillRect(QRect(swatchCorner, QSize(swatchSize_, swatchSize_)),
+                      QColor(swatchColors_[index]));
+  }
+  if (!descriptions_.isEmpty()) {
+    painter->drawText(corner + QPoint(swatchSize_ + 12, swatchSize_),
+                      descriptions_[index]);
+  }
+}
+
+void buttonGrid::paintEvent(QPaintEvent* event) {
 
-  int i = 0, j = 0;
+  if (numButtons_ == 0) {
+    return;
+  }
+  // only draw the buttons that intersect the exposed rectangle
+  const QRect exposed = event->rect();
+  const int firstColumn = qMax(exposed.left()/buttonWidth_, 0);
+  const int lastColumn = qMin(exposed.right()/buttonWidth_,
+                              buttonsPerRow_ - 1);
+  const int firstRow = qMax(exposed.top()/buttonHeight_, 0);
+  const int lastRow = qMin(exposed.bottom()/buttonHeight_,
+                           (numButtons_ - 1)/buttonsPerRow_);
   QPainter painter(this);
-  for (int k = 0, size = icons_.size(); k < size; ++k) {
-    painter.drawPixmap(QPoint(i*buttonWidth_, j*buttonHeight_),
-                       icons_[k]);
-    ++i;
-    if (i == buttonsPerRow_) {
-      i = 0;
-      ++j;
+  painter.setPen(descriptionsPen());
+  for (int j = firstRow; j <= lastRow; ++j) {
+    for (int i = firstColumn; i <= lastColumn; ++i) {
+      const int index = j*buttonsPerRow_ + i;
+      if (index >= numButtons_) {
+        break;
+      }
+      drawButton(&painter, index, QPoint(i*buttonWidth_, j*buttonHeight_));
     }
   }
   if (gridX_ >= 0) { // if a button has been chosen, highlight it
@@ -208,7 +235,7 @@ void buttonGrid::mousePressEvent(QMouseEvent* event) {
     gridX_ = event->x()/buttonWidth_;
     gridY_ = event->y()/buttonHeight_;
     const int index = gridY_ * buttonsPerRow() + gridX_;
-    if (index >= icons_.size() || index < 0) {
+    if (index >= numButtons_ || index < 0) {
       return;
     }
     emit buttonSelected(index);
@@ -218,7 +245,7 @@ void buttonGrid::mousePressEvent(QMouseEvent* event) {
 
 pairOfInts buttonGrid::getMaxGridCoordinates() const {
 
-  const int computationLength = icons_.size() - 1;
+  const int computationLength = numButtons_ - 1;
   return pairOfInts(computationLength % buttonsPerRow_,
                     computationLength / buttonsPerRow_);
 }
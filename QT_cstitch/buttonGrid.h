@@ -23,11 +23,13 @@
 
 #include <QtWidgets/QWidget>
 #include <QPen>
+#include <QPixmap>
 
 #include "triC.h"
 #include "floss.h"
 
 class pairOfInts;
+class QPainter;
 
 //
 // buttonGrid is a widget that displays a grid of "buttons" with icons provided
@@ -35,6 +37,12 @@ class pairOfInts;
 // the index of the button, where index is the 0-based sequence number of the
 // symbol from the original list of symbols
 //
+// The grid is a single widget that paints its buttons itself: a paint event
+// only draws the buttons it exposes (so in a scroll area only the visible
+// ones), each one as a shared button frame plus that button's swatch (and
+// description, for flosses), and clicks are mapped to buttons
+// arithmetically.
+//
 class buttonGrid : public QWidget {
 
   Q_OBJECT
@@ -67,9 +75,12 @@ class buttonGrid : public QWidget {
   // either flossDMC or flossAnchor
   void createFlossGrid(const QVector<floss>& flosses, flossType type,
                        const QString& windowTitle, int iconSize, int buttonsPerRow);
-  void createIconsDrawSwatches(const QVector<QPixmap>& swatches);
-  void addDescriptionsToIcons(const QVector<floss>& flosses, int iconSize);
+  // draw the frame every button shares into buttonFrame_
+  void createButtonFrame();
+  void setDescriptions(const QVector<floss>& flosses);
   void setGridDimensionsAndTitle(int buttonsPerRow, const QString& windowTitle);
+  // draw button <index> with its top left corner at <corner>
+  void drawButton(QPainter* painter, int index, const QPoint& corner) const;
   QPen descriptionsPen() const { return QPen(Qt::black, 4); }
   // return the width of <text> in the font we'd use for writing floss descriptions
   int getDescriptionWidth(const QString& text);
@@ -84,7 +95,13 @@ class buttonGrid : public QWidget {
   void buttonSelected(int index);
 
  private:
-  QVector<QPixmap> icons_;
+  int numButtons_;
+  // the button swatches are either pixmaps or solid colors
+  QVector<QPixmap> swatches_;
+  QVector<QRgb> swatchColors_;
+  int swatchSize_; // width and height of a swatch
+  QVector<QString> descriptions_; // floss descriptions, if any
+  QPixmap buttonFrame_; // the background and border of every button
   int buttonHeight_; // height of buttons in the grid
   int buttonWidth_; // width of buttons in the grid
   int buttonsPerRow_; // number of buttons per row in the grid
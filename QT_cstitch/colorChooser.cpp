@@ -396,22 +396,19 @@ void colorChooser::displayImageInfo() {
   displayOriginalImageInfo(imageLabel_->width(), imageLabel_->height());
 }
 
-int colorChooser::recreateImage(const colorCompareSaver& saver) {
+int colorChooser::recreateImage(const colorCompareSaver& saver,
+                                const QImage& restoredImage) {
 
   // set the widget's current processing mode box
   setModeBox(processMode_.savedModeTextToLocale(saver.creationMode()));
 
-  QImage workingImage = winManager()->originalImage().copy();
-  if (workingImage.isNull()) {
+  if (restoredImage.isNull()) {
     qWarning() << "Empty image in recreateImage.";
     return -1;
   }
-  workingImage = workingImage.convertToFormat(QImage::Format_RGB32);
   // we don't need to do processMode_.performProcessing since we already
   // have the color list it would produce
-  processMode_.restoreSavedImage(&workingImage, saver.colors(),
-                                 winManager()->getOriginalImageColorCount());
-  winManager()->addColorCompareImage(workingImage,
+  winManager()->addColorCompareImage(restoredImage,
                                      saver.colors(),
                                      processMode_.flossMode(),
                                      saver,
@@ -419,6 +416,15 @@ int colorChooser::recreateImage(const colorCompareSaver& saver) {
   return saver.hidden() ? saver.index() : -1;
 }
 
+void colorChooser::recreateLazyImage(const colorCompareSaver& saver,
+                                     int numImageColors) {
+
+  setModeBox(processMode_.savedModeTextToLocale(saver.creationMode()));
+  winManager()->addLazyColorCompareImage(saver.colors(),
+                                         processMode_.flossMode(), saver,
+                                         saver.index(), numImageColors);
+}
+
 void colorChooser::setModeBox(const QString& mode) {
 
   for (int i = 0, size = processModeBox_->count(); i < size; ++i) {
@@ -78,9 +78,16 @@ class colorChooser : public imageZoomWindow {
   explicit colorChooser(windowManager* winMgr);
   // reset colorChooser to use the new <image>
   void setNewImage(const QImage& image);
-  // recreate a colorCompare image using the data in <saver> as part of a
-  // project restore
-  int recreateImage(const colorCompareSaver& saver);
+  // recreate a colorCompare image using the data in <saver> and the
+  // already segmented <restoredImage> as part of a project restore.
+  // Returns the saver's index if the image is only needed to restore its
+  // children (and should be removed afterwards), else -1
+  int recreateImage(const colorCompareSaver& saver,
+                    const QImage& restoredImage);
+  // like recreateImage, but leave the segmenting of the image until it's
+  // first viewed; <numImageColors> is the number of colors in the original
+  // image, if known
+  void recreateLazyImage(const colorCompareSaver& saver, int numImageColors);
   void appendCurrentSettings(QDomDocument* doc,
                              QDomElement* appendee) const; //override
   QString updateCurrentSettings(const QDomElement& xml); //override
@@ -38,6 +38,7 @@
 #include "helpBrowser.h"
 #include "dimensionComputer.h"
 #include "xmlUtility.h"
+#include "projectRestore.h"
 
 // min/max user-selectable square sizes
 extern const int SQUARE_SIZE_MIN = 1;
@@ -217,99 +218,103 @@ void colorCompare::changeProcessMode(int squareBoxIndex) {
   squareMode_ = squareModeBox_->itemData(squareBoxIndex).toInt();
 }
 
-void colorCompare::processSquareButton(imagePtr container,
-                                       QString squareModeString,
-                                       int squareSize, int newIndex) {
+void colorCompare::processSquareButton() {
 
-  int squareMode = squareMode_;
-  if (!container) { // user pushed the process button
-    container = curImage_;
-    squareSize = squareSizeBox_->value();
+  const imagePtr container = curImage_;
+  if (!container) {
+    return;
   }
-  else { // doing a restore
-    // The saved mode string should always have been the enumeration value
-    // instead of the UI string, but for backwards compatibility we'll deal with
-    // it as it is.
-    if (squareModeString == "median") {
-      squareMode = SQ_MEDIAN;
-    }
-    else if (squareModeString == "mode") {
-      squareMode = SQ_MODE;
-    }
-    else {
-      qWarning() << "Unrecognized squareModeString: \"" << squareModeString << 
-        "\", index: " << newIndex << "; things probably won't go well from here.";
-      return;
-    }
+  const int squareSize = squareSizeBox_->value();
+  QVector<triC> colorsUsed;
+  const QImage newImage = squareImage(container->image(), originalImage(),
+                                      squareMode_, squareSize, &colorsUsed);
+  if (newImage.isNull()) {
+    return;
   }
 
-  if (container) {
-    QImage newImage;
-    QVector<triC> colorsUsed;
-    switch(squareMode) {
-    case SQ_MEDIAN:
-    {
-      squareModeString = "median";
-      grid newGrid(container->image());
-      if (newGrid.empty()) {
-        qWarning() << "Empty grid in process square:" <<
-          container->originalWidth() << container->originalHeight();
-        return;
-      }
-      //qDebug() << "to grid time:" << double(t.elapsed())/1000.;
-      colorsUsed = ::median(&newGrid, grid(originalImage()),
-                            squareSize);
-      //qDebug() << "median time:" << double(t.elapsed())/1000.;
-      if (!colorsUsed.empty()) {
-        newImage = newGrid.toImage();
-        if (newImage.isNull()) {
-          qWarning() << "Empty image in process square" <<
-            newGrid.width() << newGrid.height();
-          return;
-        }
-        //qDebug() << "to QImage time: " << double(t.elapsed())/1000.;
-      }
-      else { // processing was cancelled
-        return;
-      }
-      break;
-    }
-    case SQ_MODE:
-    {
-      squareModeString = "mode";
-      newImage = container->image();
-      colorsUsed = ::mode(&newImage, squareSize);
-      //qDebug() << "mode time: " << double(t.elapsed())/1000.;
-      break;
-    }
-    default:
-    {
-      qWarning() << "Square mode error:" << squareMode_;
-      return;
-    }
-    }
+  const QString squareModeString = (squareMode_ == SQ_MEDIAN) ? "median" :
+    "mode";
+  const int parentIndex = imageNameToIndex(container->name());
+  const squareWindowSaver saver(-1, parentIndex, squareModeString, squareSize);
+  winManager()->addSquareWindow(newImage, squareSize, colorsUsed,
+                                container->flossMode(), saver, parentIndex);
+}
+
+int colorCompare::savedSquareMode(const QString& squareModeString) {
+
+  // The saved mode string should always have been the enumeration value
+  // instead of the UI string, but for backwards compatibility we'll deal with
+  // it as it is.
+  if (squareModeString == "median") {
+    return SQ_MEDIAN;
+  }
+  else if (squareModeString == "mode") {
+    return SQ_MODE;
+  }
+  else {
+    return -1;
+  }
+}
 
-    // only keep full squares on the new image; this may decrease the size
-    // of the image from the original
-    const int width = container->originalWidth();
-    const int height = container->originalHeight();
-    const int newWidth = (width/squareSize)*squareSize;
-    const int newHeight = (height/squareSize)*squareSize;
-    if (width != newWidth || height != newHeight) {
-      newImage = newImage.copy(0, 0, newWidth, newHeight);
+QImage colorCompare::squareImage(const QImage& image,
+                                 const QImage& originalImage,
+                                 int squareMode, int squareSize,
+                                 QVector<triC>* colorsUsed) {
+
+  QImage newImage;
+  switch(squareMode) {
+  case SQ_MEDIAN:
+  {
+    grid newGrid(image);
+    if (newGrid.empty()) {
+      qWarning() << "Empty grid in process square:" <<
+        image.width() << image.height();
+      return QImage();
     }
-    if (newImage.isNull()) {
-      qWarning() << "Empty image in process square copy.";
-      return;
+    //qDebug() << "to grid time:" << double(t.elapsed())/1000.;
+    *colorsUsed = ::median(&newGrid, grid(originalImage), squareSize);
+    //qDebug() << "median time:" << double(t.elapsed())/1000.;
+    if (!colorsUsed->empty()) {
+      newImage = newGrid.toImage();
+      if (newImage.isNull()) {
+        qWarning() << "Empty image in process square" <<
+          newGrid.width() << newGrid.height();
+        return QImage();
+      }
+      //qDebug() << "to QImage time: " << double(t.elapsed())/1000.;
+    }
+    else { // processing was cancelled
+      return QImage();
     }
+    break;
+  }
+  case SQ_MODE:
+  {
+    newImage = image;
+    *colorsUsed = ::mode(&newImage, squareSize);
+    //qDebug() << "mode time: " << double(t.elapsed())/1000.;
+    break;
+  }
+  default:
+  {
+    qWarning() << "Square mode error:" << squareMode;
+    return QImage();
+  }
+  }
 
-    const int parentIndex = imageNameToIndex(container->name());
-    const squareWindowSaver saver(newIndex, parentIndex,
-                                  squareModeString, squareSize);
-    winManager()->addSquareWindow(newImage, squareSize, colorsUsed,
-                                  container->flossMode(), saver,
-                                  parentIndex, newIndex);
+  // only keep full squares on the new image; this may decrease the size
+  // of the image from the original
+  const int width = image.width();
+  const int height = image.height();
+  const int newWidth = (width/squareSize)*squareSize;
+  const int newHeight = (height/squareSize)*squareSize;
+  if (width != newWidth || height != newHeight) {
+    newImage = newImage.copy(0, 0, newWidth, newHeight);
+  }
+  if (newImage.isNull()) {
+    qWarning() << "Empty image in process square copy.";
   }
+  return newImage;
 }
 
 QImage colorCompare::curImageForSaving() const {
@@ -354,21 +359,42 @@ void colorCompare::imageDeleted(int imageIndex) {
   winManager()->colorCompareImageDeleted(imageIndex);
 }
 
-int colorCompare::recreateImage(const squareWindowSaver& saver) {
+int colorCompare::recreateImage(const squareWindowSaver& saver,
+                                const QImage& squaredImage,
+                                const QVector<triC>& colors) {
 
   imagePtr thisImage = getImageFromIndex(saver.parentIndex());
-  if (thisImage) {
-    processSquareButton(thisImage, saver.creationMode(),
-                        saver.squareDimension(), saver.index());
-  }
-  else {
+  if (!thisImage) {
     qWarning() << "Lost image in colorCompare::recreateImage:" <<
       saver.parentIndex();
     return -1;
   }
+  if (squaredImage.isNull()) {
+    qWarning() << "Empty image in colorCompare::recreateImage:" <<
+      saver.index();
+    return -1;
+  }
+  winManager()->addSquareWindow(squaredImage, saver.squareDimension(),
+                                colors, thisImage->flossMode(), saver,
+                                saver.parentIndex(), saver.index());
   return saver.hidden() ? saver.index() : -1;
 }
 
+void colorCompare::addLazyImage(int index, const QVector<triC>& colors,
+                                flossType type, int numImageColors) {
+
+  const QString imageName = imageNameFromIndex(index);
+  const imagePtr container =
+    new lazySegmentedImageContainer(imageName, originalImage(), colors, type,
+                                    numImageColors);
+  QAction* leftAction = new QAction(imageName, this);
+  leftAction->setData(QVariant::fromValue(container));
+  addLeftImageMenuAction(leftAction);
+  QAction* rightAction = new QAction(imageName, this);
+  rightAction->setData(QVariant::fromValue(container));
+  addRightImageMenuAction(rightAction);
+}
+
 void colorCompare::appendCurrentSettings(QDomDocument* doc,
                                          QDomElement* appendee) const {
 
@@ -399,7 +425,7 @@ helpMode colorCompare::getHelpMode() const {
 }
 
 void colorCompare::updateImageLabelImage() {
-  activeImageLabel()->updateImage(QPixmap::fromImage(curImage_->image()));
+  activeImageLabel()->updateImage(curImage_->pyramid());
 }
 
 // these are here just so we don't have to include imageLabel.h in
@@ -92,9 +92,33 @@ class colorCompare : public imageCompareBase {
   // Index must be unique among all other such indices.
   void addImage(const QImage& image, int index,
                 const QVector<triC>& colors, flossType type);
-  // recreate a square image using the data in <saver> as part of a project
-  // restore
-  int recreateImage(const squareWindowSaver& saver);
+  // add the square image <squaredImage> (with <colors>) described by
+  // <saver> as part of a project restore; <squaredImage> was computed
+  // from the saver's parent by squareImage.
+  // Returns the saver's index if the image is only needed to restore its
+  // children (and should be removed afterwards), else -1
+  int recreateImage(const squareWindowSaver& saver,
+                    const QImage& squaredImage,
+                    const QVector<triC>& colors);
+  // like addImage, but the image is the original segmented against
+  // <colors> and isn't computed until it's first viewed (see
+  // lazySegmentedImageContainer); the new image is not made current.
+  // <numImageColors> is the number of colors in the original image, if
+  // known
+  void addLazyImage(int index, const QVector<triC>& colors, flossType type,
+                    int numImageColors);
+  // return the square mode enumeration value for the saved mode string
+  // <squareModeString>, or -1 if the string isn't recognized
+  static int savedSquareMode(const QString& squareModeString);
+  // square <image> into squares of dimension <squareSize> using
+  // <squareMode> (<originalImage> is the unprocessed original, needed by
+  // median), keeping only full squares, and put the colors used on
+  // <colorsUsed>.
+  // Returns a null image on error or cancel.
+  // Safe to call off of the gui thread.
+  static QImage squareImage(const QImage& image, const QImage& originalImage,
+                            int squareMode, int squareSize,
+                            QVector<triC>* colorsUsed);
   void appendCurrentSettings(QDomDocument* doc,
                              QDomElement* appendee) const; //override;
   QString updateCurrentSettings(const QDomElement& xml); //override;
@@ -143,9 +167,7 @@ class colorCompare : public imageCompareBase {
   // process the current image (if any) based on the current square
   // dimension and square mode, and pass the new squared image to the
   // window manager for addition to squareWindow.
-  void processSquareButton(imagePtr container = imagePtr(NULL),
-                           QString squareModeString = "",
-                           int squareSize = 0, int newIndex = -1);
+  void processSquareButton();
   // process a mouse move on the left side of the splitter
   void processLeftMouseMove(QMouseEvent* event);
   // process a mouse move on the right side of the splitter
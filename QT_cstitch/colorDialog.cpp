@@ -24,6 +24,7 @@
 #include <QtCore/qmath.h>
 #include <QtCore/QDebug>
 #include <QtCore/QSettings>
+#include <QtCore/QCache>
 
 #include <QtWidgets/QScrollArea>
 #include <QtWidgets/QVBoxLayout>
@@ -51,6 +52,31 @@ class triCDistanceSort {
   const triC color_;
 };
 
+// sort <colors>, one of the fixed floss palettes of <type>, by distance
+// from <inputColor>.  The sort orders are kept (for the last few input
+// colors of each type) so that reopening the dialog on a color doesn't
+// sort the whole palette again.
+static QVector<triC> paletteByDistance(const QVector<triC>& colors,
+                                       const triC& inputColor,
+                                       flossType type) {
+
+  // values are (the palette sorted, the sorted palette)
+  typedef QPair<QVector<triC>, QVector<triC> > sortedPalette;
+  static QCache<QPair<int, QRgb>, sortedPalette> sortedPalettes(16);
+
+  const QPair<int, QRgb> key(type.value(), inputColor.qrgb());
+  const sortedPalette* cachedPalette = sortedPalettes.object(key);
+  // (the dmc palette depends on a setting, so check it's the same one)
+  if (cachedPalette && cachedPalette->first == colors) {
+    return cachedPalette->second;
+  }
+  QVector<triC> sortedColors(colors);
+  std::sort(sortedColors.begin(), sortedColors.end(),
+            triCDistanceSort(inputColor));
+  sortedPalettes.insert(key, new sortedPalette(colors, sortedColors));
+  return sortedColors;
+}
+
 void baseDialogMode::constructGrid(QVBoxLayout* dialogLayout, int colorsPerRow,
                                    const QVector<triC>& colors,
                                    QWidget* parent) {
@@ -161,7 +187,7 @@ colorsBaseDialogMode::colorsBaseDialogMode(QVBoxLayout* dialogLayout,
 
   int colorsPerRow = qMax(static_cast<int>(ceil(sqrt(colorList.size()))), 10);
   colorsPerRow += colorsPerRow/4;
-  std::sort(colorList.begin(), colorList.end(), triCDistanceSort(inputColor));
+  colorList = ::paletteByDistance(colorList, inputColor, type);
   constructGrid(dialogLayout, colorsPerRow, colorList, parent);
   disable();
 }
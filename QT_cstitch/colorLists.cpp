@@ -387,6 +387,83 @@ QRgb closestMatch(const triC& color, const QList<QRgb>& colorList) {
   return colorList[chosenIndex];
 }
 
+paletteIndex::paletteIndex(const QList<QRgb>& colors)
+  : colors_(colors),
+    cells_(CELLS_PER_CHANNEL*CELLS_PER_CHANNEL*CELLS_PER_CHANNEL) {
+
+  orders_.reserve(colors_.size());
+  for (int i = 0, size = colors_.size(); i < size; ++i) {
+    const triC thisColor(colors_[i]);
+    orders_.push_back(::getColorOrder(thisColor));
+    cells_[cellIndex(thisColor.r()/CELL_WIDTH, thisColor.g()/CELL_WIDTH,
+                     thisColor.b()/CELL_WIDTH)].push_back(i);
+  }
+}
+
+QRgb paletteIndex::closestMatch(const triC& color) const {
+
+  // as in ::closestMatch: a near color of the same order wins, otherwise
+  // just the closest color
+  const colorOrder desiredOrder = ::getColorOrder(color);
+  int chosenIndex = search(color, 100, true, desiredOrder);
+  if (chosenIndex == -1) {
+    chosenIndex = search(color, D_MAX, false, desiredOrder);
+  }
+  return (chosenIndex != -1) ? colors_[chosenIndex] : colors_.value(0);
+}
+
+int paletteIndex::search(const triC& color, int bound, bool sameOrderOnly,
+                         colorOrder order) const {
+
+  const int r = color.r();
+  const int g = color.g();
+  const int b = color.b();
+  const int cellR = r/CELL_WIDTH;
+  const int cellG = g/CELL_WIDTH;
+  const int cellB = b/CELL_WIDTH;
+  int min = bound;
+  int chosenIndex = -1;
+  for (int shell = 0; shell < CELLS_PER_CHANNEL; ++shell) {
+    // every color in this shell is at least this far from color (along
+    // the axis on which its cell is shell cells away)
+    const int shellDistance = (shell == 0) ? 0 : (shell - 1)*CELL_WIDTH + 1;
+    if (shellDistance > min) {
+      break;
+    }
+    for (int i = qMax(cellR - shell, 0),
+           iEnd = qMin(cellR + shell, CELLS_PER_CHANNEL - 1); i <= iEnd; ++i) {
+      for (int j = qMax(cellG - shell, 0),
+             jEnd = qMin(cellG + shell, CELLS_PER_CHANNEL - 1);
+           j <= jEnd; ++j) {
+        for (int k = qMax(cellB - shell, 0),
+               kEnd = qMin(cellB + shell, CELLS_PER_CHANNEL - 1);
+             k <= kEnd; ++k) {
+          if (qMax(qMax(qAbs(i - cellR), qAbs(j - cellG)),
+                   qAbs(k - cellB)) != shell) {
+            continue; // not on this shell
+          }
+          const QVector<int>& cell = cells_[cellIndex(i, j, k)];
+          for (int c = 0, size = cell.size(); c < size; ++c) {
+            const int index = cell[c];
+            if (sameOrderOnly && orders_[index] != order) {
+              continue;
+            }
+            const int thisD = ::ds(color, colors_[index]);
+            // (ties go to the first color on the list, as in
+            // ::closestMatch)
+            if (thisD < min ||
+                (thisD == min && chosenIndex != -1 && index < chosenIndex)) {
+              min = thisD;
+              chosenIndex = index;
+            }
+          }
+        }
+      }
+    }
+  }
+  return chosenIndex;
+}
+
 QVector<int> rgbToCode(const QVector<flossColor>& colors) {
 
   QVector<int> returnCodes;
@@ -200,6 +200,39 @@ bool colorsAreDmc(const QVector<triC>& colors);
 // Return the color in <colorList> that is (Euclidean) closest to <color>.
 QRgb closestMatch(const triC& color, const QList<QRgb>& colorList);
 
+// paletteIndex answers ::closestMatch queries against a fixed color list
+// without comparing each query with every color on the list: the colors
+// are bucketed on a coarse rgb grid, and a query searches outwards from
+// its own cell a shell of cells at a time, stopping once no cell left
+// can hold a closer color.  Answers (ties included) are the same as
+// ::closestMatch(color, colors).
+class paletteIndex {
+ public:
+  paletteIndex() {}
+  explicit paletteIndex(const QList<QRgb>& colors);
+  bool isEmpty() const { return colors_.isEmpty(); }
+  QRgb closestMatch(const triC& color) const;
+
+ private:
+  // return the index on colors_ of the color closest to <color> and
+  // closer than <bound> (of <order> only, if <sameOrderOnly>), or -1
+  int search(const triC& color, int bound, bool sameOrderOnly,
+             colorOrder order) const;
+  // return the grid cell index for cell coordinates (<r>, <g>, <b>)
+  static int cellIndex(int r, int g, int b) {
+    return (r*CELLS_PER_CHANNEL + g)*CELLS_PER_CHANNEL + b;
+  }
+
+ private:
+  static const int CELL_WIDTH = 32;
+  static const int CELLS_PER_CHANNEL = 256/CELL_WIDTH;
+  QList<QRgb> colors_;
+  QVector<colorOrder> orders_; // the color order of each of colors_
+  // for each cell, the indices on colors_ of the colors in that cell, in
+  // increasing order
+  QVector<QVector<int> > cells_;
+};
+
 // return the DMC color closest to <color>
 triC rgbToDmc(const triC& color);
 triC rgbToAnchor(const triC& color);
@@ -0,0 +1,181 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "colorSquareIndex.h"
+
+#include <algorithm>
+
+#include <QtGui/QImage>
+
+#include "imageUtility.h"
+
+colorSquareIndex::colorSquareIndex(const QImage& image, int dimension)
+  : xSquareCount_(image.width()/dimension),
+    ySquareCount_(image.height()/dimension), dimension_(dimension) {
+
+  const QImage source = (image.depth() == 32) ? image :
+    image.convertToFormat(QImage::Format_RGB32);
+  squareColors_.resize(xSquareCount_ * ySquareCount_);
+  // the runs of the previous square's color
+  colorRuns* currentRuns = NULL;
+  QRgb currentColor = 0;
+  for (int j = 0; j < ySquareCount_; ++j) {
+    const QRgb* line =
+      reinterpret_cast<const QRgb*>(source.constScanLine(j*dimension_));
+    for (int i = 0; i < xSquareCount_; ++i) {
+      const int index = j*xSquareCount_ + i;
+      const QRgb color = line[i*dimension_];
+      squareColors_[index] = color;
+      if (!currentRuns || color != currentColor) {
+        currentRuns = &runs_[color];
+        currentColor = color;
+      }
+      appendRun(&currentRuns->runs_, index, 1);
+      ++currentRuns->count_;
+    }
+  }
+}
+
+QHash<QRgb, int> colorSquareIndex::counts() const {
+
+  QHash<QRgb, int> returnCounts;
+  returnCounts.reserve(runs_.size());
+  for (QHash<QRgb, colorRuns>::const_iterator it = runs_.constBegin(),
+         end = runs_.constEnd(); it != end; ++it) {
+    returnCounts[it.key()] = it->count_;
+  }
+  return returnCounts;
+}
+
+QVector<pairOfInts> colorSquareIndex::squares(QRgb color) const {
+
+  QVector<pairOfInts> returnSquares;
+  const QHash<QRgb, colorRuns>::const_iterator it = runs_.constFind(color);
+  if (it == runs_.constEnd()) {
+    return returnSquares;
+  }
+  returnSquares.reserve(it->count_);
+  const QVector<squareRun>& runs = it->runs_;
+  for (int r = 0, size = runs.size(); r < size; ++r) {
+    for (int index = runs[r].start_, end = index + runs[r].length_;
+         index < end; ++index) {
+      returnSquares.push_back(pairOfInts(index % xSquareCount_,
+                                         index / xSquareCount_));
+    }
+  }
+  return returnSquares;
+}
+
+void colorSquareIndex::update(const QImage& image,
+                              const QVector<QRect>& squares) {
+
+  if (isNull()) {
+    return;
+  }
+  // the squares each color gained and lost
+  QHash<QRgb, QVector<int> > added;
+  QHash<QRgb, QVector<int> > removed;
+  for (int r = 0, size = squares.size(); r < size; ++r) {
+    const QRect run = squares[r].intersected(QRect(0, 0, xSquareCount_,
+                                                   ySquareCount_));
+    for (int j = run.top(); j <= run.bottom(); ++j) {
+      for (int i = run.left(); i <= run.right(); ++i) {
+        const int index = j*xSquareCount_ + i;
+        const QRgb newColor = image.pixel(i*dimension_, j*dimension_);
+        const QRgb oldColor = squareColors_[index];
+        if (newColor != oldColor) {
+          removed[oldColor].push_back(index);
+          added[newColor].push_back(index);
+          squareColors_[index] = newColor;
+        }
+      }
+    }
+  }
+  // merge each changed color's squares (a square changes at most once,
+  // since a later visit reads the color it was changed to, so no color
+  // both gains and loses the same square)
+  QHash<QRgb, QVector<int> > changedColors = added;
+  for (QHash<QRgb, QVector<int> >::const_iterator it = removed.constBegin(),
+         end = removed.constEnd(); it != end; ++it) {
+    changedColors.insert(it.key(), QVector<int>());
+  }
+  for (QHash<QRgb, QVector<int> >::const_iterator
+         it = changedColors.constBegin(), end = changedColors.constEnd();
+       it != end; ++it) {
+    QVector<int> colorAdded = added.value(it.key());
+    QVector<int> colorRemoved = removed.value(it.key());
+    std::sort(colorAdded.begin(), colorAdded.end());
+    std::sort(colorRemoved.begin(), colorRemoved.end());
+    mergeSquares(it.key(), colorAdded, colorRemoved);
+  }
+}
+
+void colorSquareIndex::appendRun(QVector<squareRun>* runs, int start,
+                                 int length) {
+
+  if (length <= 0) {
+    return;
+  }
+  if (!runs->isEmpty()) {
+    squareRun& lastRun = runs->last();
+    if (lastRun.start_ + lastRun.length_ == start) {
+      lastRun.length_ += length;
+      return;
+    }
+  }
+  runs->push_back(squareRun(start, length));
+}
+
+void colorSquareIndex::mergeSquares(QRgb color, const QVector<int>& added,
+                                    const QVector<int>& removed) {
+
+  colorRuns& colorEntry = runs_[color];
+  const QVector<squareRun>& oldRuns = colorEntry.runs_;
+  QVector<squareRun> newRuns;
+  newRuns.reserve(oldRuns.size() + added.size() + removed.size());
+  // added squares are never in an old run, removed squares always are
+  int a = 0;
+  int r = 0;
+  const int addedSize = added.size();
+  const int removedSize = removed.size();
+  for (int i = 0, size = oldRuns.size(); i < size; ++i) {
+    const int runStart = oldRuns[i].start_;
+    const int runEnd = runStart + oldRuns[i].length_;
+    for (; a < addedSize && added[a] < runStart; ++a) {
+      appendRun(&newRuns, added[a], 1);
+    }
+    int start = runStart;
+    for (; r < removedSize && removed[r] < runEnd; ++r) {
+      appendRun(&newRuns, start, removed[r] - start);
+      start = removed[r] + 1;
+    }
+    appendRun(&newRuns, start, runEnd - start);
+  }
+  for (; a < addedSize; ++a) {
+    appendRun(&newRuns, added[a], 1);
+  }
+  colorEntry.count_ += addedSize - removedSize;
+  if (colorEntry.count_ == 0) {
+    runs_.remove(color);
+  }
+  else {
+    colorEntry.runs_ = newRuns;
+  }
+}
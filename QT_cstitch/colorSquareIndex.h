@@ -0,0 +1,98 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef COLORSQUAREINDEX_H
+#define COLORSQUAREINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QRect>
+#include <QtCore/QVector>
+
+#include <QtGui/QColor>
+
+class QImage;
+class pairOfInts;
+
+// colorSquareIndex indexes the squares of a square image by color, so
+// that finding (or counting) the squares of one color doesn't mean
+// scanning the whole image.
+//
+//// Implementation notes
+//
+// Each color keeps the row major runs of its squares, sorted, so a
+// color's memory grows with how fragmented it is rather than with the
+// size of the image, and all of the colors together never hold more
+// runs than there are squares.  The color of every square is also kept,
+// so that an update only needs to be told which squares changed (it
+// reads their new colors from the image); each color touched by an
+// update then has its runs merged with its added and removed squares in
+// one pass.  A color's runs are dropped when its last square is.
+class colorSquareIndex {
+
+ public:
+  colorSquareIndex() : xSquareCount_(0), ySquareCount_(0), dimension_(0) {}
+  // index <image>, which is made of squares of dimension <dimension>
+  colorSquareIndex(const QImage& image, int dimension);
+  bool isNull() const { return squareColors_.isEmpty(); }
+  // return the number of squares of <color>
+  int count(QRgb color) const {
+    const QHash<QRgb, colorRuns>::const_iterator it = runs_.constFind(color);
+    return (it != runs_.constEnd()) ? it->count_ : 0;
+  }
+  // return the number of squares of each color on the image
+  QHash<QRgb, int> counts() const;
+  // return the squares of <color> in row major order (box coordinates)
+  QVector<pairOfInts> squares(QRgb color) const;
+  // the squares covered by <squares> (box coordinate rectangles) may have
+  // changed color in <image> - update their entries
+  void update(const QImage& image, const QVector<QRect>& squares);
+
+ private:
+  // <length_> consecutive squares starting at square <start_> (row major)
+  class squareRun {
+   public:
+    squareRun() : start_(0), length_(0) {}
+    squareRun(int start, int length) : start_(start), length_(length) {}
+    int start_;
+    int length_;
+  };
+  class colorRuns {
+   public:
+    colorRuns() : count_(0) {}
+    QVector<squareRun> runs_; // sorted, and never adjacent
+    int count_;
+  };
+  // append the <length> squares starting at <start> to <runs>, extending
+  // the last run if they follow on from it
+  static void appendRun(QVector<squareRun>* runs, int start, int length);
+  // merge the (sorted) squares <added> and <removed> into <color>'s runs
+  void mergeSquares(QRgb color, const QVector<int>& added,
+                    const QVector<int>& removed);
+
+ private:
+  int xSquareCount_;
+  int ySquareCount_;
+  int dimension_;
+  // the color of each square, row major
+  QVector<QRgb> squareColors_;
+  QHash<QRgb, colorRuns> runs_;
+};
+
+#endif
@@ -22,28 +22,92 @@
 #include <QtGui/QPainter>
 #include <QtGui/QMouseEvent>
 
+// the number of non-original thumbnails to keep
+static const int THUMBNAIL_CACHE_COUNT = 16;
+
 dockImage::dockImage(const QImage& originalImage, QWidget* parent)
-  : constWidthDock(parent), originalImageRef_(originalImage),
+  : constWidthDock(parent), imageKey_(0), originalImageRef_(originalImage),
+    originalThumbnails_(4), imageThumbnails_(THUMBNAIL_CACHE_COUNT),
     showingOriginal_(true), dragging_(false) {
 
   setFixedHeight(dockWidth());
 }
 
-void dockImage::setImage(const QImage& image) {
+QSize dockImage::thumbnailSize(const QSize& size) const {
 
   const int width = dockWidth() - 5; // leave a border of 5 on the right
-  originalImage_ = QPixmap::fromImage(
-    originalImageRef_.copy(0, 0, image.width(), image.height()).
-    scaledToWidth(width));
-  image_ = QPixmap::fromImage(image.scaledToWidth(width));
-  setFixedSize(width, image_.height());
+  if (size.isEmpty()) {
+    return QSize(width, 0);
+  }
+  return QSize(width, qMax(1, qRound(size.height() *
+                                     static_cast<qreal>(width)/size.width())));
+}
+
+void dockImage::sampleThumbnail(const QImage& image, const QSize& sourceSize,
+                                QImage* thumbnail,
+                                const QRect& thumbnailRect) {
+
+  const QRect rect = thumbnailRect.intersected(thumbnail->rect());
+  if (rect.isEmpty()) {
+    return;
+  }
+  const QImage source = (image.depth() == 32) ? image :
+    image.convertToFormat(QImage::Format_RGB32);
+  const qreal xScale =
+    static_cast<qreal>(sourceSize.width())/thumbnail->width();
+  const qreal yScale =
+    static_cast<qreal>(sourceSize.height())/thumbnail->height();
+  for (int j = rect.top(); j <= rect.bottom(); ++j) {
+    const int sourceY = qMin(static_cast<int>(j * yScale),
+                             sourceSize.height() - 1);
+    const QRgb* sourceLine =
+      reinterpret_cast<const QRgb*>(source.constScanLine(sourceY));
+    QRgb* thumbnailLine = reinterpret_cast<QRgb*>(thumbnail->scanLine(j));
+    for (int i = rect.left(); i <= rect.right(); ++i) {
+      thumbnailLine[i] = sourceLine[qMin(static_cast<int>(i * xScale),
+                                         sourceSize.width() - 1)] |
+        0xff000000;
+    }
+  }
+}
+
+void dockImage::setImage(const QImage& image) {
+
+  const QSize size = thumbnailSize(image.size());
+  // the original is only sampled once per crop size
+  const QPair<int, int> cropKey(image.width(), image.height());
+  if (QImage* cachedOriginal = originalThumbnails_.object(cropKey)) {
+    originalImage_ = *cachedOriginal;
+  }
+  else {
+    originalImage_ = QImage(size, QImage::Format_RGB32);
+    if (!originalImage_.isNull()) {
+      sampleThumbnail(originalImageRef_, image.size(), &originalImage_,
+                      originalImage_.rect());
+      originalThumbnails_.insert(cropKey, new QImage(originalImage_));
+    }
+  }
+
+  imageKey_ = image.cacheKey();
+  if (QImage* cachedImage = imageThumbnails_.object(imageKey_)) {
+    image_ = *cachedImage;
+  }
+  else {
+    image_ = QImage(size, QImage::Format_RGB32);
+    if (!image_.isNull()) {
+      sampleThumbnail(image, image.size(), &image_, image_.rect());
+      imageThumbnails_.insert(imageKey_, new QImage(image_));
+    }
+  }
+  setFixedSize(size.width(), image_.height());
+  update();
 }
 
 void dockImage::paintEvent(QPaintEvent* ) {
 
-  const QPixmap pic = showingOriginal_ ? originalImage_ : image_;
+  const QImage& pic = showingOriginal_ ? originalImage_ : image_;
   QPainter painter(this);
-  painter.drawPixmap(0, 0, pic);
+  painter.drawImage(0, 0, pic);
   painter.setPen(Qt::red);
   painter.drawRect(viewport_);
 }
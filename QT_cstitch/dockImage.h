@@ -20,10 +20,12 @@
 #ifndef DOCKIMAGE_H
 #define DOCKIMAGE_H
 
+#include <QtCore/QCache>
+#include <QtCore/QPair>
 #include <QtCore/QRect>
 
 #include <QtWidgets/QWidget>
-#include <QPixmap>
+#include <QImage>
 
 #include "constWidthDock.h"
 
@@ -38,6 +40,10 @@
 // in the main window.  Conversely, the main window can call
 // updateViewport to make the viewport respond to changes in the view
 // of the image on the main window.
+//
+// Thumbnails are nearest pixel samples of their images.  Thumbnails of
+// the original (one per crop size) and of recently shown images are
+// cached, so switching between images doesn't rescale anything.
 class dockImage : public constWidthDock {
 
   Q_OBJECT
@@ -63,6 +69,12 @@ class dockImage : public constWidthDock {
   void moveViewport(const QPoint& newCenter);
   // reset the viewport if necessary so that it's entirely within the image
   void maybeCorrectViewport();
+  // return the thumbnail size for an image of <size>
+  QSize thumbnailSize(const QSize& size) const;
+  // sample the <thumbnailRect> pixels of the thumbnail of <image> (of
+  // size <sourceSize>, which may be a crop of <image>) onto <thumbnail>
+  static void sampleThumbnail(const QImage& image, const QSize& sourceSize,
+                              QImage* thumbnail, const QRect& thumbnailRect);
 
  signals:
   // <rightEdge> if the right side of the viewport is on the right side
@@ -72,11 +84,16 @@ class dockImage : public constWidthDock {
                        bool rightEdge, bool bottomEdge);
 
  private:
-  QPixmap image_; // the non-original image
+  QImage image_; // the non-original image thumbnail
+  qint64 imageKey_; // the cacheKey of the image image_ was made from
   // the portion of the original image that we show may depend on the size
   // of image_, so keep a ref to the unaltered version
   const QImage& originalImageRef_;
-  QPixmap originalImage_;
+  QImage originalImage_;
+  // original image thumbnails, by crop size
+  QCache<QPair<int, int>, QImage> originalThumbnails_;
+  // non-original image thumbnails, by image cacheKey
+  QCache<qint64, QImage> imageThumbnails_;
   bool showingOriginal_; // true if the original image is currently shown
   bool dragging_; // true if mouse is being drug in this widget
   QRect viewport_;
@@ -32,80 +32,136 @@
 #include "triC.h"
 #include "imageProcessing.h"
 
-dockListWidget::dockListWidget(QWidget* parent)
-  : constWidthDock(parent), mainLayout_(new QVBoxLayout(this)),
-    colorList_(new QListWidget(this)), numColorsLabel_(new QLabel(this)) {
+void dockListModel::setColors(QVector<typedFloss> colors) {
 
-  colorList_->setContextMenuPolicy(Qt::CustomContextMenu);
-  connect(colorList_, SIGNAL(customContextMenuRequested(const QPoint& )),
-          this, SLOT(processContextRequest(const QPoint& )));
-  colorList_->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Preferred);
-  colorList_->setIconSize(iconSize());
-  QFont font = colorList_->font();
-  font.setFamily("monaco");
-  // apparently pitch means width (as in "fixed width")
-  // needed for some families, not for others
-  // See http://www.cfcl.com/vlb/h/fontmono.html for many more options
-  font.setFixedPitch(true);
-  colorList_->setFont(font);
-  colorList_->setAlternatingRowColors(true);
-  // (I thought "show-decoration-selected: 0;" would highlight the text only,
-  // but in fact it highlights/tints the icon as well (which it took me a while
-  // to recognize).)
-  // (It would be nice to add a little top/bottom margin/padding to the list
-  // items as well, but all the ways I tried to do so only added bottom (5.8).)
-  setStyleSheet(" QListWidget { alternate-background-color: #ecebea; }");
+  beginResetModel();
+  // sort the list by intensity
+  std::sort(colors.begin(), colors.end(), typedFlossIntensity());
+  colors_ = colors;
+  intensities_.clear();
+  intensities_.reserve(colors_.size());
+  for (int i = 0, size = colors_.size(); i < size; ++i) {
+    const triC& thisColor = colors_[i].color();
+    intensities_.insert(thisColor.qrgb(), thisColor.intensity());
+  }
+  icons_.clear();
+  endResetModel();
+}
 
-  //// a label for the number of colors in the list
-  const QFontMetrics fontMetric(font);
-  numColorsLabel_->setFixedHeight(fontMetric.boundingRect("D").height());
-  numColorsLabel_->setAlignment(Qt::AlignCenter);
+int dockListModel::insertionRow(int intensity) const {
 
-  //// a layout to contain the list and the labels
-  mainLayout_->addWidget(numColorsLabel_);
-  mainLayout_->addWidget(colorList_);
-  setLayout(mainLayout_);
+  // insert in front of the first color that's more intense
+  int low = 0;
+  int high = colors_.size();
+  while (low < high) {
+    const int mid = (low + high)/2;
+    if (intensity < colors_[mid].color().intensity()) {
+      high = mid;
+    }
+    else {
+      low = mid + 1;
+    }
+  }
+  return low;
 }
 
-void dockListWidget::setNumColors(int numColors) {
+int dockListModel::findRow(const triC& color) const {
 
-  //: singular/plural
-  const QString numColorsString = tr("%n color(s)", "", numColors);
-  numColorsLabel_->setText(numColorsString);
+  const QRgb rgb = color.qrgb();
+  QHash<QRgb, int>::const_iterator it = intensities_.find(rgb);
+  if (it == intensities_.end()) {
+    return -1;
+  }
+  // the colors of this intensity end just before its insertion row
+  for (int i = insertionRow(it.value()) - 1; i >= 0; --i) {
+    if (colors_[i].color().qrgb() == rgb) {
+      return i;
+    }
+  }
+  qWarning() << "Color missing from dock list:" << ::ctos(color);
+  return -1;
 }
 
-void dockListWidget::clearList() {
+int dockListModel::addColor(const typedFloss& color) {
 
-  colorList_->clear();
-  setNumColors(0);
+  const int existingRow = findRow(color.color());
+  if (existingRow != -1) {
+    return existingRow;
+  }
+  const int intensity = color.color().intensity();
+  const int row = insertionRow(intensity);
+  beginInsertRows(QModelIndex(), row, row);
+  colors_.insert(row, color);
+  intensities_.insert(color.color().qrgb(), intensity);
+  endInsertRows();
+  return row;
 }
 
-QListWidgetItem* dockListWidget::findColorListItem(const triC& color) const {
+bool dockListModel::removeColor(const triC& color) {
 
-  const QColor qColor = color.qc();
-  for (int i = 0, count = colorList_->count(); i < count; ++i) {
-    QListWidgetItem* thisRow = colorList_->item(i);
-    if (thisRow != NULL &&
-        thisRow->data(Qt::UserRole).value<QColor>() == qColor) {
-      return thisRow;
-    }
+  const int row = findRow(color);
+  if (row == -1) {
+    return false;
   }
+  beginRemoveRows(QModelIndex(), row, row);
+  colors_.remove(row);
+  intensities_.remove(color.qrgb());
+  icons_.remove(color.qrgb());
+  endRemoveRows();
+  return true;
+}
 
-  return NULL;
+int dockListModel::rowCount(const QModelIndex& parent) const {
+
+  return parent.isValid() ? 0 : colors_.size();
 }
 
-void dockListWidget::moveTo(const triC& color) {
+QVariant dockListModel::data(const QModelIndex& index, int role) const {
 
-  QListWidgetItem* row = findColorListItem(color);
-  if (row) {
-    colorList_->setCurrentItem(row);
+  if (!index.isValid() || index.row() >= colors_.size()) {
+    return QVariant();
   }
-  else {
-    deselectCurrentListItem();
+  const typedFloss& floss = colors_[index.row()];
+  switch (role) {
+  case Qt::DisplayRole:
+    return getListTextForFloss(floss);
+  case Qt::DecorationRole: {
+    const QRgb rgb = floss.color().qrgb();
+    QHash<QRgb, QIcon>::const_iterator it = icons_.find(rgb);
+    if (it == icons_.end()) {
+      // Using "show-decoration-selected: 0;" actually highlights
+      // separately just the text and just the icon :/  Do this instead(!):
+      // https://stackoverflow.com/questions/5044449/how-to-change-qt-qlistview-icon-selection-highlight
+      QIcon colorIcon;
+      const QPixmap iconPixmap = generateIconSwatch(floss.color());
+      colorIcon.addPixmap(iconPixmap, QIcon::Normal);
+      colorIcon.addPixmap(iconPixmap, QIcon::Selected);
+      it = icons_.insert(rgb, colorIcon);
+    }
+    return it.value();
+  }
+  case Qt::ToolTipRole: {
+    const QString tooltip = toolTipForFloss(floss);
+    return tooltip.isEmpty() ? QVariant() : QVariant(tooltip);
+  }
+  case Qt::TextAlignmentRole:
+    return static_cast<int>(Qt::AlignLeft);
+  case Qt::UserRole:
+    return QVariant(floss.color().qc());
+  default:
+    return QVariant();
+  }
+}
+
+Qt::ItemFlags dockListModel::flags(const QModelIndex& index) const {
+
+  if (!index.isValid()) {
+    return Qt::NoItemFlags;
   }
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
 }
 
-QString dockListWidget::getListTextForFloss(const typedFloss& color) const {
+QString dockListModel::getListTextForFloss(const typedFloss& color) const {
 
   QString colorText;
   if (color.type() == flossDMC) {
@@ -125,104 +181,111 @@ QString dockListWidget::getListTextForFloss(const typedFloss& color) const {
   return colorText;
 }
 
-void dockListWidget::setColorList(QVector<typedFloss> colors) {
-
-  colorList_->clear();
-  // sort the list by intensity
-  std::sort(colors.begin(), colors.end(), typedFlossIntensity());
-  // create the list items
-  for (int i = 0, size = colors.size(); i < size; ++i) {
-    const typedFloss thisColor = colors[i];
-    const QString colorText = getListTextForFloss(thisColor);
-    QListWidgetItem* listItem =
-      createDockListItem(thisColor.color(), colorText, true);
-    maybeAddToolTipToListItem(listItem, thisColor);
-  }
-  setNumColors(colorList_->count());
-}
-
-void dockListWidget::maybeAddToolTipToListItem(QListWidgetItem* item,
-                                               const typedFloss& color) const {
+QString dockListModel::toolTipForFloss(const typedFloss& color) const {
 
   if (color.type() == flossDMC) {
-    const QString tooltip = color.name() % "\n" % ::colorToTriple(color.color());
-    item->setToolTip(tooltip);
+    return color.name() % "\n" % ::colorToTriple(color.color());
   }
   else if (color.type() == flossAnchor) {
-    item->setToolTip(::colorToTriple(color.color()));
+    return ::colorToTriple(color.color());
+  }
+  else {
+    return QString();
   }
 }
 
-void dockListWidget::addListItemByIntensity(QListWidgetItem* item,
-                                            int itemIntensity) {
+QPixmap dockListModel::generateIconSwatch(const triC& swatchColor) const {
 
-  for (int i = 0, size = colorList_->count(); i < size; ++i) {
-    const triC thisColor =
-      triC(colorList_->item(i)->data(Qt::UserRole).value<QColor>());
-    if (itemIntensity < thisColor.intensity()) {
-      // Inserts in front of.
-      colorList_->insertItem(i, item);
-      return;
-    }
-  }
+  const QSize size = iconSize_;
+  QPixmap swatchPixmap(size);
+  swatchPixmap.fill(swatchColor.qc());
+  QPainter painter(&swatchPixmap);
+  painter.drawLine(0, 0, size.width(), 0);
+  painter.drawLine(0, 0, 0, size.height());
+  return swatchPixmap;
+}
+
+dockListWidget::dockListWidget(QWidget* parent)
+  : constWidthDock(parent), mainLayout_(new QVBoxLayout(this)),
+    model_(new dockListModel(iconSize(), this)),
+    colorList_(new QListView(this)), numColorsLabel_(new QLabel(this)) {
+
+  colorList_->setModel(model_);
+  // lay the rows out a batch at a time instead of all at once
+  colorList_->setLayoutMode(QListView::Batched);
+  colorList_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  colorList_->setContextMenuPolicy(Qt::CustomContextMenu);
+  connect(colorList_, SIGNAL(customContextMenuRequested(const QPoint& )),
+          this, SLOT(processContextRequest(const QPoint& )));
+  colorList_->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Preferred);
+  colorList_->setIconSize(iconSize());
+  QFont font = colorList_->font();
+  font.setFamily("monaco");
+  // apparently pitch means width (as in "fixed width")
+  // needed for some families, not for others
+  // See http://www.cfcl.com/vlb/h/fontmono.html for many more options
+  font.setFixedPitch(true);
+  colorList_->setFont(font);
+  colorList_->setAlternatingRowColors(true);
+  // (I thought "show-decoration-selected: 0;" would highlight the text only,
+  // but in fact it highlights/tints the icon as well (which it took me a while
+  // to recognize).)
+  // (It would be nice to add a little top/bottom margin/padding to the list
+  // items as well, but all the ways I tried to do so only added bottom (5.8).)
+  setStyleSheet(" QListView { alternate-background-color: #ecebea; }");
 
-  // Append it.
-  colorList_->insertItem(colorList_->count(), item);
+  //// a label for the number of colors in the list
+  const QFontMetrics fontMetric(font);
+  numColorsLabel_->setFixedHeight(fontMetric.boundingRect("D").height());
+  numColorsLabel_->setAlignment(Qt::AlignCenter);
+
+  //// a layout to contain the list and the labels
+  mainLayout_->addWidget(numColorsLabel_);
+  mainLayout_->addWidget(colorList_);
+  setLayout(mainLayout_);
 }
 
-void dockListWidget::addToList(const typedFloss& color) {
+void dockListWidget::setNumColors(int numColors) {
 
-  QListWidgetItem* listItem = findColorListItem(color.color());
-  if (!listItem) {
-    const QString colorText = getListTextForFloss(color);
-    listItem = createDockListItem(color.color(), colorText, false);
-    maybeAddToolTipToListItem(listItem, color);
-    addListItemByIntensity(listItem, color.color().intensity());
-  }
-  colorList_->setCurrentItem(listItem);
-  setNumColors(colorList_->count());
+  //: singular/plural
+  const QString numColorsString = tr("%n color(s)", "", numColors);
+  numColorsLabel_->setText(numColorsString);
 }
 
-QListWidgetItem* dockListWidget::createDockListItem(const triC& color,
-                                                    const QString& text,
-                                                    bool appendItem) {
+void dockListWidget::clearList() {
 
-  QListWidgetItem* listItem = NULL;
-  if (appendItem) {
-    listItem = new QListWidgetItem(text, colorList_);
+  model_->setColors(QVector<typedFloss>());
+  setNumColors(0);
+}
+
+void dockListWidget::moveTo(const triC& color) {
+
+  const int row = model_->findRow(color);
+  if (row != -1) {
+    colorList_->setCurrentIndex(model_->index(row));
   }
   else {
-    listItem = new QListWidgetItem(text);
+    deselectCurrentListItem();
   }
-  listItem->setData(Qt::UserRole, QVariant(color.qc()));
-  listItem->setTextAlignment(Qt::AlignLeft);
-  // Using "show-decoration-selected: 0;" actually highlights separately just
-  // the text and just the icon :/  Do this instead(!):
-  // https://stackoverflow.com/questions/5044449/how-to-change-qt-qlistview-icon-selection-highlight
-  QIcon colorIcon;
-  const QPixmap iconPixmap = generateIconSwatch(color);
-  colorIcon.addPixmap(iconPixmap, QIcon::Normal);
-  colorIcon.addPixmap(iconPixmap, QIcon::Selected);
-
-  listItem->setIcon(colorIcon);
-
-  return listItem;
 }
 
-QPixmap dockListWidget::generateIconSwatch(const triC& swatchColor) const {
+void dockListWidget::setColorList(QVector<typedFloss> colors) {
 
-  const QSize size = iconSize();
-  QPixmap swatchPixmap(size);
-  swatchPixmap.fill(swatchColor.qc());
-  QPainter painter(&swatchPixmap);
-  painter.drawLine(0, 0, size.width(), 0);
-  painter.drawLine(0, 0, 0, size.height());
-  return swatchPixmap;
+  model_->setColors(colors);
+  setNumColors(model_->rowCount());
+}
+
+void dockListWidget::addToList(const typedFloss& color) {
+
+  const int row = model_->addColor(color);
+  colorList_->setCurrentIndex(model_->index(row));
+  setNumColors(model_->rowCount());
 }
 
 void dockListWidget::processContextRequest(const QPoint& point) {
 
-  if (QListWidgetItem* listItem = colorList_->itemAt(point)) {
+  const QModelIndex listIndex = colorList_->indexAt(point);
+  if (listIndex.isValid()) {
     QMenu* contextMenu = new QMenu();
     const QAction* listRemoveAction =
       contextMenu->addAction(QIcon(":delete.png"), tr("Remove"));
@@ -230,10 +293,10 @@ void dockListWidget::processContextRequest(const QPoint& point) {
     const QAction* returnAction = contextMenu->exec(QCursor::pos());
     if (returnAction == listRemoveAction) {
       const QColor colorToRemove =
-        listItem->data(Qt::UserRole).value<QColor>();
-      delete listItem;
-      setNumColors(colorList_->count());
-      colorList_->setCurrentItem(NULL);
+        listIndex.data(Qt::UserRole).value<QColor>();
+      model_->removeColor(colorToRemove);
+      setNumColors(model_->rowCount());
+      deselectCurrentListItem();
       emit colorRemoved(colorToRemove);
     }
     delete contextMenu;
@@ -244,9 +307,9 @@ void dockListWidget::processContextRequest(const QPoint& point) {
 
 QColor dockListWidget::contextColor() {
 
-  const QListWidgetItem* listItem = colorList_->currentItem();
-  if (listItem) {
-    return listItem->data(Qt::UserRole).value<QColor>();
+  const QModelIndex listIndex = colorList_->currentIndex();
+  if (listIndex.isValid()) {
+    return listIndex.data(Qt::UserRole).value<QColor>();
   }
   else {
     return QColor();
@@ -255,11 +318,9 @@ QColor dockListWidget::contextColor() {
 
 bool dockListWidget::removeColorFromList(const triC& color) {
 
-  QListWidgetItem* row = findColorListItem(color);
-  if (row) {
-    delete row;
-    setNumColors(colorList_->count());
-    colorList_->setCurrentItem(NULL); // no selection
+  if (model_->removeColor(color)) {
+    setNumColors(model_->rowCount());
+    deselectCurrentListItem(); // no selection
     return true;
   }
   else {
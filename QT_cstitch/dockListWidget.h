@@ -20,22 +20,73 @@
 #ifndef DOCKWIDGET_H
 #define DOCKWIDGET_H
 
+#include <QtCore/QAbstractListModel>
+#include <QtCore/QHash>
+#include <QtGui/QIcon>
 #include <QtWidgets/QWidget>
-#include <QtWidgets/QListWidget>
+#include <QtWidgets/QListView>
 
 #include "constWidthDock.h"
+#include "floss.h"
 
-class triC;
-class typedFloss;
 class QHBoxLayout;
 class QVBoxLayout;
 class QLabel;
 
+//
+// dockListModel is the list model behind a dockListWidget: its rows are
+// flosses kept sorted by intensity, with a hash on color so that a color
+// can be found or checked for without scanning the list - a row is found
+// by binary search on intensity.  Row text is made when the view asks for
+// it, and icon swatches are made (and kept) the first time a row is
+// painted.
+//
+// A row's Qt::UserRole data is its QColor.
+//
+class dockListModel : public QAbstractListModel {
+
+  Q_OBJECT
+
+ public:
+  // <iconSize> is the size of the icon swatches
+  dockListModel(const QSize& iconSize, QObject* parent)
+    : QAbstractListModel(parent), iconSize_(iconSize) {}
+  // replace the rows with <colors>
+  void setColors(QVector<typedFloss> colors);
+  // add <color> in intensity order if it's not already on the list;
+  // return its row
+  int addColor(const typedFloss& color);
+  // remove <color>; return false if it wasn't on the list
+  bool removeColor(const triC& color);
+  // return the row of <color>, or -1 if it's not on the list
+  int findRow(const triC& color) const;
+  int rowCount(const QModelIndex& parent = QModelIndex()) const;
+  QVariant data(const QModelIndex& index, int role) const;
+  Qt::ItemFlags flags(const QModelIndex& index) const;
+
+ private:
+  // return the row before which a color of <intensity> goes
+  int insertionRow(int intensity) const;
+  // generate a pixmap with solid color <swatchColor> to be used as an
+  // icon for a list item
+  QPixmap generateIconSwatch(const triC& swatchColor) const;
+  QString getListTextForFloss(const typedFloss& color) const;
+  QString toolTipForFloss(const typedFloss& color) const;
+
+ private:
+  const QSize iconSize_;
+  QVector<typedFloss> colors_; // sorted by intensity
+  // keys are the colors on colors_, values their intensities
+  QHash<QRgb, int> intensities_;
+  // icons made so far, by color
+  mutable QHash<QRgb, QIcon> icons_;
+};
+
 //
 // A widget for displaying a list of colors and a "number of colors" label.
 //
 // Implementation note: The only thing you're allowed to assume about the
-// structure of a list item is that its data field is its QColor.
+// structure of a list row is that its Qt::UserRole data is its QColor.
 //
 class dockListWidget : public constWidthDock {
 
@@ -47,7 +98,7 @@ class dockListWidget : public constWidthDock {
   // move to and select the entry for <color> if it exists
   void moveTo(const triC& color);
   void clearList();
-  void deselectCurrentListItem() { colorList_->setCurrentItem(NULL); }
+  void deselectCurrentListItem() { colorList_->setCurrentIndex(QModelIndex()); }
   void setColorList(QVector<typedFloss> colors);
   // add <color> to the list and highlight it
   void addToList(const typedFloss& color);
@@ -64,7 +115,7 @@ class dockListWidget : public constWidthDock {
   // return the currently highlighted color
   QColor contextColor();
   bool itemAtPoint(const QPoint& point) const {
-    return colorList_->itemAt(point);
+    return colorList_->indexAt(point).isValid();
   }
   void prependLayout(QHBoxLayout* layout);
   void prependWidget(QWidget* widget);
@@ -73,29 +124,13 @@ class dockListWidget : public constWidthDock {
   // handle a context request originated at <point>
   virtual void processContextRequest(const QPoint& point);
 
- private:
-  // Create and return a new dock list item using the given data.  If
-  // <appendItem> is true then the new item is appended to the color list;
-  // otherwise the caller is responsible for inserting the item.
-  QListWidgetItem* createDockListItem(const triC& color, const QString& text,
-                                      bool appendItem);
-  // generate a pixmap with solid color <swatchColor> to be used as an
-  // icon for a list item
-  QPixmap generateIconSwatch(const triC& swatchColor) const;
-  // Find an item in the color list based on its color.  Returns a pointer to
-  // the list item if the search was successful, otherwise returns NULL.
-  QListWidgetItem* findColorListItem(const triC& color) const;
-  QString getListTextForFloss(const typedFloss& color) const;
-  void maybeAddToolTipToListItem(QListWidgetItem* item,
-                                 const typedFloss& color) const;
-  void addListItemByIntensity(QListWidgetItem* item, int itemIntensity);
-
  signals:
   void colorRemoved(const triC& color);
 
  private:
   QVBoxLayout* mainLayout_;
-  QListWidget* colorList_;
+  dockListModel* model_;
+  QListView* colorList_;
   QLabel* numColorsLabel_;
 };
 
@@ -0,0 +1,99 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "gridOverlay.h"
+
+#include <QtCore/qmath.h>
+
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+
+gridOverlay gridOverlay::forScaledImage(const QSize& scaledSize,
+                                        int originalSquareDim,
+                                        const QSize& originalSize,
+                                        QRgb color, qreal lineWidth) {
+
+  // scaled grid dims
+  const qreal xdim =
+    originalSquareDim*scaledSize.width()/static_cast<qreal>(originalSize.width());
+  const qreal ydim =
+    originalSquareDim*scaledSize.height()/
+    static_cast<qreal>(originalSize.height());
+  if (xdim < 1.25 * lineWidth || ydim < 1.25 * lineWidth) {
+    return gridOverlay();
+  }
+  return gridOverlay(scaledSize, xdim, ydim, color, lineWidth, true);
+}
+
+void gridOverlay::draw(QPainter* painter, const QRect& rect) const {
+
+  if (isNull()) {
+    return;
+  }
+  const QRect area = rect.intersected(QRect(QPoint(0, 0), imageSize_));
+  if (area.isEmpty()) {
+    return;
+  }
+  const int width = imageSize_.width();
+  const int height = imageSize_.height();
+  painter->save();
+  painter->setPen(QPen(QColor(color_), lineWidth_));
+  // line k is at floor(k*spacing); start one line early in case a wide
+  // line from the left/top reaches into area
+  const int firstColumn = qMax(qFloor(area.left()/xSpacing_) - 1, 0);
+  for (int k = firstColumn; ; ++k) {
+    const qreal x = k*xSpacing_;
+    if (x >= width || x > area.right() + lineWidth_) {
+      break;
+    }
+    const int xInt = static_cast<int>(x);
+    painter->drawLine(QPoint(xInt, area.top()), QPoint(xInt, area.bottom()));
+  }
+  const int firstRow = qMax(qFloor(area.top()/ySpacing_) - 1, 0);
+  for (int k = firstRow; ; ++k) {
+    const qreal y = k*ySpacing_;
+    if (y >= height || y > area.bottom() + lineWidth_) {
+      break;
+    }
+    const int yInt = static_cast<int>(y);
+    painter->drawLine(QPoint(area.left(), yInt), QPoint(area.right(), yInt));
+  }
+  if (closed_) {
+    if (area.right() >= width - 1 - lineWidth_) {
+      painter->drawLine(QPoint(width - 1, area.top()),
+                        QPoint(width - 1, area.bottom()));
+    }
+    if (area.bottom() >= height - 1 - lineWidth_) {
+      painter->drawLine(QPoint(area.left(), height - 1),
+                        QPoint(area.right(), height - 1));
+    }
+  }
+  painter->restore();
+}
+
+void gridOverlay::drawOnStrip(QImage* strip, int stripTop) const {
+
+  if (isNull()) {
+    return;
+  }
+  QPainter painter(strip);
+  painter.translate(0, -stripTop);
+  draw(&painter, QRect(0, stripTop, strip->width(), strip->height()));
+}
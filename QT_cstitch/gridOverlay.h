@@ -0,0 +1,75 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef GRIDOVERLAY_H
+#define GRIDOVERLAY_H
+
+#include <QtCore/QSize>
+#include <QtCore/QRect>
+
+#include <QtGui/QRgb>
+
+class QPainter;
+class QImage;
+
+// gridOverlay draws the grid lines for an image of a given size, with
+// lines every xSpacing/ySpacing pixels, directly onto whatever is being
+// painted: only the lines crossing the requested rectangle are drawn,
+// and nothing is allocated, so labels can draw the grid at paint time and
+// savers can grid an image (or a horizontal strip of one) in place
+// without copying it.
+//
+// Lines are drawn on the left/top sides of squares; a "closed" grid also
+// draws the final right/bottom lines along the last pixel row and column.
+class gridOverlay {
+
+ public:
+  gridOverlay() : xSpacing_(0), ySpacing_(0), color_(qRgb(0, 0, 0)),
+    lineWidth_(1), closed_(false) {}
+  gridOverlay(const QSize& imageSize, qreal xSpacing, qreal ySpacing,
+              QRgb color, qreal lineWidth = 1, bool closed = false)
+    : imageSize_(imageSize), xSpacing_(xSpacing), ySpacing_(ySpacing),
+      color_(color), lineWidth_(lineWidth), closed_(closed) {}
+  // return the closed grid for an image of <scaledSize> that was scaled
+  // from an image of <originalSize> with squares of <originalSquareDim>.
+  // If the scaled square size is too small compared to <lineWidth> the
+  // returned grid is null (gridding would cover nearly all of each
+  // square).
+  static gridOverlay forScaledImage(const QSize& scaledSize,
+                                    int originalSquareDim,
+                                    const QSize& originalSize, QRgb color,
+                                    qreal lineWidth = 1);
+  bool isNull() const { return xSpacing_ <= 0 || ySpacing_ <= 0; }
+  // draw the lines crossing <rect> (in image coordinates) with <painter>
+  void draw(QPainter* painter, const QRect& rect) const;
+  // draw the lines crossing <strip>, which holds the image rows starting
+  // at <stripTop>
+  void drawOnStrip(QImage* strip, int stripTop) const;
+
+ private:
+  QSize imageSize_;
+  qreal xSpacing_;
+  qreal ySpacing_;
+  QRgb color_;
+  qreal lineWidth_;
+  bool closed_;
+};
+
+#endif
@@ -0,0 +1,458 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "historyJournal.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QSaveFile>
+
+#include <QtXml/QDomDocument>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "binaryUtility.h"
+#include "patternImageContainer.h"
+#include "xmlUtility.h"
+
+historyJournal* historyJournal::current_ = NULL;
+
+// A journal file starts with JOURNAL_MAGIC, JOURNAL_VERSION and the
+// fingerprint of its project file, followed by the records.  Each record
+// is the length (quint32) and checksum (quint16) of its data followed by
+// the data: the record type (quint8), the image index (varint), and any
+// payload for the type.  A record that's cut short (by a crash, say)
+// fails its checksum and ends the journal.
+static const quint32 JOURNAL_MAGIC = 0x4353544a; // "CSTJ"
+static const quint8 JOURNAL_VERSION = 1;
+// buffered records are synced once there are this many bytes of them,
+// or after this many milliseconds
+static const int SYNC_BYTES = 64 * 1024;
+static const int SYNC_DELAY = 2000;
+
+// (these are written to disk, so don't reorder them)
+enum journalRecordType {J_SQUARE_EDIT = 1, J_SQUARE_BACK, J_SQUARE_FORWARD,
+                        J_PATTERN_EDIT, J_PATTERN_BACK, J_PATTERN_FORWARD};
+
+// return data that changes whenever <projectFile> does
+static QByteArray projectFingerprint(const QString& projectFile) {
+
+  const QFileInfo info(projectFile);
+  QByteArray fingerprint;
+  QDataStream stream(&fingerprint, QIODevice::WriteOnly);
+  stream << info.size() << info.lastModified().toMSecsSinceEpoch();
+  return fingerprint;
+}
+
+static QByteArray journalHeader(const QString& projectFile) {
+
+  QByteArray header;
+  QDataStream stream(&header, QIODevice::WriteOnly);
+  stream << JOURNAL_MAGIC << JOURNAL_VERSION <<
+    ::projectFingerprint(projectFile);
+  return header;
+}
+
+// Read the journal <file>, appending the data of each valid record to
+// <records> (if it's non-NULL).  Return the offset of the end of the last
+// valid record, or -1 if <file> isn't a journal for the current version
+// of <projectFile>.
+static qint64 readJournal(QFile* file, const QString& projectFile,
+                          QList<QByteArray>* records) {
+
+  file->seek(0);
+  QDataStream stream(file);
+  quint32 magic = 0;
+  quint8 version = 0;
+  QByteArray fingerprint;
+  stream >> magic >> version >> fingerprint;
+  if (stream.status() != QDataStream::Ok || magic != JOURNAL_MAGIC ||
+      version != JOURNAL_VERSION ||
+      fingerprint != ::projectFingerprint(projectFile)) {
+    return -1;
+  }
+  qint64 end = file->pos();
+  forever {
+    quint32 length = 0;
+    quint16 checksum = 0;
+    stream >> length >> checksum;
+    if (stream.status() != QDataStream::Ok ||
+        length > file->size() - file->pos()) {
+      break;
+    }
+    const QByteArray data = file->read(length);
+    if (data.size() != static_cast<int>(length) ||
+        qChecksum(QByteArrayView(data)) != checksum) {
+      break;
+    }
+    if (records) {
+      records->push_back(data);
+    }
+    end = file->pos();
+  }
+  return end;
+}
+
+// return the <tagName> image elements in <doc>, keyed by image index
+static QHash<int, QDomElement> imagesByIndex(const QDomDocument& doc,
+                                             const QString& tagName) {
+
+  QHash<int, QDomElement> images;
+  const QDomNodeList imageList(doc.elementsByTagName(tagName));
+  for (int i = 0, size = imageList.size(); i < size; ++i) {
+    const QDomElement image(imageList.item(i).toElement());
+    images[::getElementText(image, "index").toInt()] = image;
+  }
+  return images;
+}
+
+// return the child element of <parent> named <name>, creating it if
+// necessary
+static QDomElement childElement(QDomDocument* doc, QDomElement* parent,
+                                const QString& name) {
+
+  QDomElement child(parent->firstChildElement(name));
+  if (child.isNull()) {
+    child = doc->createElement(name);
+    parent->appendChild(child);
+  }
+  return child;
+}
+
+// set the count attribute of <list> to its number of history items
+static void updateCount(QDomElement* list) {
+
+  int count = 0;
+  for (QDomElement item = list->firstChildElement("history_item");
+       !item.isNull(); item = item.nextSiblingElement("history_item")) {
+    ++count;
+  }
+  list->setAttribute("count", count);
+}
+
+// Return the <historyTag> history element of <image> (null if <image>
+// is), creating the element if necessary.
+static QDomElement historyElement(QDomDocument* doc, QDomElement image,
+                                  const QString& historyTag) {
+
+  if (image.isNull()) {
+    return QDomElement();
+  }
+  return ::childElement(doc, &image, historyTag);
+}
+
+// Clear the forward history of <history> for a new edit and return its
+// back history (the new edit's history item gets appended there).
+static QDomElement startNewEdit(QDomDocument* doc, QDomElement* history) {
+
+  history->removeChild(history->firstChildElement("forward_history"));
+  return ::childElement(doc, history, "backward_history");
+}
+
+// Move the last back history item of <history> to the front of its
+// forward history (undo), or the first forward item to the back of its
+// back history (redo, if <forward>).  Return false if there was nothing
+// to move.
+static bool moveHistoryItem(QDomDocument* doc, QDomElement* history,
+                            bool forward) {
+
+  QDomElement back(::childElement(doc, history, "backward_history"));
+  QDomElement front(::childElement(doc, history, "forward_history"));
+  if (forward) {
+    const QDomElement item(front.firstChildElement("history_item"));
+    if (item.isNull()) {
+      return false;
+    }
+    back.appendChild(item);
+  }
+  else {
+    const QDomElement item(back.lastChildElement("history_item"));
+    if (item.isNull()) {
+      return false;
+    }
+    front.insertBefore(item, front.firstChildElement("history_item"));
+  }
+  ::updateCount(&back);
+  ::updateCount(&front);
+  return true;
+}
+
+historyJournal::historyJournal() : file_(NULL) {
+
+  syncTimer_.setSingleShot(true);
+  connect(&syncTimer_, SIGNAL(timeout()), this, SLOT(sync()));
+}
+
+historyJournal::~historyJournal() {
+
+  close();
+}
+
+void historyJournal::start(const QString& projectFile) {
+
+  close();
+  file_ = new QFile(journalFilename(projectFile));
+  if (!file_->open(QIODevice::ReadWrite)) {
+    qWarning() << "Unable to open history journal:" << file_->errorString();
+    delete file_;
+    file_ = NULL;
+    return;
+  }
+  const qint64 end = ::readJournal(file_, projectFile, NULL);
+  if (end == -1) { // not ours, start over
+    file_->resize(0);
+    file_->seek(0);
+    file_->write(::journalHeader(projectFile));
+  }
+  else { // drop anything after the last good record
+    file_->resize(end);
+    file_->seek(end);
+  }
+  file_->flush();
+  current_ = this;
+}
+
+void historyJournal::discard() {
+
+  if (file_) {
+    const QString journalFile = file_->fileName();
+    buffer_.clear();
+    close();
+    QFile::remove(journalFile);
+  }
+}
+
+void historyJournal::close() {
+
+  sync();
+  delete file_;
+  file_ = NULL;
+  if (current_ == this) {
+    current_ = NULL;
+  }
+}
+
+qint64 historyJournal::position() {
+
+  if (!file_) {
+    return -1;
+  }
+  sync();
+  return file_->pos();
+}
+
+void historyJournal::compact(const QString& projectFile, qint64 position) {
+
+  // the records made after the save started
+  QByteArray newRecords;
+  QString oldJournal;
+  if (file_) {
+    oldJournal = file_->fileName();
+    if (position != -1) {
+      sync();
+      file_->seek(position);
+      newRecords = file_->readAll();
+    }
+  }
+  close();
+
+  const QString newJournal = journalFilename(projectFile);
+  QSaveFile journal(newJournal);
+  if (!journal.open(QIODevice::WriteOnly) ||
+      journal.write(::journalHeader(projectFile)) == -1 ||
+      journal.write(newRecords) == -1 || !journal.commit()) {
+    qWarning() << "Unable to compact history journal:" <<
+      journal.errorString();
+  }
+  else if (!oldJournal.isEmpty() && oldJournal != newJournal) {
+    // the old project's unsaved edits are in the new project now
+    QFile::remove(oldJournal);
+  }
+  start(projectFile);
+}
+
+void historyJournal::sync() {
+
+  syncTimer_.stop();
+  if (!file_ || buffer_.isEmpty()) {
+    return;
+  }
+  if (file_->write(buffer_) != buffer_.size() || !file_->flush()) {
+    qWarning() << "Unable to write history journal:" << file_->errorString();
+  }
+  else {
+#ifdef Q_OS_WIN
+    ::_commit(file_->handle());
+#else
+    ::fsync(file_->handle());
+#endif
+  }
+  buffer_.clear();
+}
+
+void historyJournal::append(int type, int imageIndex,
+                            const QByteArray& payload) {
+
+  QByteArray data;
+  QDataStream dataStream(&data, QIODevice::WriteOnly);
+  dataStream << static_cast<quint8>(type);
+  ::writeVarint(&dataStream, imageIndex);
+  dataStream.writeRawData(payload.constData(), payload.size());
+
+  QByteArray record;
+  QDataStream recordStream(&record, QIODevice::WriteOnly);
+  recordStream << static_cast<quint32>(data.size()) <<
+    qChecksum(QByteArrayView(data));
+  recordStream.writeRawData(data.constData(), data.size());
+
+  buffer_ += record;
+  if (buffer_.size() >= SYNC_BYTES) {
+    sync();
+  }
+  else if (!syncTimer_.isActive()) {
+    syncTimer_.start(SYNC_DELAY);
+  }
+}
+
+void historyJournal::squareEdit(int imageIndex, const historyItemPtr& item) {
+
+  if (current_) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    item->toBinary(&stream);
+    current_->append(J_SQUARE_EDIT, imageIndex, payload);
+  }
+}
+
+void historyJournal::squareMove(int imageIndex, bool forward) {
+
+  if (current_) {
+    current_->append(forward ? J_SQUARE_FORWARD : J_SQUARE_BACK,
+                     imageIndex, QByteArray());
+  }
+}
+
+void historyJournal::patternEdit(int imageIndex, const historyIndex& index) {
+
+  if (current_) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    ::writeSignedVarint(&stream, index.oldIndex());
+    ::writeSignedVarint(&stream, index.newIndex());
+    ::writeRgb(&stream, index.color().qrgb());
+    current_->append(J_PATTERN_EDIT, imageIndex, payload);
+  }
+}
+
+void historyJournal::patternMove(int imageIndex, bool forward) {
+
+  if (current_) {
+    current_->append(forward ? J_PATTERN_FORWARD : J_PATTERN_BACK,
+                     imageIndex, QByteArray());
+  }
+}
+
+int historyJournal::replay(const QString& projectFile, QDomDocument* doc) {
+
+  QFile file(journalFilename(projectFile));
+  if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+    return 0;
+  }
+  QList<QByteArray> records;
+  if (::readJournal(&file, projectFile, &records) == -1) {
+    return 0;
+  }
+
+  const QHash<int, QDomElement> squareImages =
+    ::imagesByIndex(*doc, "square_window_image");
+  const QHash<int, QDomElement> patternImages =
+    ::imagesByIndex(*doc, "pattern_window_image");
+  int recordsApplied = 0;
+  for (int i = 0, size = records.size(); i < size; ++i) {
+    QDataStream stream(records[i]);
+    quint8 type = 0;
+    stream >> type;
+    const int imageIndex = ::readVarint(&stream);
+    bool applied = false;
+    switch (type) {
+    case J_SQUARE_EDIT: {
+      const historyItemPtr item = historyItem::binaryToHistoryItem(&stream);
+      QDomElement history =
+        ::historyElement(doc, squareImages.value(imageIndex), "history");
+      if (item && !history.isNull()) {
+        QDomElement back(::startNewEdit(doc, &history));
+        item->toXml(doc, &back);
+        ::updateCount(&back);
+        applied = true;
+      }
+      break;
+    }
+    case J_SQUARE_BACK:
+    case J_SQUARE_FORWARD: {
+      QDomElement history =
+        ::historyElement(doc, squareImages.value(imageIndex), "history");
+      applied = !history.isNull() &&
+        ::moveHistoryItem(doc, &history, type == J_SQUARE_FORWARD);
+      break;
+    }
+    case J_PATTERN_EDIT: {
+      const int oldIndex = ::readSignedVarint(&stream);
+      const int newIndex = ::readSignedVarint(&stream);
+      const QRgb color = ::readRgb(&stream);
+      QDomElement history = ::historyElement(doc,
+                                             patternImages.value(imageIndex),
+                                             "symbol_history");
+      if (stream.status() == QDataStream::Ok && !history.isNull()) {
+        QDomElement back(::startNewEdit(doc, &history));
+        ::appendTextElement(doc, "history_item",
+                            historyIndex(oldIndex, newIndex,
+                                         triC(color)).toString(),
+                            &back);
+        ::updateCount(&back);
+        applied = true;
+      }
+      break;
+    }
+    case J_PATTERN_BACK:
+    case J_PATTERN_FORWARD: {
+      QDomElement history = ::historyElement(doc,
+                                             patternImages.value(imageIndex),
+                                             "symbol_history");
+      applied = !history.isNull() &&
+        ::moveHistoryItem(doc, &history, type == J_PATTERN_FORWARD);
+      break;
+    }
+    default:
+      qWarning() << "Bad record type in history journal:" << type;
+    }
+    if (applied) {
+      ++recordsApplied;
+    }
+  }
+  return recordsApplied;
+}
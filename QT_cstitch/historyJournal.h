@@ -0,0 +1,111 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef HISTORYJOURNAL_H
+#define HISTORYJOURNAL_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+
+#include "squareToolHistories.h"
+
+class QFile;
+class QDomDocument;
+class historyIndex;
+
+//
+// historyJournal is an append only autosave log of square and pattern
+// edits, kept next to the project file (as <project>.journal).  Every
+// edit, undo and redo made after the last full save is appended to the
+// journal in compact binary form as it happens, so the cost of saving an
+// edit is proportional to the size of the edit, not of the project.
+// Records are buffered and written (and synced to disk) in batches.
+//
+// On open, the journal is replayed on top of the project xml before the
+// project is restored (so the restore sees the edits as if they'd been
+// saved).  On an explicit save the journal is compacted: records already
+// contained in the save are dropped.
+//
+// The journal is only valid for the exact project file it was started
+// on (the journal header holds a fingerprint of that file).  Edits to
+// images created since the last save can't be replayed (the project has
+// no record of the images) and are skipped.
+//
+// There's only one journal (owned by windowManager); the edit recording
+// functions are static and do nothing if there's no active journal.
+//
+class historyJournal : public QObject {
+
+  Q_OBJECT
+
+ public:
+  historyJournal();
+  ~historyJournal();
+  // Start journaling for <projectFile>.  If there's already a journal
+  // for the current version of <projectFile> its records are kept,
+  // otherwise the journal starts out empty.
+  void start(const QString& projectFile);
+  // Stop journaling and delete the journal (unsaved work is being
+  // abandoned).
+  void discard();
+  // Return the current end of the journal, to be passed to compact once
+  // a save started now finishes (-1 if there's no active journal).
+  qint64 position();
+  // A save of the project as of journal <position> has been written to
+  // <projectFile>; restart the journal for <projectFile>, keeping only
+  // the records made after <position>.
+  void compact(const QString& projectFile, qint64 position);
+  // Apply the journal records for <projectFile> (if any) to its xml
+  // <doc>.  Return the number of records applied.
+  static int replay(const QString& projectFile, QDomDocument* doc);
+
+  // record a new square image edit <item> for image <imageIndex>
+  static void squareEdit(int imageIndex, const historyItemPtr& item);
+  // record a square image undo (!<forward>) or redo (<forward>)
+  static void squareMove(int imageIndex, bool forward);
+  // record a new pattern symbol change <index> for image <imageIndex>
+  static void patternEdit(int imageIndex, const historyIndex& index);
+  // record a pattern image undo (!<forward>) or redo (<forward>)
+  static void patternMove(int imageIndex, bool forward);
+
+ private slots:
+  // write any buffered records and sync them to disk
+  void sync();
+
+ private:
+  // append a record of <type> for <imageIndex> with <payload> data
+  void append(int type, int imageIndex, const QByteArray& payload);
+  // close the journal file (after syncing it)
+  void close();
+  static QString journalFilename(const QString& projectFile) {
+    return projectFile + ".journal";
+  }
+
+ private:
+  QFile* file_; // NULL if not journaling
+  QByteArray buffer_; // records not yet written to file_
+  QTimer syncTimer_;
+  // the active journal (if any)
+  static historyJournal* current_;
+};
+
+#endif
@@ -0,0 +1,294 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "historyStore.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSettings>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QDir>
+
+#include <QtXml/QDomDocument>
+
+#include "xmlUtility.h"
+
+// the default history memory cap, in megabytes
+static const int DEFAULT_HISTORY_CAP = 64;
+
+qint64 historySpillFile::write(const QByteArray& data) {
+
+  if (!file_) {
+    file_ = QSharedPointer<QTemporaryFile>(
+      new QTemporaryFile(QDir::tempPath() + "/cstitch_history_XXXXXX"));
+    if (!file_->open()) {
+      qWarning() << "Unable to open history spill file:" <<
+        file_->errorString();
+      file_.clear();
+      return -1;
+    }
+  }
+  const qint64 offset = file_->size();
+  // (flushed, since a history snapshot may read it with its own handle)
+  if (!file_->seek(offset) || file_->write(data) != data.size() ||
+      !file_->flush()) {
+    qWarning() << "Unable to write history spill file:" <<
+      file_->errorString();
+    return -1;
+  }
+  return offset;
+}
+
+void historySpillFile::reset() {
+
+  file_.clear();
+}
+
+QByteArray historySpillFile::read(qint64 offset, int length) const {
+
+  if (!file_ || !file_->seek(offset)) {
+    return QByteArray();
+  }
+  return file_->read(length);
+}
+
+qint64 historySpillFile::memoryCap() {
+
+  static qint64 cap = -1;
+  if (cap == -1) {
+    const QSettings settings("cstitch", "cstitch");
+    const int megabytes =
+      settings.value("history_memory_cap_mb", DEFAULT_HISTORY_CAP).toInt();
+    cap = static_cast<qint64>(qMax(megabytes, 1)) * 1024 * 1024;
+  }
+  return cap;
+}
+
+historyItemPtr historyList::at(int i) const {
+
+  return pageIn(entries_[i]);
+}
+
+historyItemPtr historyList::pageIn(const historyEntry& entry) const {
+
+  if (entry.item) {
+    return entry.item;
+  }
+  const QByteArray data = spillFile_->read(entry.offset, entry.length);
+  QDataStream stream(data);
+  const historyItemPtr item = historyItem::binaryToHistoryItem(&stream);
+  if (!item) {
+    qWarning() << "Unable to read spilled history item at" << entry.offset;
+  }
+  return item;
+}
+
+void historyList::push_back(const historyItemPtr& item) {
+
+  const historyEntry entry(item);
+  entries_.push_back(entry);
+  addEntry(entry);
+}
+
+void historyList::push_front(const historyItemPtr& item) {
+
+  const historyEntry entry(item);
+  entries_.push_front(entry);
+  addEntry(entry);
+}
+
+void historyList::clear() {
+
+  entries_.clear();
+  residentBytes_ = 0;
+  spilledBytes_ = 0;
+}
+
+bool historyList::takeResident(int i, historyEntry* entry) {
+
+  historyEntry thisEntry = entries_[i];
+  if (!thisEntry.item) {
+    thisEntry.item = pageIn(thisEntry);
+    if (!thisEntry.item) {
+      return false;
+    }
+    thisEntry.bytes = thisEntry.item->byteCount();
+  }
+  removeEntry(entries_.takeAt(i));
+  *entry = thisEntry;
+  return true;
+}
+
+historyItemPtr historyList::moveFrontTo(historyList* other) {
+
+  historyEntry entry;
+  if (!takeResident(0, &entry)) {
+    return historyItemPtr(NULL);
+  }
+  other->entries_.push_back(entry);
+  other->addEntry(entry);
+  return entry.item;
+}
+
+historyItemPtr historyList::moveBackTo(historyList* other) {
+
+  historyEntry entry;
+  if (!takeResident(entries_.size() - 1, &entry)) {
+    return historyItemPtr(NULL);
+  }
+  other->entries_.push_front(entry);
+  other->addEntry(entry);
+  return entry.item;
+}
+
+bool historyList::usesSpillFile() const {
+
+  for (int i = 0, size = entries_.size(); i < size; ++i) {
+    if (entries_[i].offset != -1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool historyList::spill(int i) {
+
+  historyEntry& entry = entries_[i];
+  if (!entry.item) {
+    return true;
+  }
+  // an item that's already on disk doesn't need to be written again
+  if (entry.offset == -1) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    entry.item->toBinary(&stream);
+    const qint64 offset = spillFile_->write(data);
+    if (offset == -1) {
+      return false;
+    }
+    entry.offset = offset;
+    entry.length = data.size();
+  }
+  residentBytes_ -= entry.bytes;
+  spilledBytes_ += entry.length;
+  entry.item = historyItemPtr(NULL);
+  return true;
+}
+
+squareHistorySnapshot::
+squareHistorySnapshot(const QString& toolFlossTypePrefix,
+                      const historyList& backHistory,
+                      const historyList& forwardHistory)
+  : isNull_(false), toolFlossTypePrefix_(toolFlossTypePrefix),
+    backHistory_(references(backHistory)),
+    forwardHistory_(references(forwardHistory)) {
+
+  // (both lists use the same spill file)
+  spillFile_ = backHistory.spillFile()->sharedFile();
+  if (spillFile_) {
+    spillFileName_ = spillFile_->fileName();
+  }
+}
+
+QList<squareHistorySnapshot::itemReference>
+squareHistorySnapshot::references(const historyList& list) {
+
+  QList<itemReference> returnList;
+  returnList.reserve(list.size());
+  for (int i = 0, size = list.size(); i < size; ++i) {
+    itemReference reference;
+    reference.item = list.residentAt(i);
+    if (!reference.item) {
+      reference.offset = list.spillOffset(i);
+      reference.length = list.spillLength(i);
+    }
+    returnList.push_back(reference);
+  }
+  return returnList;
+}
+
+int squareHistorySnapshot::appendItems(const QList<itemReference>& items,
+                                       QIODevice* spill, QDomDocument* doc,
+                                       QDomElement* appendee) {
+
+  int count = 0;
+  for (int i = 0, size = items.size(); i < size; ++i) {
+    historyItemPtr item = items[i].item;
+    if (!item && spill && spill->seek(items[i].offset)) {
+      const QByteArray data = spill->read(items[i].length);
+      QDataStream stream(data);
+      item = historyItem::binaryToHistoryItem(&stream);
+    }
+    if (item) {
+      item->toXml(doc, appendee);
+      ++count;
+    }
+    else {
+      qWarning() << "Unable to read spilled history item at" <<
+        items[i].offset << "- left out of the saved history";
+    }
+  }
+  return count;
+}
+
+void squareHistorySnapshot::toXml(QDomDocument* doc,
+                                  QDomElement* appendee) const {
+
+  if (isNull_) {
+    return;
+  }
+
+  ::appendTextElement(doc, "tool_floss_type", toolFlossTypePrefix_,
+                      appendee);
+
+  if (backHistory_.empty() && forwardHistory_.empty()) {
+    return;
+  }
+
+  // our own handle, since the gui thread may be using the spill file
+  QFile spillFile(spillFileName_);
+  QIODevice* spill = NULL;
+  if (!spillFileName_.isEmpty()) {
+    if (spillFile.open(QIODevice::ReadOnly)) {
+      spill = &spillFile;
+    }
+    else {
+      qWarning() << "Unable to open history spill file:" <<
+        spillFile.errorString();
+    }
+  }
+
+  QDomElement history(doc->createElement("history"));
+  appendee->appendChild(history);
+
+  if (!backHistory_.empty()) {
+    QDomElement back(doc->createElement("backward_history"));
+    history.appendChild(back);
+    back.setAttribute("count", appendItems(backHistory_, spill, doc, &back));
+  }
+
+  if (!forwardHistory_.empty()) {
+    QDomElement forward(doc->createElement("forward_history"));
+    history.appendChild(forward);
+    forward.setAttribute("count",
+                         appendItems(forwardHistory_, spill, doc, &forward));
+  }
+}
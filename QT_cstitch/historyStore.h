@@ -0,0 +1,218 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QtCore/QList>
+#include <QtCore/QSharedData>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+
+#include "squareToolHistories.h"
+
+class QTemporaryFile;
+class QByteArray;
+class QIODevice;
+class QDomDocument;
+class QDomElement;
+
+// historySpillFile is a temporary file that history items are written to
+// when they're pushed out of memory.  Items are immutable once created,
+// so the file is append only: an item that's paged back in and later
+// spilled again reuses its original location.  The file is created on
+// first use and removed when this object is destroyed or reset() (once
+// no history item refers to it any more) - unless a history snapshot
+// still holds it, in which case it's removed when the snapshot is done.
+class historySpillFile {
+
+  Q_DISABLE_COPY(historySpillFile)
+
+ public:
+  historySpillFile() {}
+  // Append <data> to the file and return its offset, or -1 if the write
+  // failed.
+  qint64 write(const QByteArray& data);
+  // Return the <length> bytes at <offset> (empty on failure).
+  QByteArray read(qint64 offset, int length) const;
+  bool isOpen() const { return !file_.isNull(); }
+  // Remove the file; the next write starts a new one.  The caller must
+  // make sure no history item still refers to the old file.
+  void reset();
+  // Return the number of bytes of memory an image's history items may
+  // use before older items are spilled to disk, as set by the
+  // "history_memory_cap_mb" setting.
+  static qint64 memoryCap();
+  // Return the file (null if there isn't one); holding on to it keeps
+  // the file on disk.
+  QSharedPointer<QTemporaryFile> sharedFile() const { return file_; }
+
+ private:
+  QSharedPointer<QTemporaryFile> file_;
+};
+
+// historyList is a list of history items, any of which may be resident
+// in memory or "spilled" to a historySpillFile.  Accessors return the
+// item whether it's resident or not, reading a spilled item back from
+// disk as needed; the moveXTo functions move an item from one list to
+// another and leave it resident on the new list (the item moved is the
+// one about to be undone/redone).
+class historyList {
+
+  // a list entry: <item> is null if the item has been spilled; <offset>
+  // is -1 if the item has never been spilled
+  class historyEntry {
+   public:
+    historyEntry() : offset(-1), length(0), bytes(0) {}
+    explicit historyEntry(const historyItemPtr& historyItem)
+      : item(historyItem), offset(-1), length(0),
+        bytes(historyItem ? historyItem->byteCount() : 0) {}
+    historyItemPtr item;
+    qint64 offset;
+    int length;
+    qint64 bytes; // memory used by <item> when resident
+  };
+
+ public:
+  explicit historyList(historySpillFile* spillFile)
+    : spillFile_(spillFile), residentBytes_(0), spilledBytes_(0) {}
+  bool isEmpty() const { return entries_.isEmpty(); }
+  bool empty() const { return entries_.isEmpty(); }
+  int size() const { return entries_.size(); }
+  // Return the item at <i>; a spilled item is read back from disk but
+  // is not kept in memory.
+  historyItemPtr at(int i) const;
+  historyItemPtr operator[](int i) const { return at(i); }
+  historyItemPtr front() const { return at(0); }
+  historyItemPtr back() const { return at(entries_.size() - 1); }
+  void push_back(const historyItemPtr& item);
+  void push_front(const historyItemPtr& item);
+  void clear();
+  // Remove the front item and append it (resident) to <other>.
+  // Return the item moved, or null if it couldn't be read back from
+  // disk (in which case it stays where it was).
+  historyItemPtr moveFrontTo(historyList* other);
+  // Remove the back item and prepend it (resident) to <other>.
+  // Return the item moved, or null if it couldn't be read back from
+  // disk (in which case it stays where it was).
+  historyItemPtr moveBackTo(historyList* other);
+  // Write the item at <i> to the spill file and release its memory.
+  // Return false if the write failed (in which case the item stays in
+  // memory).
+  bool spill(int i);
+  bool isSpilled(int i) const { return !entries_[i].item; }
+  // Return the item at <i> if it's resident, otherwise null (without
+  // reading it from disk).
+  historyItemPtr residentAt(int i) const { return entries_[i].item; }
+  // Return the spill file offset and length of the item at <i> (-1 and 0
+  // if it has never been spilled).
+  qint64 spillOffset(int i) const { return entries_[i].offset; }
+  int spillLength(int i) const { return entries_[i].length; }
+  const historySpillFile* spillFile() const { return spillFile_; }
+  // Return true if any item on this list has been written to the spill
+  // file (whether or not it's resident now).
+  bool usesSpillFile() const;
+  // Return the (approximate) memory used by resident items.
+  qint64 residentBytes() const { return residentBytes_; }
+  // Return the disk space used by spilled items.
+  qint64 spilledBytes() const { return spilledBytes_; }
+
+ private:
+  // Return the item for <entry>, reading it from disk if necessary.
+  historyItemPtr pageIn(const historyEntry& entry) const;
+  void addEntry(const historyEntry& entry) {
+    if (entry.item) {
+      residentBytes_ += entry.bytes;
+    }
+    else {
+      spilledBytes_ += entry.length;
+    }
+  }
+  void removeEntry(const historyEntry& entry) {
+    if (entry.item) {
+      residentBytes_ -= entry.bytes;
+    }
+    else {
+      spilledBytes_ -= entry.length;
+    }
+  }
+  // Remove the entry at <i> and return it in <entry> with its item
+  // resident; return false (leaving the entry on the list) if the item
+  // couldn't be read back from disk.
+  bool takeResident(int i, historyEntry* entry);
+
+ private:
+  historySpillFile* spillFile_; // not owned
+  QList<historyEntry> entries_;
+  qint64 residentBytes_;
+  qint64 spilledBytes_;
+};
+
+// squareHistorySnapshot is a copy of a square image's edit history at
+// some point in time.  History items are immutable (and their reference
+// counts are atomic), so a snapshot is cheap to take and can be written
+// out from another thread while the image continues to be edited.
+// Spilled items aren't read back when the snapshot is taken: the snapshot
+// keeps their spill file locations (and the file) and reads them with
+// its own file handle when it's written out.  Items that can't be read
+// back then are left out of the xml.
+class squareHistorySnapshot {
+
+ public:
+  squareHistorySnapshot() : isNull_(true) {}
+  squareHistorySnapshot(const QString& toolFlossTypePrefix,
+                        const historyList& backHistory,
+                        const historyList& forwardHistory);
+  bool isNull() const { return isNull_; }
+  int size() const { return backHistory_.size() + forwardHistory_.size(); }
+  // Append the tool floss type and the history as xml to <appendee>
+  // (a null snapshot appends nothing).
+  void toXml(QDomDocument* doc, QDomElement* appendee) const;
+
+ private:
+  // a snapshot item: <item> if it was resident, otherwise the <length>
+  // bytes at <offset> of the spill file
+  class itemReference {
+   public:
+    itemReference() : offset(-1), length(0) {}
+    historyItemPtr item;
+    qint64 offset;
+    int length;
+  };
+  static QList<itemReference> references(const historyList& list);
+  // Append the xml for the items on <items> to <appendee>, reading
+  // spilled items from <spill> (null if it couldn't be opened); return
+  // the number of items appended.
+  static int appendItems(const QList<itemReference>& items,
+                         QIODevice* spill, QDomDocument* doc,
+                         QDomElement* appendee);
+
+ private:
+  bool isNull_;
+  QString toolFlossTypePrefix_;
+  QList<itemReference> backHistory_;
+  QList<itemReference> forwardHistory_;
+  // the spill file the spilled items are on, kept on disk until the
+  // snapshot is done with it
+  QSharedPointer<QTemporaryFile> spillFile_;
+  QString spillFileName_;
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 #include "triC.h"
 #include "floss.h"
+#include "mipmapPyramid.h"
 
 extern const int ZOOM_INCREMENT;
 
@@ -90,6 +91,16 @@ class imageContainer : public QSharedData {
   virtual QImage scaledImage() const {
     return image().scaled(scaledSize_, Qt::IgnoreAspectRatio);
   }
+  // return a mipmap pyramid for image(), for zooming; the pyramid (and
+  // the levels built for it so far) is kept as long as image() doesn't
+  // change
+  mipmapPyramid pyramid() const {
+    if (pyramid_.isNull() ||
+        pyramid_.image().cacheKey() != image().cacheKey()) {
+      pyramid_ = mipmapPyramid(image());
+    }
+    return pyramid_;
+  }
   int originalWidth() const { return image().width(); }
   int originalHeight() const { return image().height(); }
   QSize originalSize() const { return image().size(); }
@@ -101,6 +112,7 @@ class imageContainer : public QSharedData {
   QSize scaledSize_; // current scaled size
   // are the colors for this image all of one floss type?
   const flossType flossType_;
+  mutable mipmapPyramid pyramid_;
 };
 // make imagePtr known to QVariant
 Q_DECLARE_METATYPE(imagePtr)
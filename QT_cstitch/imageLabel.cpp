@@ -54,17 +54,26 @@ void imageLabelBase::mouseReleaseEvent(QMouseEvent* event) {
 }
 
 imageLabel::imageLabel(QWidget* parent)
-  : imageLabelBase(parent), originalImage_(QPixmap()), scaledImage_(QPixmap()) {
+  : imageLabelBase(parent) {
 
   // don't clear window before painting
   setAttribute(Qt::WA_OpaquePaintEvent);
+  connect(&scaler_, SIGNAL(scaled(const QImage& )),
+          this, SLOT(scaleFinished(const QImage& )));
+  connect(&levelScaler_, SIGNAL(scaled(const QImage& )),
+          this, SLOT(levelFinished(const QImage& )));
 }
 
 imageLabel::imageLabel(const QPixmap& image, QWidget* parent)
-  : imageLabelBase(parent), originalImage_(image), scaledImage_(image) {
+  : imageLabelBase(parent), pyramid_(image.toImage()),
+    scaledSize_(image.size()), scaledImage_(pyramid_.image()) {
 
   // don't clear window before painting if there's no transparency
-  setAttribute(Qt::WA_OpaquePaintEvent, !originalImage_.hasAlpha());
+  setAttribute(Qt::WA_OpaquePaintEvent, !image.hasAlpha());
+  connect(&scaler_, SIGNAL(scaled(const QImage& )),
+          this, SLOT(scaleFinished(const QImage& )));
+  connect(&levelScaler_, SIGNAL(scaled(const QImage& )),
+          this, SLOT(levelFinished(const QImage& )));
   resize(image.width(), image.height());
 }
 
@@ -74,44 +83,169 @@ void imageLabel::paintEvent(QPaintEvent* event) {
   //painter.setRenderHint(QPainter::SmoothPixmapTransform);
 
   const QRectF viewRectangle(QRectF(event->rect()));
-  painter.drawPixmap(viewRectangle, scaledImage_, viewRectangle);
+  if (!scaledImage_.isNull()) {
+    painter.drawImage(viewRectangle, scaledImage_, viewRectangle);
+  }
+  else if (!placeholder_.isNull() && !scaledSize_.isEmpty()) {
+    // stretch the last exact scale until the new one arrives
+    const qreal xScale =
+      static_cast<qreal>(placeholder_.width())/scaledSize_.width();
+    const qreal yScale =
+      static_cast<qreal>(placeholder_.height())/scaledSize_.height();
+    const QRectF sourceRectangle(viewRectangle.x() * xScale,
+                                 viewRectangle.y() * yScale,
+                                 viewRectangle.width() * xScale,
+                                 viewRectangle.height() * yScale);
+    painter.drawImage(viewRectangle, placeholder_, sourceRectangle);
+  }
+  else if (!pyramid_.isNull() && !scaledSize_.isEmpty()) {
+    // scale just the visible region from the nearest level
+    const QImage& level = pyramid_.nearestLevel(scaledSize_);
+    const qreal xScale = static_cast<qreal>(level.width())/scaledSize_.width();
+    const qreal yScale =
+      static_cast<qreal>(level.height())/scaledSize_.height();
+    const QRectF sourceRectangle(viewRectangle.x() * xScale,
+                                 viewRectangle.y() * yScale,
+                                 viewRectangle.width() * xScale,
+                                 viewRectangle.height() * yScale);
+    painter.drawImage(viewRectangle, level, sourceRectangle);
+  }
   event->accept();
 }
 
 void imageLabel::setImageAndSize(const QPixmap& image) {
 
-  originalImage_ = image;
-  setAttribute(Qt::WA_OpaquePaintEvent, !originalImage_.hasAlpha());
-  scaledImage_ = image;
-  resize(scaledImage_.width(), scaledImage_.height());
-  update();
+  pyramid_ = mipmapPyramid(image.toImage());
+  levelScaler_.cancel();
+  setAttribute(Qt::WA_OpaquePaintEvent, !image.hasAlpha());
+  scaledSize_ = image.size();
+  // a stretched old image would be wrong, not just blurry
+  scaledImage_ = QImage();
+  placeholder_ = QImage();
+  rescale();
 }
 
 void imageLabel::updateImage(const QPixmap& image, const QRect& rectangle) {
 
-  originalImage_ = image;
-  setAttribute(Qt::WA_OpaquePaintEvent, !originalImage_.hasAlpha());
-  scaledImage_ = originalImage_.scaled(scaledImage_.size());
+  updateImage(mipmapPyramid(image.toImage()), rectangle);
+}
+
+void imageLabel::updateImage(const mipmapPyramid& pyramid,
+                             const QRect& rectangle) {
+
+  pyramid_ = pyramid;
+  levelScaler_.cancel();
+  setAttribute(Qt::WA_OpaquePaintEvent, !pyramid_.image().hasAlphaChannel());
+  scaledImage_ = QImage();
+  placeholder_ = QImage();
+  if (scaledSize_.isEmpty()) {
+    scaledSize_ = pyramid_.size();
+  }
+  rescale();
   rectangle.isNull() ? update() : update(rectangle);
 }
 
 void imageLabel::setImageWidth(int width) {
 
-  scaledImage_ = originalImage_.scaledToWidth(width);
-  resize(scaledImage_.width(), scaledImage_.height());
-  update();
+  const QSize originalSize = pyramid_.size();
+  if (originalSize.isEmpty()) {
+    return;
+  }
+  const int height =
+    qMax(qRound(originalSize.height() *
+                static_cast<qreal>(width)/originalSize.width()), 1);
+  scaledSize_ = QSize(width, height);
+  rescale();
 }
 
 void imageLabel::setImageHeight(int height) {
 
-  scaledImage_ = originalImage_.scaledToHeight(height);
-  resize(scaledImage_.width(), scaledImage_.height());
-  update();
+  const QSize originalSize = pyramid_.size();
+  if (originalSize.isEmpty()) {
+    return;
+  }
+  const int width =
+    qMax(qRound(originalSize.width() *
+                static_cast<qreal>(height)/originalSize.height()), 1);
+  scaledSize_ = QSize(width, height);
+  rescale();
 }
 
 void imageLabel::setImageSize(const QSize& size) {
 
-  scaledImage_ = originalImage_.scaled(size);
-  resize(scaledImage_.size());
+  scaledSize_ = size;
+  rescale();
+}
+
+void imageLabel::rescale() {
+
+  const QSize originalSize = pyramid_.size();
+  if (!scaledImage_.isNull()) {
+    placeholder_ = scaledImage_;
+  }
+  scaledImage_ = QImage();
+  if (scaledSize_ == originalSize) {
+    scaledImage_ = pyramid_.image();
+    placeholder_ = QImage();
+    scaler_.cancel();
+  }
+  else if (isShrunk()) {
+    // (enlargements are painted straight from the image, which is
+    // already what a full enlargement would give)
+    scaleFromPyramid();
+  }
+  else {
+    placeholder_ = QImage();
+    scaler_.cancel();
+  }
+  resize(scaledSize_);
   update();
 }
+
+bool imageLabel::isShrunk() const {
+
+  const QSize originalSize = pyramid_.size();
+  return !scaledSize_.isEmpty() && scaledSize_ != originalSize &&
+    scaledSize_.width() <= originalSize.width() &&
+    scaledSize_.height() <= originalSize.height();
+}
+
+void imageLabel::scaleFromPyramid() {
+
+  const QSize nextLevelSize = pyramid_.nextLevelSize(scaledSize_);
+  if (!nextLevelSize.isEmpty()) {
+    // the exact scale waits for the levels; a level already being built
+    // will carry on to the newest size when it's done
+    scaler_.cancel();
+    if (!levelScaler_.isBusy()) {
+      levelScaler_.scale(pyramid_.lastLevel(), nextLevelSize);
+    }
+  }
+  else {
+    scaler_.scale(pyramid_.nearestLevel(scaledSize_), scaledSize_);
+  }
+}
+
+void imageLabel::levelFinished(const QImage& level) {
+
+  // (if addLevel fails, another label sharing the pyramid may already
+  // have added this level, so carry on either way)
+  pyramid_.addLevel(level);
+  if (isShrunk() && scaledImage_.isNull()) {
+    scaleFromPyramid();
+    // paint from the better level meanwhile
+    if (placeholder_.isNull()) {
+      update();
+    }
+  }
+}
+
+void imageLabel::scaleFinished(const QImage& image) {
+
+  // make sure the result is still wanted
+  if (image.size() == scaledSize_ && scaledImage_.isNull()) {
+    scaledImage_ = image;
+    placeholder_ = QImage();
+    update();
+  }
+}
@@ -22,6 +22,9 @@
 
 #include <QtWidgets/QWidget>
 
+#include "asyncScaler.h"
+#include "mipmapPyramid.h"
+
 class imageLabelBase : public QWidget {
 
   Q_OBJECT
@@ -60,7 +63,16 @@ class imageLabelBase : public QWidget {
 //
 //// Implementation notes
 //
-// imageLabel holds its image as a QPixmap for quick display.
+// imageLabel holds its image as a mipmapPyramid, so a zoom never scales
+// the whole image: the label just records the new size and paints the
+// visible region from the nearest pyramid level built so far.  When the
+// image is shrunk, any missing levels down to the new size are built in
+// the background (one at a time, painting from each as it arrives), and
+// then a smooth scale of the whole image to the new size is computed in
+// the background (from the nearest level) and painted directly once it's
+// done.  Until then the last exact scale is stretched to the new size as
+// a placeholder, and zooms that come in while a scale is running only
+// keep the newest size (see asyncScaler).
 // The image is actually painted on the widget (not displayed on a QLabel).
 // If mouseTracking is on then this widget emits signals for mouse presses,
 // releases, and moves.
@@ -72,18 +84,22 @@ class imageLabel : public imageLabelBase {
  public:
   explicit imageLabel(QWidget* parent);
   imageLabel(const QPixmap& image, QWidget* parent);
-  bool imageIsNull() const { return originalImage_.isNull(); }
+  bool imageIsNull() const { return pyramid_.isNull(); }
   // the current scaled width
-  int width() const { return scaledImage_.width(); }
+  int width() const { return scaledSize_.width(); }
   // the current scaled height
-  int height() const { return scaledImage_.height(); }
-  QSize size() const { return scaledImage_.size(); }
-  int originalWidth() const { return originalImage_.width(); }
-  int originalHeight() const { return originalImage_.height(); }
+  int height() const { return scaledSize_.height(); }
+  QSize size() const { return scaledSize_; }
+  int originalWidth() const { return pyramid_.size().width(); }
+  int originalHeight() const { return pyramid_.size().height(); }
   void setMouseTracking(bool b) { QWidget::setMouseTracking(b); }
   // set a new <image> and redraw the <rectangle> portion of the widget,
   // but don't change the current image size settings
   void updateImage(const QPixmap& image, const QRect& rectangle = QRect());
+  // as above, but with an existing pyramid for the image (so that its
+  // levels are shared)
+  void updateImage(const mipmapPyramid& pyramid,
+                   const QRect& rectangle = QRect());
   // sets a new image and resets the size settings to <image>
   void setImageAndSize(const QPixmap& image);
   // change the displayed image width to <width> and set height to maintain
@@ -97,9 +113,33 @@ class imageLabel : public imageLabelBase {
   virtual void paintEvent(QPaintEvent* event);
 
  private:
-  QPixmap originalImage_;
-  QPixmap scaledImage_;
+  // the scaled size changed: resize, repaint from the pyramid, and start
+  // the background scale if the image is being shrunk
+  void rescale();
+  // start building the next missing pyramid level for scaledSize_ or, if
+  // there isn't one, the background scale to scaledSize_
+  void scaleFromPyramid();
+  // true if the image is currently shown smaller than its original size
+  bool isShrunk() const;
+
+ private slots:
+  // the background scale to <image> finished
+  void scaleFinished(const QImage& image);
+  // the background build of pyramid level <level> finished
+  void levelFinished(const QImage& level);
+
+ private:
+  mipmapPyramid pyramid_;
+  QSize scaledSize_;
+  // the image at exactly scaledSize_, if it's been computed (null
+  // otherwise)
+  QImage scaledImage_;
+  // the last exact scale, stretched while a new one is being computed
+  // (null if there isn't one)
+  QImage placeholder_;
+  asyncScaler scaler_;
+  // builds pyramid levels
+  asyncScaler levelScaler_;
 };
 
 #endif
-
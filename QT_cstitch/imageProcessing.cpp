@@ -23,8 +23,12 @@
 
 #include <QtCore/QTime>
 #include <QtCore/QStack>
+#include <QtCore/QRect>
+#include <QtCore/QThread>
 #include <QCollator>
 
+#include <QtConcurrent/QtConcurrentMap>
+
 #include "colorLists.h"
 #include "grid.h"
 #include "utility.h"
@@ -440,6 +444,156 @@ QVector<triC> chooseColors(const QImage& image,
                               transformer);
 }
 
+// detailHistogram counts the colors of a chunk of detail squares on an
+// image; the chunk counts are summed by mergeColorCounts
+class detailHistogram {
+
+ public:
+  typedef QHash<QRgb, int> result_type;
+  detailHistogram(const QImage& image, int dimension)
+    : image_(image), dimension_(dimension) {}
+  QHash<QRgb, int> operator()(const QList<pixel>& squares) const {
+
+    QHash<QRgb, int> colorCount;
+    for (QList<pixel>::const_iterator it = squares.constBegin(),
+           end = squares.constEnd(); it != end; ++it) {
+      const int xStart = it->x() * dimension_;
+      const int yStart = it->y() * dimension_;
+      for (int j = yStart, yEnd = yStart + dimension_; j < yEnd; ++j) {
+        for (int i = xStart, xEnd = xStart + dimension_; i < xEnd; ++i) {
+          ++colorCount[image_.pixel(i, j)];
+        }
+      }
+    }
+    return colorCount;
+  }
+
+ private:
+  const QImage image_;
+  const int dimension_;
+};
+
+static void mergeColorCounts(QHash<QRgb, int>& total,
+                             const QHash<QRgb, int>& chunk) {
+
+  for (QHash<QRgb, int>::const_iterator it = chunk.constBegin(),
+         end = chunk.constEnd(); it != end; ++it) {
+    total[it.key()] += it.value();
+  }
+}
+
+// detailSquareColor chooses the new color for one detail square: its
+// pixels in the original image are matched to the nearest of the chosen
+// colors (segment), then the matched color with the smallest distance
+// sum over the square wins (median), unless the square's old color does
+// better.  The square's pixels are only read once.
+class detailSquareColor {
+
+ public:
+  typedef historyPixel result_type;
+  detailSquareColor(const QImage& originalImage, const QVector<triC>& colors,
+                    int dimension)
+    : originalImage_(originalImage), colors_(colors),
+      dimension_(dimension) {}
+  historyPixel operator()(const pixel& square) const {
+
+    const int xStart = square.x() * dimension_;
+    const int yStart = square.y() * dimension_;
+    const int squareSize = dimension_ * dimension_;
+    QVector<triC> original;
+    original.reserve(squareSize);
+    QVector<triC> segmented;
+    segmented.reserve(squareSize);
+    QRgb previousColor = 0;
+    triC previousMatch;
+    for (int j = yStart, yEnd = yStart + dimension_; j < yEnd; ++j) {
+      for (int i = xStart, xEnd = xStart + dimension_; i < xEnd; ++i) {
+        const QRgb thisColor = originalImage_.pixel(i, j);
+        original.push_back(thisColor);
+        if (!previousMatch.isValid() || thisColor != previousColor) {
+          int min = D_MAX;
+          int chosenIndex = 0;
+          for (int k = 0, size = colors_.size(); k < size; ++k) {
+            const int tmpMin = ::ds(thisColor, colors_[k]);
+            if (tmpMin < min) {
+              min = tmpMin;
+              chosenIndex = k;
+            }
+          }
+          previousColor = thisColor;
+          previousMatch = colors_[chosenIndex];
+        }
+        segmented.push_back(previousMatch);
+      }
+    }
+
+    // (candidates are tried in pixel order, as median does, so ties go
+    // the same way)
+    int smallestSum = D_SUM_MAX;
+    triC chosenColor = segmented[0];
+    QVector<triC> colorsComputed;
+    for (int p = 0; p < squareSize; ++p) {
+      const triC thisColor = segmented[p];
+      if (colorsComputed.contains(thisColor)) {
+        continue;
+      }
+      colorsComputed.push_back(thisColor);
+      int distanceSum = 0;
+      for (int q = 0; q < squareSize && distanceSum <= smallestSum; ++q) {
+        distanceSum += ::ds(original[q], thisColor);
+      }
+      if (distanceSum <= smallestSum) {
+        smallestSum = distanceSum;
+        chosenColor = thisColor;
+      }
+    }
+    const triC oldColor(square.color());
+    int oldColorSum = 0;
+    for (int q = 0; q < squareSize; ++q) {
+      oldColorSum += ::ds(original[q], oldColor);
+    }
+    if (oldColorSum < smallestSum) {
+      chosenColor = oldColor;
+    }
+    return historyPixel(square.coordinates(), square.color(),
+                        chosenColor.qrgb(), false);
+  }
+
+ private:
+  const QImage originalImage_;
+  const QVector<triC> colors_;
+  const int dimension_;
+};
+
+QVector<historyPixel> computeDetailing(const QImage& originalImage,
+                                       const QList<pixel>& squaresList,
+                                       int dimension, int numColors,
+                                       const colorTransformerPtr& transformer) {
+
+  if (squaresList.isEmpty()) {
+    return QVector<historyPixel>();
+  }
+  // the histogram is counted in a few chunks per thread
+  const int chunkCount = qMin(squaresList.size(),
+                              4 * QThread::idealThreadCount());
+  const int chunkSize = (squaresList.size() + chunkCount - 1)/chunkCount;
+  QList<QList<pixel> > chunks;
+  for (int i = 0, size = squaresList.size(); i < size; i += chunkSize) {
+    chunks.push_back(squaresList.mid(i, chunkSize));
+  }
+  const QHash<QRgb, int> colorCount =
+    QtConcurrent::blockingMappedReduced<QHash<QRgb, int> >
+    (chunks, detailHistogram(originalImage, dimension), ::mergeColorCounts);
+  const QVector<triC> colors =
+    ::chooseColorsFromList(colorCount, QVector<QRgb>(), numColors,
+                           transformer);
+  if (colors.isEmpty()) {
+    return QVector<historyPixel>();
+  }
+  return QtConcurrent::blockingMapped<QVector<historyPixel> >
+    (squaresList, detailSquareColor(originalImage, colors, dimension));
+}
+
 QVector<triC> chooseColorsFromList(const QHash<QRgb, int>& colorCountMap,
                                    const QVector<QRgb> seedColors,
                                    int numColors,
@@ -671,6 +825,58 @@ void changeBlocks(QImage* newImage, const QVector<pixel>& pixels,
   }
 }
 
+// return the color of box (<boxX>, <boxY>) on <image>
+static inline QRgb boxColor(const QImage& image, int boxX, int boxY,
+                            int dimension) {
+
+  if (image.depth() == 32) {
+    return reinterpret_cast<const QRgb*>
+      (image.constScanLine(boxY*dimension))[boxX*dimension];
+  }
+  return image.pixel(boxX*dimension, boxY*dimension);
+}
+
+// color the square band of <image> from box (<left>, <boxY>) to
+// (<right>, <boxY>) with <color>, a pixel row at a time
+static void fillSquareSpan(QImage* image, int left, int right, int boxY,
+                           QRgb color, int dimension) {
+
+  const int xStart = left*dimension;
+  const int xEnd = (right + 1)*dimension;
+  const int yStart = boxY*dimension;
+  if (image->depth() == 32) {
+    for (int j = yStart, yEnd = yStart + dimension; j < yEnd; ++j) {
+      QRgb* line = reinterpret_cast<QRgb*>(image->scanLine(j));
+      std::fill(line + xStart, line + xEnd, color);
+    }
+  }
+  else {
+    for (int j = yStart, yEnd = yStart + dimension; j < yEnd; ++j) {
+      for (int i = xStart; i < xEnd; ++i) {
+        image->setPixel(i, j, color);
+      }
+    }
+  }
+}
+
+QVector<pixel> changeSquareRuns(QImage* newImage, const QVector<QRect>& runs,
+                                QRgb newColor, int dimension) {
+
+  QVector<pixel> oldSquares;
+  for (int i = 0, size = runs.size(); i < size; ++i) {
+    const QRect& run = runs[i];
+    const int boxY = run.top();
+    for (int boxX = run.left(); boxX <= run.right(); ++boxX) {
+      oldSquares.push_back(pixel(::boxColor(*newImage, boxX, boxY, dimension),
+                                 pairOfInts(boxX*dimension,
+                                            boxY*dimension)));
+    }
+    ::fillSquareSpan(newImage, run.left(), run.right(), boxY, newColor,
+                     dimension);
+  }
+  return oldSquares;
+}
+
 QVector<pairOfInts> fillRegion(QImage* newImage, int x, int y,
                                QRgb newColor, int dimension) {
 
@@ -679,108 +885,47 @@ QVector<pairOfInts> fillRegion(QImage* newImage, int x, int y,
     return QVector<pairOfInts>();
   }
 
-  newImage->setPixel(x, y, newColor);
-  const int width = newImage->width();
-  const int height = newImage->height();
-  // a stack of squares the neighbors of which are still being checked
-  QStack<pairOfInts> coordStack;
+  // scanline fill over the squares: each popped seed is grown left and
+  // right into a span, the span is written a pixel row at a time, and the
+  // rows above and below get one seed per run of oldColor under the span
+  const int xBoxes = newImage->width()/dimension;
+  const int yBoxes = newImage->height()/dimension;
   QVector<pairOfInts> returnSquares;
-  int i = (x/dimension)*dimension;
-  int j = (y/dimension)*dimension;
-  coordStack.push(pairOfInts(i, j));
-  returnSquares.push_back(pairOfInts(i/dimension, j/dimension));
-  for (int jj = j, jjStop = jj + dimension; jj < jjStop; ++jj) {
-    for (int ii = i, iiStop = ii + dimension; ii < iiStop; ++ii) {
-      newImage->setPixel(ii, jj, newColor);
-    }
-  }
-  while (1) {
-    // for each direction...
-    while (1) { // right
-      while (1) { // left
-        while (1) { // down
-          while (1) { // up
-            const int newJ = j - dimension;
-            if (newJ >= 0 && newImage->pixel(i, newJ) == oldColor) {
-              for (int jj = newJ, jjStop = newJ + dimension; jj < jjStop;
-                   ++jj) {
-                for (int ii = i, iiStop = i + dimension; ii < iiStop;
-                     ++ii) {
-                  newImage->setPixel(ii, jj, newColor);
-                }
-              }
-              j = newJ;
-              coordStack.push(pairOfInts(i, j));
-              returnSquares.push_back(pairOfInts(i/dimension, j/dimension));
-            }
-            else {
-              break;
-            }
-          } // end up
-          const int newJ = j + dimension;
-          if (newJ < height && newImage->pixel(i, newJ) == oldColor) {
-            for (int jj = newJ, jjStop = newJ + dimension; jj < jjStop;
-                 ++jj) {
-              for (int ii = i, iiStop = i + dimension; ii < iiStop; ++ii) {
-                newImage->setPixel(ii, jj, newColor);
-              }
-            }
-            j = newJ;
-            coordStack.push(pairOfInts(i, j));
-            returnSquares.push_back(pairOfInts(i/dimension, j/dimension));
-          }
-          else {
-            break;
-          }
-        } // end down
-        const int newI = i - dimension;
-        if (newI >= 0 && newImage->pixel(newI, j) == oldColor) {
-          for (int jj = j, jjStop = j + dimension; jj < jjStop; ++jj) {
-            for (int ii = newI, iiStop = newI + dimension; ii < iiStop;
-                 ++ii) {
-              newImage->setPixel(ii, jj, newColor);
-            }
-          }
-          i = newI;
-          coordStack.push(pairOfInts(i, j));
-          returnSquares.push_back(pairOfInts(i/dimension, j/dimension));
-        }
-        else {
-          break;
-        }
-      } // end left
-      const int newI = i + dimension;
-      if (newI < width && newImage->pixel(newI, j) == oldColor) {
-        for (int jj = j, jjStop = j + dimension; jj < jjStop; ++jj) {
-          for (int ii = newI, iiStop = newI + dimension; ii < iiStop;
-               ++ii) {
-            newImage->setPixel(ii, jj, newColor);
-          }
-        }
-        i = newI;
-        coordStack.push(pairOfInts(i, j));
-        returnSquares.push_back(pairOfInts(i/dimension, j/dimension));
+  QStack<pairOfInts> seeds;
+  seeds.push(pairOfInts(x/dimension, y/dimension));
+  while (!seeds.isEmpty()) {
+    const pairOfInts seed = seeds.pop();
+    const int j = seed.y();
+    // (a seed may have been filled since it was pushed)
+    if (::boxColor(*newImage, seed.x(), j, dimension) != oldColor) {
+      continue;
+    }
+    int left = seed.x();
+    while (left > 0 &&
+           ::boxColor(*newImage, left - 1, j, dimension) == oldColor) {
+      --left;
+    }
+    int right = seed.x();
+    while (right < xBoxes - 1 &&
+           ::boxColor(*newImage, right + 1, j, dimension) == oldColor) {
+      ++right;
+    }
+    ::fillSquareSpan(newImage, left, right, j, newColor, dimension);
+    for (int i = left; i <= right; ++i) {
+      returnSquares.push_back(pairOfInts(i, j));
+    }
+    for (int neighbor = j - 1; neighbor <= j + 1; neighbor += 2) {
+      if (neighbor < 0 || neighbor >= yBoxes) {
+        continue;
       }
-      else {
-        break;
-      }
-    } // end right
-
-    const int iLeft = i - dimension;
-    const int iRight = i + dimension;
-    const int jUp = j - dimension;
-    const int jDown = j + dimension;
-    if ((iLeft < 0 || newImage->pixel(iLeft, j) != oldColor) &&
-        (iRight >= width || newImage->pixel(iRight, j) != oldColor) &&
-        (jUp < 0 || newImage->pixel(i, jUp) != oldColor) &&
-        (jDown >= height || newImage->pixel(i, jDown) != oldColor)) {
-      coordStack.pop();
-      if (!coordStack.isEmpty()) {
-        i = coordStack.top().x();
-        j = coordStack.top().y();
-      }
-      else {
-        break;
+      bool inRun = false;
+      for (int i = left; i <= right; ++i) {
+        const bool matches =
+          (::boxColor(*newImage, i, neighbor, dimension) == oldColor);
+        if (matches && !inRun) {
+          seeds.push(pairOfInts(i, neighbor));
+        }
+        inRun = matches;
       }
     }
   }
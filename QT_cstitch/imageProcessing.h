@@ -32,6 +32,7 @@ class pixel;
 class historyPixel;
 class pairOfInts;
 class QImage;
+class QRect;
 //template<class T> class QVector;
 template<class T> class QList;
 template<class T1, class T2> class QHash;
@@ -178,6 +179,20 @@ QVector<triC> median(QImage* newImage, const QImage& originalImage,
                      const QList<pixel>& squaresList,
                      const QVector<historyPixel>& oldColors, int dimension);
 
+// choose (up to) <numColors> colors for the squares on <squaresList>
+// (of dimension <dimension>) from their pixels in <originalImage>, then
+// pick the best of those colors for each square the way median does
+// (keeping the square's old color, the color on <squaresList>, if that
+// fits better).  This is chooseColors, segment and median fused into one
+// pass per square, run in parallel over the squares; nothing is written,
+// so it can run off the gui thread.
+// Returns the squares with their old and new colors (newColorIsNew is
+// left unset).
+QVector<historyPixel> computeDetailing(const QImage& originalImage,
+                                       const QList<pixel>& squaresList,
+                                       int dimension, int numColors,
+                                       const colorTransformerPtr& transformer);
+
 // choose (up to) <numColors> colors that best represent <image>; make
 // them all dmc colors if <dmcOut>.
 // See .cpp for the meaning of "best represent".
@@ -227,6 +242,14 @@ void changeBlocks(QImage* newImage, const QVector<T>& points,
 void changeBlocks(QImage* newImage, const QVector<pixel>& pixels,
                   int dimension, bool blockCoords = false);
 
+// change the squares covered by <runs> (box coordinate rectangles one
+// square high, as made by ::squareRuns) to <newColor>, a run of squares
+// at a time, where each square has dimension <dimension>.
+// Returns the old color of each square changed, at the square's (image
+// coordinate) upper left corner
+QVector<pixel> changeSquareRuns(QImage* newImage, const QVector<QRect>& runs,
+                                QRgb newColor, int dimension);
+
 // fill in the region including (<x>,<y>) with <newColor>, where each
 // square has dimension <dimension>.  The region is determined by moving
 // up, down, left, right, but _not_ diagonal.  (<x>, <y> are pixel
@@ -130,15 +130,42 @@ void imageSaverWindow::doNonPdfSave(const QString& outputFile,
   }
 }
 
+void imageSaverWindow::doStreamedSave(const QString& outputFile,
+                                      const imageStripRenderer& renderer) {
+
+  QString error;
+  if (!stripExporter::save(renderer, outputFile, &error) &&
+      !error.isEmpty()) {
+    qWarning() << "Streamed save failed:" << outputFile << error;
+    QMessageBox::warning(this, tr("Save failed"),
+                         tr("The image could not be saved to %1: %2")
+                         .arg(outputFile).arg(error));
+  }
+}
+
 void imageSaverWindow::processSaveImage() {
 
   //  QList<QByteArray> formats = QImageWriter::supportedImageFormats();
   QList<QByteArray> formats = QImageReader::supportedImageFormats();
   formats.insert(formats.begin(), "pdf");
+  const imageStripRendererPtr renderer = curImageStripRenderer();
+  if (renderer) { // we write tiffs ourselves
+    if (!formats.contains("tif")) {
+      formats.push_back("tif");
+    }
+    if (!formats.contains("tiff")) {
+      formats.push_back("tiff");
+    }
+  }
   const QString outputFile = getValidSaveFile(formats);
   if (outputFile.isEmpty()) {
     return;
   }
+  if (renderer && stripExporter::canStream(outputFile)) {
+    // memory use is bounded by the strip size, so no warning is needed
+    doStreamedSave(outputFile, *renderer);
+    return;
+  }
 
   const QSize curViewingSize = curImageViewSize();
   // 6000x6000 is "big"
@@ -171,10 +198,14 @@ void imageSaverWindow::processSaveImage() {
 
   const QImage saveImage = curImageForSaving();
   if (saveImage.isNull()) {
-    QMessageBox::warning(this, tr("Image is too large to save"),
-                         tr("Sorry, there wasn't enough memory to save "
-                            "at the current image size.  Try reducing "
-                            "the image's size before saving again."));
+    QString warning(tr("Sorry, there wasn't enough memory to save "
+                       "at the current image size.  Try reducing "
+                       "the image's size before saving again."));
+    if (renderer) {
+      warning += tr("  (Or save as a .tif, which can be saved at any "
+                    "size.)");
+    }
+    QMessageBox::warning(this, tr("Image is too large to save"), warning);
     return;
   }
   if (::extension(outputFile) == "pdf") {
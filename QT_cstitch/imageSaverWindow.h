@@ -21,6 +21,7 @@
 #define IMAGESAVERWINDOW_H
 
 #include "imageZoomWindow.h"
+#include "stripExporter.h"
 
 // class imageSaverWindow
 //
@@ -32,6 +33,9 @@
 //
 // The pure virtual function curImageForSaving() is used to
 // fetch whatever the derived widget considers to be the current image.
+// A derived widget that can also render its current image a strip at a
+// time (see curImageStripRenderer()) gets TIFF saves that stream the
+// image to disk without ever holding all of it.
 //
 class imageSaverWindow : public imageZoomWindow {
 
@@ -55,6 +59,12 @@ class imageSaverWindow : public imageZoomWindow {
   virtual QImage curImageForSaving() const = 0;
   // return the size of the current image
   virtual QSize curImageViewSize() const = 0;
+  // return a renderer for the current image (as curImageForSaving()
+  // would return it), or null if the current image can't be rendered in
+  // strips
+  virtual imageStripRendererPtr curImageStripRenderer() const {
+    return imageStripRendererPtr();
+  }
   // save <image> as a pdf to <outputFile> with default margins plus the
   // current image size (so not necessarily 8.5x11)
   void doPdfSave(const QString& outputFile, const QImage& image);
@@ -64,6 +74,9 @@ class imageSaverWindow : public imageZoomWindow {
   // supports compression then a popup is used to let the user select
   // compression/quality on a scale of 0 to 100.
   void doNonPdfSave(const QString& outputFile, const QImage& image);
+  // save <renderer>'s image to <outputFile> as a TIFF, a strip at a time
+  void doStreamedSave(const QString& outputFile,
+                      const imageStripRenderer& renderer);
   // get a file name from the user that ends in one of the extensions
   // listed in <formats>.  Loop until the user either enters a valid
   // filename or cancels.
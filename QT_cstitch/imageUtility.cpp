@@ -22,8 +22,6 @@
 #include <QtCore/QDebug>
 #include <QtCore/qmath.h>
 #include <QtWidgets/QWidget>
-#include <QPainter>
-#include <QPen>
 #include <QStringBuilder>
 
 extern const int D_MAX;
@@ -60,36 +58,6 @@ void showAndRaise(QWidget* widget) {
   }
 }
 
-void gridImage(QImage* image, int originalSquareDim,
-               int originalWidth, int originalHeight,
-               QRgb gridColor, qreal gridLineWidth) {
-
-  const int newWidth = image->width();
-  const int newHeight = image->height();
-  // scaled grid dims
-  const qreal xdim = originalSquareDim*newWidth/static_cast<qreal>(originalWidth);
-  const qreal ydim = originalSquareDim*newHeight/static_cast<qreal>(originalHeight);
-  if (xdim < 1.25 * gridLineWidth || ydim < 1.25 * gridLineWidth) {
-    // grid lines will take up nearly all of each square, so refuse to grid
-    return;
-  }
-
-  QPainter painter(image);
-  painter.setPen(QPen(QColor(gridColor), gridLineWidth));
-  for (qreal i = 0; i < newWidth; i += xdim) {
-    const int iInt = static_cast<int>(i);
-    painter.drawLine(QPoint(iInt, 0), QPoint(iInt, newHeight));
-  }
-  for (qreal j = 0; j < newHeight; j += ydim) {
-    const int jInt = static_cast<int>(j);
-    painter.drawLine(QPoint(0, jInt), QPoint(newWidth, jInt));
-  }
-  // grid lines are drawn on the left/top sides of squares, so we have
-  // to do the final right/bottom ones by hand
-  painter.drawLine(QPoint(newWidth-1, 0), QPoint(newWidth-1, newHeight));
-  painter.drawLine(QPoint(0, newHeight-1), QPoint(newWidth, newHeight-1));
-}
-
 int computeGridForImageFit(const QSize& imageSize,
                            const QSize& availableSize,
                            int originalSquareSize) {
@@ -172,15 +172,6 @@ int numberOfColors(const QImage& image);
 // display <widget> at the top level
 void showAndRaise(QWidget* widget);
 
-// Grid <image> using <gridColor> and <gridLineWidth>; <image> may be
-// scaled, so use <original> parameters to determine the proper grid
-// spacing for the scaled gridding.
-// If the scaled square size is too small compared to <gridLineWidth>, no gridding
-// will occur.
-void gridImage(QImage* image, int originalSquareDim,
-               int originalWidth, int originalHeight, QRgb gridColor,
-               qreal gridLineWidth = 1);
-
 // return the largest square size that would allow an image with
 // original size <imageSize> and original square size <originalSquareSize>
 // to fit into a region of size <availableSize>
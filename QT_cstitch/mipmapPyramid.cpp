@@ -0,0 +1,64 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "mipmapPyramid.h"
+
+// return true if a level of <levelSize> is too small (or too close) to
+// be halved on the way to <size>
+static bool isLevelFor(const QSize& levelSize, const QSize& size) {
+
+  const QSize halfSize = levelSize/2;
+  return halfSize.width() < size.width() ||
+    halfSize.height() < size.height() || halfSize.isEmpty();
+}
+
+const QImage& mipmapPyramid::nearestLevel(const QSize& size) const {
+
+  if (!d_) {
+    static const QImage nullImage;
+    return nullImage;
+  }
+  const QVector<QImage>& levels = d_->levels_;
+  for (int level = 0, last = levels.size() - 1; level < last; ++level) {
+    if (::isLevelFor(levels[level].size(), size)) {
+      return levels[level];
+    }
+  }
+  return levels.last();
+}
+
+QSize mipmapPyramid::nextLevelSize(const QSize& size) const {
+
+  if (isNull()) {
+    return QSize();
+  }
+  const QSize lastSize = d_->levels_.last().size();
+  return ::isLevelFor(lastSize, size) ? QSize() : lastSize/2;
+}
+
+bool mipmapPyramid::addLevel(const QImage& level) {
+
+  if (isNull() || level.size() != d_->levels_.last().size()/2 ||
+      level.isNull()) {
+    return false;
+  }
+  d_->levels_.push_back(level);
+  return true;
+}
@@ -0,0 +1,76 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef MIPMAPPYRAMID_H
+#define MIPMAPPYRAMID_H
+
+#include <QtCore/QSharedData>
+#include <QtCore/QVector>
+
+#include <QtGui/QImage>
+
+// mipmapPyramid holds an image and successively halved copies of it
+// (level n is 1/2^n the size of the image in each dimension), for
+// scaling the image to an arbitrary display size quickly: scaling from
+// the smallest level that's still at least the display size touches at
+// most about four source pixels per display pixel, no matter how big
+// the image is.
+//
+// Levels aren't built here: nearestLevel() returns the best level built
+// so far, and the owner builds the next level (nextLevelSize(), from
+// lastLevel()) wherever it likes - off the gui thread, say - and hands it
+// back with addLevel().  A mipmapPyramid is explicitly shared, so copies
+// (a label's and an image container's, say) share the levels built so
+// far.  Not thread safe - levels should only be requested and added from
+// the gui thread, although the returned images can be handed to other
+// threads.
+class mipmapPyramid {
+
+ public:
+  mipmapPyramid() {}
+  explicit mipmapPyramid(const QImage& image)
+    : d_(new pyramidData(image)) {}
+  bool isNull() const { return !d_ || d_->levels_[0].isNull(); }
+  // the full size image (level 0)
+  QImage image() const { return d_ ? d_->levels_[0] : QImage(); }
+  QSize size() const { return d_ ? d_->levels_[0].size() : QSize(); }
+  // return the smallest level built so far that's at least <size> in
+  // both dimensions (level 0 if <size> is bigger than the image)
+  const QImage& nearestLevel(const QSize& size) const;
+  // return the size of the next level to build on the way to the
+  // smallest level that's at least <size>, or an empty size if that
+  // level has already been built
+  QSize nextLevelSize(const QSize& size) const;
+  // the smallest level built so far
+  QImage lastLevel() const { return d_ ? d_->levels_.last() : QImage(); }
+  // add <level>, lastLevel() smoothly halved; return false (and don't
+  // add it) if it's not the size of the next level
+  bool addLevel(const QImage& level);
+
+ private:
+  class pyramidData : public QSharedData {
+   public:
+    explicit pyramidData(const QImage& image) { levels_.push_back(image); }
+    QVector<QImage> levels_;
+  };
+  QExplicitlySharedDataPointer<pyramidData> d_;
+};
+
+#endif
@@ -35,6 +35,7 @@
 #include "imageUtility.h"
 #include "patternDockWidget.h"
 #include "xmlUtility.h"
+#include "historyJournal.h"
 
 extern const int MAX_SYMBOL_SIZE;
 extern const int MIN_SYMBOL_SIZE;
@@ -68,8 +69,10 @@ patternImageContainer::patternImageContainer(const QImage& squareImage,
                                              const QString& imageName,
                                              int squareDimension,
                                              int baseSymbolDim,
-                                             const QVector<flossColor>& colors)
-  : ref(0), imageName_(imageName), squareDimension_(squareDimension),
+                                             const QVector<flossColor>& colors,
+                                             int imageIndex)
+  : ref(0), imageName_(imageName), imageIndex_(imageIndex),
+    squareDimension_(squareDimension),
     baseSymbolDim_(baseSymbolDim), symbolDimension_(baseSymbolDim),
     squareImage_(squareImage), flossColors_(colors),
     symbolChooser_(baseSymbolDim, patternImageContainer::colors()),
@@ -90,41 +93,60 @@ void patternImageContainer::generateColorSquares() {
 
 QImage patternImageContainer::patternImageCurSymbolSize() {
 
-  const QHash<QRgb, QPixmap> symbols =
-    symbolChooser_.getSymbols(symbolDimension_);
-  const int xBoxes = squareImage_.width()/squareDimension_;
-  const int yBoxes = squareImage_.height()/squareDimension_;
-  QImage returnImage(xBoxes * symbolDimension_, yBoxes * symbolDimension_,
-                     QImage::Format_RGB32);
+  QImage returnImage(patternSizeCurSymbolSize(), QImage::Format_RGB32);
   if (returnImage.isNull()) {
     qWarning() << "Empty Image in patternImageCurSymbolSize.";
     return QImage();
   }
-  QPainter painter(&returnImage);
-  painter.fillRect(0, 0, xBoxes * symbolDimension_,
-                   yBoxes * symbolDimension_, QColor(255, 255, 255));
-  QPixmap thisSymbol;
-  for (int j = 0; j < yBoxes; ++j) {
-    for (int i = 0; i < xBoxes; ++i) {
-      thisSymbol =
-        symbols[squareImage_.pixel(i * squareDimension_,
-                                   j * squareDimension_)];
-      if (!thisSymbol.isNull()) {
-        painter.drawPixmap(i*symbolDimension_, j*symbolDimension_,
-                           thisSymbol);
+  renderPatternStrip(atlasCurSymbolSize(), &returnImage, 0);
+  return returnImage;
+}
+
+void patternImageContainer::
+renderPatternStrip(const symbolAtlas& atlas, QImage* strip, int top) const {
+
+  strip->fill(qRgb(255, 255, 255));
+  atlas.render(squareImage_, squareDimension_, strip, QPoint(0, top));
+}
+
+QVector<QRect> patternImageContainer::stitchRuns(QRgb color) const {
+
+  if (stitchRuns_.isEmpty()) {
+    const QImage source = (squareImage_.depth() == 32) ? squareImage_ :
+      squareImage_.convertToFormat(QImage::Format_RGB32);
+    const int xBoxes = squareImage_.width()/squareDimension_;
+    const int yBoxes = squareImage_.height()/squareDimension_;
+    for (int j = 0; j < yBoxes; ++j) {
+      const QRgb* line = reinterpret_cast<const QRgb*>
+        (source.constScanLine(j*squareDimension_));
+      for (int i = 0; i < xBoxes; ) {
+        const QRgb runColor = line[i*squareDimension_];
+        const int runStart = i;
+        for (++i; i < xBoxes && line[i*squareDimension_] == runColor; ++i) {}
+        stitchRuns_[runColor].
+          push_back(QRect(QPoint(runStart, j), QPoint(i - 1, j)));
       }
-      else {
-        qWarning() << "Bad image in patternImage at" << i << j;
-        // fill it with red to make it obvious
-        QImage badSymbol(symbolDimension_, symbolDimension_,
-                         QImage::Format_RGB32);
-        badSymbol.fill(QColor(255, 0, 0).rgb());
-        painter.drawImage(i*symbolDimension_, j*symbolDimension_,
-                          badSymbol);
+    }
+  }
+  return stitchRuns_.value(color);
+}
+
+QHash<QRgb, int> patternImageContainer::stitchCounts() const {
+
+  if (stitchCounts_.isEmpty()) {
+    stitchRuns(0); // (builds the run index)
+    for (QHash<QRgb, QVector<QRect> >::const_iterator it =
+           stitchRuns_.constBegin(), end = stitchRuns_.constEnd();
+         it != end; ++it) {
+      int count = 0;
+      const QVector<QRect>& runs = it.value();
+      for (int i = 0, size = runs.size(); i < size; ++i) {
+        count += runs[i].width();
       }
+      stitchCounts_[it.key()] = count;
     }
   }
-  return returnImage;
+  return stitchCounts_;
 }
 
 bool patternImageContainer::changeSymbol(const triC& color) {
@@ -173,6 +195,13 @@ void patternImageContainer::setSymbolDimension(int dimension) {
   generateColorSquares();
 }
 
+void patternImageContainer::warmSymbolDimension(int dimension) const {
+
+  if (dimension >= MIN_SYMBOL_SIZE && dimension <= MAX_SYMBOL_SIZE) {
+    symbolChooser_.warmSymbols(dimension);
+  }
+}
+
 QPixmap patternImageContainer::symbolNoBorder(const triC& color,
                                               int symbolDim) {
 
@@ -216,6 +245,7 @@ void patternImageContainer::addToHistory(const historyIndex& historyRecord) {
 
   backHistory_.push_back(historyRecord);
   forwardHistory_.clear();
+  historyJournal::patternEdit(imageIndex_, historyRecord);
 }
 
 void patternImageContainer::moveHistoryForward() {
@@ -226,6 +256,7 @@ void patternImageContainer::moveHistoryForward() {
 
     const historyIndex historyRecord = backHistory_.back();
     updatePatternImage(historyRecord.color(), historyRecord.newIndex());
+    historyJournal::patternMove(imageIndex_, true);
   }
 }
 
@@ -237,6 +268,7 @@ void patternImageContainer::moveHistoryBack() {
 
     forwardHistory_.push_front(backHistory_.back());
     backHistory_.pop_back();
+    historyJournal::patternMove(imageIndex_, false);
   }
 }
 
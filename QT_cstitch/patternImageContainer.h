@@ -22,9 +22,11 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QMetaType>
+#include <QtCore/QRect>
 
 #include "triC.h"
 #include "symbolChooser.h"
+#include "symbolAtlas.h"
 
 class patternWindow;
 class QDomDocument;
@@ -75,17 +77,47 @@ class patternImageContainer : public QObject {
   // <squareImage> is the square image this pattern image is based on,
   // <squareDimension> is the square size of <squareImage>,
   // <baseSymbolDim> is the default initial symbol dimension,
-  // <colors> are the colors of <squareImage>
+  // <colors> are the colors of <squareImage>,
+  // <imageIndex> identifies this image in the history journal
   patternImageContainer(const QImage& squareImage,
                         const QString& imageName, int squareDimension,
-                        int baseSymbolDim, const QVector<flossColor>& colors);
+                        int baseSymbolDim, const QVector<flossColor>& colors,
+                        int imageIndex);
   // return the pattern image using the current symbol size setting
   QImage patternImageCurSymbolSize();
+  // return the size of patternImageCurSymbolSize()
+  QSize patternSizeCurSymbolSize() const {
+    return QSize((squareImage_.width()/squareDimension_)*symbolDimension_,
+                 (squareImage_.height()/squareDimension_)*symbolDimension_);
+  }
+  // return the symbol for <color> at the current symbol size
+  QPixmap symbolCurSymbolSize(const triC& color) {
+    return symbolChooser_.getSymbol(color, symbolDimension_).symbol();
+  }
+  // return the stitches of <color> as box coordinate rectangles, one per
+  // horizontal run of stitches
+  QVector<QRect> stitchRuns(QRgb color) const;
+  // return the number of stitches of each color (counted once, since
+  // the square image never changes)
+  QHash<QRgb, int> stitchCounts() const;
+  // return an atlas of the symbols for the current symbol size
+  symbolAtlas atlasCurSymbolSize() {
+    return symbolAtlas(symbolChooser_.getSymbols(symbolDimension_));
+  }
+  // render the rows of patternImageCurSymbolSize() starting at <top> onto
+  // <strip> (a Format_RGB32 image as wide as the pattern image and as tall
+  // as the number of rows wanted) using <atlas> (from
+  // atlasCurSymbolSize())
+  void renderPatternStrip(const symbolAtlas& atlas,
+                          QImage* strip, int top) const;
   const QImage& squareImage() const { return squareImage_; }
   // change the current symbol dimension and update colorSquares_ to have
   // the same dimension
   void setSymbolDimension(int dimension);
   int symbolDimension() const { return symbolDimension_; }
+  // start rendering the symbols at <dimension> in the background, for a
+  // likely upcoming setSymbolDimension(<dimension>)
+  void warmSymbolDimension(int dimension) const;
   // true if patternWindow is currently displaying the square version
   // of this square/pattern image combination
   bool viewingSquareImage() const { return viewingSquareImage_; }
@@ -146,6 +178,7 @@ class patternImageContainer : public QObject {
 
  private:
   QString imageName_;
+  const int imageIndex_;
   // the initial square image square dimension
   const int squareDimension_;
   // the initial symbol dimension
@@ -157,6 +190,10 @@ class patternImageContainer : public QObject {
   // handles construction and choice of symbols
   symbolChooser symbolChooser_;
   QHash<QRgb, QPixmap> colorSquares_;
+  // inverted index of squareImage_: the stitch runs (box coordinates)
+  // for each color, built on first use (squareImage_ never changes)
+  mutable QHash<QRgb, QVector<QRect> > stitchRuns_;
+  mutable QHash<QRgb, int> stitchCounts_; // also built on first use
   bool viewingSquareImage_; // is the image on screen the square image?
   // the most recent edit sits on the back of backHistory_
   QList<historyIndex> backHistory_;
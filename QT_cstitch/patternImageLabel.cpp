@@ -19,41 +19,67 @@
 
 #include "patternImageLabel.h"
 
+#include <QtCore/QSet>
+
 #include <QtGui/QPaintEvent>
 #include <QtGui/QMouseEvent>
 #include <QtGui/QPainter>
 
+#include "gridOverlay.h"
+
 void patternImageLabel::paintEvent(QPaintEvent* event) {
 
   // we only draw the portion of the image in the viewing rectangle
   const QRect viewRect = event->rect();
-  const int xBoxStart = viewRect.x()/patternDim_;
-  const int xStart = xBoxStart * patternDim_;
-  const int xEnd = viewRect.x() + viewRect.width();
-  const int yBoxStart = viewRect.y()/patternDim_;
-  const int yStart = yBoxStart * patternDim_;
-  const int yEnd = viewRect.y() + viewRect.height();
+  const symbolAtlas& atlas = viewingSquareImage_ ? squares_ : symbols_;
   QPainter painter(this);
-  const QHash<QRgb, QPixmap> imageHash =
-    viewingSquareImage_ ? squares_ : symbols_;
-  for (int j = yStart, yBox = yBoxStart;
-       j < yEnd; j += patternDim_, ++yBox) {
-    for (int i = xStart, xBox = xBoxStart;
-          i < xEnd; i += patternDim_, ++xBox) {
-      painter.drawPixmap(QPoint(i, j),
-                         imageHash[squareImage_.pixel(xBox*squareDim_,
-                                                      yBox*squareDim_)]);
-    }
+  // (the atlas lags patternDim_ only briefly while the symbols are
+  // being reset; we're opaque, so paint the background meanwhile)
+  if (atlas.dimension() == patternDim_) {
+    QImage buffer(viewRect.size(), QImage::Format_RGB32);
+    buffer.fill(palette().color(backgroundRole()).rgb());
+    atlas.render(squareImage_, squareDim_, &buffer, viewRect.topLeft());
+    painter.drawImage(viewRect.topLeft(), buffer);
+  }
+  else {
+    painter.fillRect(viewRect, palette().color(backgroundRole()));
   }
   if (gridOn_) {
-    painter.setPen(QColor(gridColor_));
-    for (int i = xStart; i < xEnd; i += patternDim_) {
-      painter.drawLine(QPoint(i, yStart), QPoint(i, yEnd));
-    }
-    for (int j = yStart; j < yEnd; j += patternDim_) {
-      painter.drawLine(QPoint(xStart, j), QPoint(xEnd, j));
+    gridOverlay(QSize(width_, height_), patternDim_, patternDim_,
+                gridColor_).draw(&painter, viewRect);
+  }
+}
+
+bool patternImageLabel::updateSymbol(QRgb color, const QPixmap& symbol,
+                                     const QVector<QRect>& stitches) {
+
+  if (!symbols_.replaceSymbol(color, symbol)) {
+    return false;
+  }
+  if (viewingSquareImage_) {
+    return true;
+  }
+  // one update per dirty tile instead of one per stitch run, so that
+  // thousands of runs don't build up a huge update region
+  const int TILE_SIZE = 256;
+  QSet<QPair<int, int> > dirtyTiles;
+  for (int i = 0, size = stitches.size(); i < size; ++i) {
+    const QRect& run = stitches[i];
+    const int yTileStart = (run.top()*patternDim_)/TILE_SIZE;
+    const int yTileEnd = ((run.bottom() + 1)*patternDim_ - 1)/TILE_SIZE;
+    const int xTileStart = (run.left()*patternDim_)/TILE_SIZE;
+    const int xTileEnd = ((run.right() + 1)*patternDim_ - 1)/TILE_SIZE;
+    for (int yTile = yTileStart; yTile <= yTileEnd; ++yTile) {
+      for (int xTile = xTileStart; xTile <= xTileEnd; ++xTile) {
+        const QPair<int, int> tile(xTile, yTile);
+        if (!dirtyTiles.contains(tile)) {
+          dirtyTiles.insert(tile);
+          update(xTile*TILE_SIZE, yTile*TILE_SIZE, TILE_SIZE, TILE_SIZE);
+        }
+      }
     }
   }
+  return true;
 }
 
 void patternImageLabel::mousePressEvent(QMouseEvent* event) {
@@ -24,6 +24,8 @@
 
 #include <QtWidgets/QWidget>
 
+#include "symbolAtlas.h"
+
 //
 // Display a square or a pattern image.  Since pattern images have to be
 // really large in order to read the symbols, we can't pass around entire
@@ -31,6 +33,8 @@
 // initial square image and then reconstituting (zoomed) square and
 // pattern images using a color->square and color->symbol hash
 // respectively - the user provides the hashes instead of actual images.
+// The hashes are kept as symbolAtlases, so painting is a matter of
+// copying atlas rows into a buffer for the exposed area.
 //
 class patternImageLabel : public QWidget {
 
@@ -59,11 +63,17 @@ class patternImageLabel : public QWidget {
   // display the square image if <b>, otherwise display the pattern image
   void viewSquareImage(bool b) { viewingSquareImage_ = b; update(); }
   void setSquares(const QHash<QRgb, QPixmap>& squares) {
-    squares_ = squares;
+    squares_ = symbolAtlas(squares);
   }
   void setSymbols(const QHash<QRgb, QPixmap>& symbols) {
-    symbols_ = symbols;
+    symbols_ = symbolAtlas(symbols);
   }
+  // the symbol for <color> is now <symbol>, at the current pattern
+  // dimension: repaint just <stitches> (<color>'s stitches as box
+  // coordinate rectangles).
+  // Return false if the label doesn't have a symbol for <color>.
+  bool updateSymbol(QRgb color, const QPixmap& symbol,
+                    const QVector<QRect>& stitches);
   QRgb gridColor() const { return gridColor_; }
   void setGridColor(QRgb color) { gridColor_ = color; update(); }
   void setGridOn(bool b) { gridOn_ = b; update(); }
@@ -97,8 +107,8 @@ class patternImageLabel : public QWidget {
   int patternDim_; // changes depending on zoom level
   bool gridOn_;
   QRgb gridColor_;
-  QHash<QRgb, QPixmap> squares_;
-  QHash<QRgb, QPixmap> symbols_;
+  symbolAtlas squares_;
+  symbolAtlas symbols_;
 };
 
 #endif
@@ -33,6 +33,8 @@
 #include "imageUtility.h"
 #include "colorLists.h"
 #include "utility.h"
+#include "gridOverlay.h"
+#include "symbolAtlas.h"
 
 // coordinates for progress meters (meters aren't parented, so we fix
 // constant coords instead of letting the system choose them randomly)
@@ -275,9 +277,9 @@ void patternPrinter::drawTitlePage(const patternMetadata& metadata) {
     squareImage = squareImage_.scaled(newWidth, newHeight,
                                       Qt::KeepAspectRatio,
                                       Qt::SmoothTransformation);
-    squareImage = gridedImage(squareImage, squareDim_,
-                              squareImageSize.width(),
-                              squareImageSize.height(), .2);
+    gridOverlay::forScaledImage(squareImage.size(), squareDim_,
+                                squareImageSize, Qt::black, .2).
+      drawOnStrip(&squareImage, 0);
   }
   else {
     // oops, we can't commit one (or more) pixels to each square of the pattern
@@ -310,16 +312,6 @@ void patternPrinter::drawTitleMetadata(int fontSize, bool bold,
   painter_.restore();
 }
 
-QImage patternPrinter::gridedImage(const QImage& image, int originalSquareDim,
-                                   int originalWidth, int originalHeight,
-                                   qreal gridLineWidth) const {
-  
-  QImage returnImage = image;
-  ::gridImage(&returnImage, originalSquareDim,
-              originalWidth, originalHeight, Qt::black, gridLineWidth);
-  return returnImage;
-}
-
 void patternPrinter::computeOrientationAndPageCounts() {
 
   int tWidthPerPage, tHeightPerPage; // temps
@@ -555,9 +547,8 @@ void patternPrinter::drawColorList(int startHeight) {
   QVector<typedFloss> flossVector = ::rgbToVerboseFloss(colors_);
   std::sort(flossVector.begin(), flossVector.end(), flossIntensity());
 
-  // build a color count map
-  QHash<QRgb, int> countsHash;
-  ::colorCounts(squareImage_, squareDim_, &countsHash);
+  // the container keeps the color counts
+  const QHash<QRgb, int> countsHash = imageContainer_->stitchCounts();
 
   QPixmap thisSymbol;
   QPainter symbolPainter;
@@ -688,8 +679,9 @@ bool patternPrinter::drawPatternPages() {
   int widthToUse = widthPerPage_;
   int heightToUse = heightPerPage_;
   const int f = 5; // fudge room for grid number separation from the grid
-  const QHash<QRgb, QPixmap> symbolMap =
-    imageContainer_->symbolsWithBorder(symbolSize_, symbolColorBorderWidth_);
+  const symbolAtlas atlas(imageContainer_->
+                          symbolsWithBorder(symbolSize_,
+                                            symbolColorBorderWidth_));
   QProgressDialog progressMeter(QObject::tr("Creating pdf..."),
                                 QObject::tr("Cancel"), 0,
                                 (xPages_ * yPages_)/5);
@@ -723,15 +715,20 @@ bool patternPrinter::drawPatternPages() {
       const int patternXBoxEnd = patternXBoxStart + (widthToUse/symbolSize_);
       const int patternYBoxStart = ((y-1) * heightPerPage_)/symbolSize_;
       const int patternYBoxEnd = patternYBoxStart + (heightToUse/symbolSize_);
-      for (int j = patternYBoxStart, jj = 0; j < patternYBoxEnd;
-            ++j, ++jj) {
-        for (int i = patternXBoxStart, ii = 0; i < patternXBoxEnd;
-              ++i, ++ii) {
-          const QPixmap& thisSymbol =
-            symbolMap[squareImage_.pixel(i * squareDim_, j * squareDim_)];
-          painter_.drawPixmap(margin_ + ii * symbolSize_,
-                              margin_ + jj * symbolSize_, thisSymbol);
-        }
+      // rasterize the page's symbols from the atlas and draw them in one go
+      QImage pageImage((patternXBoxEnd - patternXBoxStart) * symbolSize_,
+                       (patternYBoxEnd - patternYBoxStart) * symbolSize_,
+                       QImage::Format_RGB32);
+      if (!pageImage.isNull()) {
+        pageImage.fill(qRgb(255, 255, 255));
+        atlas.render(squareImage_, squareDim_, &pageImage,
+                     QPoint(patternXBoxStart * symbolSize_,
+                            patternYBoxStart * symbolSize_));
+        painter_.drawImage(margin_, margin_, pageImage);
+      }
+      else {
+        qWarning() << "Page image allocation failed in patternPrinter:"
+                   << pageNum;
       }
 
       //// draw grid lines and counts
@@ -46,6 +46,7 @@
 #include "dockImage.h"
 #include "xmlUtility.h"
 #include "floss.h"
+#include "gridOverlay.h"
 
 // bounds for allowed symbol sizes (too large and file sizes are ridiculous,
 // too small and symbols can't be distinguished)
@@ -203,10 +204,13 @@ void patternWindow::addImage(const QImage& squareImage, int squareDimension,
 
   patternImageContainer* container =
     new patternImageContainer(squareImage, imageNameFromIndex(imageIndex),
-                              squareDimension, basePatternDim_, colors);
+                              squareDimension, basePatternDim_, colors,
+                              imageIndex);
   const patternImagePtr imagePtr(container);
   connect(container, SIGNAL(symbolChanged(QRgb , const QPixmap& )),
           listDock_, SLOT(changeSymbol(QRgb , const QPixmap& )));
+  connect(container, SIGNAL(symbolChanged(QRgb , const QPixmap& )),
+          this, SLOT(containerSymbolChanged(QRgb )));
   QAction* menuAction = new QAction(container->name(), this);
   menuAction->setData(QVariant::fromValue(imagePtr));
   imageListMenu_->addAction(menuAction);
@@ -295,10 +299,7 @@ void patternWindow::processGridColorChange() {
 
 void patternWindow::changeSymbolSlot(const triC& color) {
 
-  const bool updateImage = curImage_->changeSymbol(color);
-  if (updateImage) {
-    updateImageLabelSymbols();
-  }
+  curImage_->changeSymbol(color);
   updateHistoryButtonStates();
 }
 
@@ -314,16 +315,28 @@ void patternWindow::imageClickSlot(QMouseEvent* event) {
     switchActionSlot();
   }
   else if (event->button() == Qt::LeftButton) {
-    const bool updateImage =
-      curImage_->mouseActivatedChangeSymbol(imageLabel_->width(),
-                                            imageLabel_->height(), event);
-    if (updateImage) {
-      updateImageLabelSymbols();
-    }
+    curImage_->mouseActivatedChangeSymbol(imageLabel_->width(),
+                                          imageLabel_->height(), event);
     updateHistoryButtonStates();
   }
 }
 
+void patternWindow::containerSymbolChanged(QRgb color) {
+
+  if (!curImage_ || sender() != curImage_.data()) {
+    return;
+  }
+  // the atlas slot for <color> is redrawn in place and only the tiles
+  // holding <color>'s stitches are repainted; fall back to a full rebuild
+  // if the label doesn't know the color
+  const triC symbolColor(color);
+  if (!imageLabel_->updateSymbol(color,
+                                 curImage_->symbolCurSymbolSize(symbolColor),
+                                 curImage_->stitchRuns(color))) {
+    updateImageLabelSymbols();
+  }
+}
+
 void patternWindow::updateImageLabelSymbols() {
 
   imageLabel_->setSymbols(curImage_->symbols());
@@ -354,6 +367,8 @@ void patternWindow::zoom(int zoomIncrement) {
   const int zoomDelta = (zoomIncrement > 0) ? 2 : -2;
   curImage_->setSymbolDimension(curImage_->symbolDimension() + zoomDelta);
   updateImageLabelSize();
+  // the user is likely to keep zooming the same way
+  curImage_->warmSymbolDimension(curImage_->symbolDimension() + zoomDelta);
 }
 
 void patternWindow::switchActionSlot() {
@@ -371,14 +386,12 @@ void patternWindow::switchActionSlot() {
 void patternWindow::forwardHistoryActionSlot() {
 
   curImage_->moveHistoryForward();
-  updateImageLabelSymbols();
   updateHistoryButtonStates();
 }
 
 void patternWindow::backHistoryActionSlot() {
 
   curImage_->moveHistoryBack();
-  updateImageLabelSymbols();
   updateHistoryButtonStates();
 }
 
@@ -393,22 +406,40 @@ QImage patternWindow::curImageForSaving() const {
     returnImage = curImage_->patternImageCurSymbolSize();
   }
 
+  // returnImage is our own, so grid it in place
   if (gridAction_->isChecked()) {
     if (curImage_->viewingSquareImage()) {
-      ::gridImage(&returnImage, curImage_->squareDimension(),
-                  curImage_->squareImage().width(),
-                  curImage_->squareImage().height(),
-                  imageLabel_->gridColor());
+      gridOverlay::forScaledImage(returnImage.size(),
+                                  curImage_->squareDimension(),
+                                  curImage_->squareImage().size(),
+                                  imageLabel_->gridColor()).
+        drawOnStrip(&returnImage, 0);
     }
     else {
-      ::gridImage(&returnImage, curImage_->symbolDimension(),
-                  returnImage.width(), returnImage.height(),
-                  imageLabel_->gridColor());
+      gridOverlay::forScaledImage(returnImage.size(),
+                                  curImage_->symbolDimension(),
+                                  returnImage.size(),
+                                  imageLabel_->gridColor()).
+        drawOnStrip(&returnImage, 0);
     }
   }
   return returnImage;
 }
 
+imageStripRendererPtr patternWindow::curImageStripRenderer() const {
+
+  if (curImage_->viewingSquareImage()) {
+    return imageStripRendererPtr();
+  }
+  const QSize size = curImage_->patternSizeCurSymbolSize();
+  gridOverlay grid;
+  if (gridAction_->isChecked()) {
+    grid = gridOverlay::forScaledImage(size, curImage_->symbolDimension(),
+                                       size, imageLabel_->gridColor());
+  }
+  return imageStripRendererPtr(new patternStripRenderer(curImage_, grid));
+}
+
 QSize patternWindow::curImageViewSize() const {
 
   return QSize(imageLabel_->width(), imageLabel_->height());
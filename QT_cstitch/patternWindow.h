@@ -162,6 +162,10 @@ class patternWindow : public imageSaverWindow {
   // return the image currently being viewed in the label
   // implements imageSaverWindow::
   QImage curImageForSaving() const;
+  // return a strip renderer for the pattern image, or null when the
+  // square image is being viewed
+  // implements imageSaverWindow::
+  imageStripRendererPtr curImageStripRenderer() const;
   // make the image in container the new image
   // does nothing if container is already current
   void setCur(patternImagePtr container);
@@ -183,6 +187,9 @@ class patternWindow : public imageSaverWindow {
   // the pattern and square images, a left button initiates a symbol change
   // for the symbol under mouse
   void imageClickSlot(QMouseEvent* event);
+  // a container changed the symbol for <color>; if it's the current image,
+  // repaint just that color's stitches
+  void containerSymbolChanged(QRgb color);
   // save a pdf pattern for the current image
   void saveSlot();
   // patternWindow doesn't support the zoomTo methods since in the vast
@@ -0,0 +1,135 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "projectReader.h"
+
+#include <cstring>
+
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QtEndian>
+
+// return the length of the line starting at <lineStart> (of at most
+// <remaining> bytes), not counting the end of line, and put the start of
+// the next line on <nextLine> (NULL if this was the last line)
+static qint64 lineLength(const char* lineStart, qint64 remaining,
+                         const char** nextLine) {
+
+  const char* lineEnd = static_cast<const char*>(std::memchr(lineStart, '\n',
+                                                             remaining));
+  if (!lineEnd) {
+    *nextLine = NULL;
+    return remaining;
+  }
+  *nextLine = lineEnd + 1;
+  qint64 length = lineEnd - lineStart;
+  if (length > 0 && lineStart[length - 1] == '\r') {
+    --length;
+  }
+  return length;
+}
+
+QString projectReader::read(const QString& filename) {
+
+  QFile inFile(filename);
+  if (!inFile.open(QIODevice::ReadOnly)) {
+    return QObject::tr("Sorry, %1 is not a valid project file "
+                       "(diagnostic: unable to open file)").arg(filename);
+  }
+  const qint64 size = inFile.size();
+  const uchar* mapped = size > 0 ? inFile.map(0, size) : NULL;
+  if (mapped) {
+    const QString error =
+      parse(filename, reinterpret_cast<const char*>(mapped), size);
+    inFile.unmap(const_cast<uchar*>(mapped));
+    return error;
+  }
+  // some file systems can't be mapped
+  const QByteArray contents = inFile.readAll();
+  return parse(filename, contents.constData(), contents.size());
+}
+
+QString projectReader::parse(const QString& filename, const char* data,
+                             qint64 size) {
+
+  const char* line = data;
+  const char* nextLine = NULL;
+  qint64 length = ::lineLength(line, size, &nextLine);
+  // (A day after the initial release I changed the program name from
+  // stitch to cstitch, so check for either...)
+  const QRegularExpression rx("^<(cstitch|stitch) version=");
+  const QRegularExpressionMatch match =
+    rx.match(QString::fromUtf8(line, length));
+  const QString programName = match.captured(1);
+  if (programName != "cstitch" && programName != "stitch") { // uh oh
+    return QObject::tr("Sorry, %1 is not a valid project file "
+                       "(diagnostic: wrong first line)").arg(filename);
+  }
+
+  const QByteArray endTag = "</" + programName.toLatin1() + ">";
+  do {
+    if (!nextLine) {
+      // oops, we missed the closing tag and read all the way to the end of
+      // the file...
+      return QObject::tr("Sorry, %1 appears to be corrupted "
+                         "(diagnostic: can't find end of data)")
+        .arg(filename);
+    }
+    line = nextLine;
+    length = ::lineLength(line, size - (line - data), &nextLine);
+  } while (length != endTag.size() ||
+           std::memcmp(line, endTag.constData(), length) != 0);
+  const qint64 xmlLength = line + length - data;
+
+  // the xml is written as utf-8 (QTextStream's encoding); give
+  // QDomDocument the raw bytes so that it decodes them itself
+  const bool xmlLoadSuccess =
+    doc_.setContent(QByteArray::fromRawData(data, xmlLength));
+  if (!xmlLoadSuccess) {
+    return QObject::tr("Sorry, %1 appears to be corrupted "
+                       "(diagnostic: parse failed)").arg(filename);
+  }
+
+  // a blank line between the xml and the image, then the image data as a
+  // serialized QByteArray: a big endian length followed by the bytes
+  const char* binary = NULL;
+  if (nextLine) {
+    ::lineLength(nextLine, size - (nextLine - data), &binary);
+  }
+  const qint64 binarySize = binary ? size - (binary - data) : 0;
+  quint32 imageDataLength = 0;
+  if (binarySize >= static_cast<qint64>(sizeof(quint32))) {
+    imageDataLength = qFromBigEndian<quint32>(
+      reinterpret_cast<const uchar*>(binary));
+  }
+  if (imageDataLength == 0 || imageDataLength == 0xffffffff ||
+      imageDataLength > binarySize - static_cast<qint64>(sizeof(quint32))) {
+    return QObject::tr("Sorry, %1 appears to be corrupted "
+                       "(diagnostic: empty image)").arg(filename);
+  }
+  imageData_ = QByteArray(binary + sizeof(quint32), imageDataLength);
+  image_ = QImage::fromData(imageData_);
+  if (image_.isNull()) {
+    return QObject::tr("Sorry, %1 appears to be corrupted "
+                       "(diagnostic: empty image)").arg(filename);
+  }
+  return QString();
+}
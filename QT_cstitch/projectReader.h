@@ -0,0 +1,63 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef PROJECTREADER_H
+#define PROJECTREADER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+#include <QtGui/QImage>
+
+#include <QtXml/QDomDocument>
+
+// projectReader reads a project file: xml text, ended by the closing
+// program tag line and a blank line, followed by the original image as
+// a QDataStream serialized QByteArray of the image file's data.
+//
+// The file is memory mapped (falling back to a single readAll if mapping
+// isn't possible) and the xml/binary boundary is found with one scan of
+// the mapped lines, so the file is only read once.  The image data is
+// copied out of the mapping exactly once - the copy is what the
+// windowManager keeps as its original image data, and the image is
+// decoded from that same copy.  (The mapping itself can't be kept, since
+// on Windows a mapped file can't be replaced by the next save.)
+class projectReader {
+
+ public:
+  projectReader() {}
+  // Read <filename>; return an empty string on success, otherwise a
+  // message for the user describing why the file couldn't be read.
+  QString read(const QString& filename);
+  const QDomDocument& doc() const { return doc_; }
+  QImage image() const { return image_; }
+  QByteArray imageData() const { return imageData_; }
+
+ private:
+  // parse the mapped (or read) file contents, <data> of length <size>
+  QString parse(const QString& filename, const char* data, qint64 size);
+
+ private:
+  QDomDocument doc_;
+  QImage image_;
+  QByteArray imageData_;
+};
+
+#endif
@@ -0,0 +1,79 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "projectRestore.h"
+
+#include <QtCore/QDebug>
+
+#include "colorCompare.h"
+#include "imageProcessing.h"
+
+QImage segmentedImage(const QImage& originalImage,
+                      const QVector<triC>& colors, int numImageColors) {
+
+  QImage workingImage = originalImage.convertToFormat(QImage::Format_RGB32);
+  if (workingImage.isNull()) {
+    qWarning() << "Empty image in segmentedImage.";
+    return QImage();
+  }
+  ::segment(&workingImage, colors, numImageColors);
+  return workingImage;
+}
+
+QImage runSegmentJob(const segmentJob& job) {
+
+  return job.run();
+}
+
+squareJobResult squareJob::run() const {
+
+  if (parentImage_.isNull()) {
+    return squareJobResult();
+  }
+  QVector<triC> colorsUsed;
+  const QImage newImage =
+    colorCompare::squareImage(parentImage_, originalImage_, squareMode_,
+                              squareSize_, &colorsUsed);
+  return squareJobResult(newImage, colorsUsed);
+}
+
+squareJobResult runSquareJob(const squareJob& job) {
+
+  return job.run();
+}
+
+const QImage& lazySegmentedImageContainer::image() const {
+
+  if (image_.isNull() && !originalImage_.isNull()) {
+    image_ = ::segmentedImage(originalImage_, colors_, numImageColors_);
+    originalImage_ = QImage();
+  }
+  return image_;
+}
+
+QVector<flossColor> lazySegmentedImageContainer::flossColors() const {
+
+  QVector<flossColor> returnVector;
+  const flossType type = flossMode();
+  for (int i = 0, size = colors_.size(); i < size; ++i) {
+    returnVector.push_back(flossColor(colors_[i], type));
+  }
+  return returnVector;
+}
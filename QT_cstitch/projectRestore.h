@@ -0,0 +1,132 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef PROJECTRESTORE_H
+#define PROJECTRESTORE_H
+
+#include <QtCore/QVector>
+
+#include <QtGui/QImage>
+
+#include "imageContainer.h"
+#include "triC.h"
+
+// Project restore is done in two phases: first the colorCompare and
+// squareWindow images are regenerated from the original image on a
+// thread pool (sibling images don't depend on each other, and each
+// square image depends only on its colorCompare parent), then the
+// results are added to the windows on the gui thread.  The jobs and
+// entry points for the first phase are here.
+
+// return a copy of <originalImage> segmented against <colors>, which is
+// what colorChooser did to create the colorCompare image with <colors>;
+// <numImageColors> is the number of colors in <originalImage> if known
+// (it's only a size hint)
+QImage segmentedImage(const QImage& originalImage,
+                      const QVector<triC>& colors, int numImageColors);
+
+// a colorCompare image to regenerate
+class segmentJob {
+ public:
+  segmentJob() : numImageColors_(0) {}
+  segmentJob(const QImage& originalImage, const QVector<triC>& colors,
+             int numImageColors)
+    : originalImage_(originalImage), colors_(colors),
+      numImageColors_(numImageColors) {}
+  // a default constructed job (for an image that's being restored
+  // lazily) returns a null image
+  QImage run() const {
+    if (originalImage_.isNull()) {
+      return QImage();
+    }
+    return ::segmentedImage(originalImage_, colors_, numImageColors_);
+  }
+ private:
+  QImage originalImage_;
+  QVector<triC> colors_;
+  int numImageColors_;
+};
+
+// QtConcurrent entry point for segmentJob::run
+QImage runSegmentJob(const segmentJob& job);
+
+// the image and colors produced by a squareJob
+class squareJobResult {
+ public:
+  squareJobResult() {}
+  squareJobResult(const QImage& image, const QVector<triC>& colors)
+    : image_(image), colors_(colors) {}
+  QImage image() const { return image_; }
+  QVector<triC> colors() const { return colors_; }
+ private:
+  QImage image_;
+  QVector<triC> colors_;
+};
+
+// a squareWindow image to regenerate from its colorCompare parent image
+class squareJob {
+ public:
+  squareJob() : squareMode_(-1), squareSize_(0) {}
+  squareJob(const QImage& parentImage, const QImage& originalImage,
+            int squareMode, int squareSize)
+    : parentImage_(parentImage), originalImage_(originalImage),
+      squareMode_(squareMode), squareSize_(squareSize) {}
+  squareJobResult run() const;
+ private:
+  QImage parentImage_;
+  QImage originalImage_;
+  int squareMode_; // colorCompare::savedSquareMode
+  int squareSize_;
+};
+
+// QtConcurrent entry point for squareJob::run
+squareJobResult runSquareJob(const squareJob& job);
+
+// lazySegmentedImageContainer holds a colorCompare image restored from a
+// project that hasn't been regenerated yet - the original image is
+// segmented against the image's colors the first time image() is called
+// (on the gui thread, so with the usual progress meter).  Used by the
+// opt-in "lazy_project_restore" setting for images the user may never
+// look at again.
+class lazySegmentedImageContainer : public imageContainer {
+
+ public:
+  lazySegmentedImageContainer(const QString& imageName,
+                              const QImage& originalImage,
+                              const QVector<triC>& colors, flossType type,
+                              int numImageColors)
+    : imageContainer(imageName, originalImage.size(), type),
+      originalImage_(originalImage), colors_(colors),
+      numImageColors_(numImageColors) {}
+  const QImage& image() const;
+  QVector<triC> colors() const { return colors_; }
+  QVector<flossColor> flossColors() const;
+  bool isOriginal() const { return false; }
+
+ private:
+  // implicitly shared with the window's original image; released once
+  // image_ has been computed
+  mutable QImage originalImage_;
+  mutable QImage image_;
+  const QVector<triC> colors_;
+  const int numImageColors_;
+};
+
+#endif
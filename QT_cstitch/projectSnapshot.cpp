@@ -0,0 +1,93 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "projectSnapshot.h"
+
+#include <QtCore/QSaveFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QDataStream>
+#include <QtCore/QMetaObject>
+
+#include "utility.h"
+
+using Qt::endl;
+
+// let <receiver> know we're <percent> done
+static void reportProgress(QObject* receiver, int percent) {
+
+  if (receiver) {
+    QMetaObject::invokeMethod(receiver, "projectSaveProgress",
+                              Qt::QueuedConnection, Q_ARG(int, percent));
+  }
+}
+
+QString projectSnapshot::write(QObject* progressReceiver) {
+
+  ::reportProgress(progressReceiver, 0);
+  // the count may still be in the works, in which case this blocks (but
+  // on this thread, not the gui's)
+  int colorCount = colorCount_;
+  if (colorCount == 0 && !colorCountComputation_.isCanceled()) {
+    colorCount = colorCountComputation_.result();
+  }
+  colorCountElement_.appendChild(doc_.createTextNode(::itoqs(colorCount)));
+
+  // histories are the bulk of the xml; they get 80% of the progress
+  int itemsWritten = 0;
+  int itemCount = 0;
+  for (int i = 0, size = squareHistories_.size(); i < size; ++i) {
+    itemCount += squareHistories_[i].second.size();
+  }
+  for (int i = 0, size = squareHistories_.size(); i < size; ++i) {
+    squareHistories_[i].second.toXml(&doc_, &squareHistories_[i].first);
+    itemsWritten += squareHistories_[i].second.size();
+    if (itemCount > 0) {
+      ::reportProgress(progressReceiver, 80 * itemsWritten / itemCount);
+    }
+  }
+  const QString xmlString = doc_.toString(2);
+  ::reportProgress(progressReceiver, 90);
+
+  // QSaveFile writes to a temporary file and only replaces the project
+  // file on commit, so a failed save never clobbers the previous one
+  QSaveFile outFile(filename_);
+  if (!outFile.open(QIODevice::WriteOnly)) {
+    return outFile.errorString();
+  }
+  // the xml portion as text
+  QTextStream textStream(&outFile);
+  textStream << xmlString << endl;
+  textStream.flush();
+  // then the image as binary
+  QDataStream dataStream(&outFile);
+  dataStream << imageData_;
+  if (textStream.status() != QTextStream::Ok ||
+      dataStream.status() != QDataStream::Ok || !outFile.commit()) {
+    return outFile.errorString();
+  }
+  ::reportProgress(progressReceiver, 100);
+  return QString();
+}
+
+QString writeProjectSnapshot(projectSnapshot snapshot,
+                             QObject* progressReceiver) {
+
+  return snapshot.write(progressReceiver);
+}
@@ -0,0 +1,89 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef PROJECTSNAPSHOT_H
+#define PROJECTSNAPSHOT_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFuture>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+
+#include <QtXml/QDomDocument>
+
+#include "historyStore.h"
+
+class QObject;
+
+// projectSnapshot holds everything needed to write a project file, taken
+// at the moment the user saves.  Everything it holds is either its own
+// (the project xml skeleton) or an implicitly shared copy of data the
+// gui keeps editing (image data, square histories), so once taken, a
+// snapshot can be written out on a worker thread (see
+// writeProjectSnapshot) while the user continues working.
+//
+// The expensive parts of the xml - the square image histories and the
+// original image color count, which may still be being computed - are
+// left out of the skeleton and filled in when the snapshot is written.
+class projectSnapshot {
+
+ public:
+  projectSnapshot() : colorCount_(0) {}
+  projectSnapshot(const QString& filename, const QDomDocument& doc,
+                  const QByteArray& imageData)
+    : filename_(filename), doc_(doc), imageData_(imageData),
+      colorCount_(0) {}
+  QString filename() const { return filename_; }
+  // <element> gets the original image color count as its text when the
+  // snapshot is written: <count> if it's non-zero, otherwise the result
+  // of <computation>
+  void setColorCount(const QDomElement& element, int count,
+                     const QFuture<int>& computation) {
+    colorCountElement_ = element;
+    colorCount_ = count;
+    colorCountComputation_ = computation;
+  }
+  // <history> will be appended to <appendee> when the snapshot is
+  // written
+  void addSquareHistory(const QDomElement& appendee,
+                        const squareHistorySnapshot& history) {
+    squareHistories_.push_back(qMakePair(appendee, history));
+  }
+  // Complete the xml and write the project file, reporting progress (as
+  // a percentage) to <progressReceiver>'s projectSaveProgress(int) slot.
+  // Return an empty string on success, otherwise an error message.
+  QString write(QObject* progressReceiver);
+
+ private:
+  QString filename_;
+  QDomDocument doc_;
+  QByteArray imageData_;
+  QDomElement colorCountElement_;
+  int colorCount_;
+  QFuture<int> colorCountComputation_;
+  QList<QPair<QDomElement, squareHistorySnapshot> > squareHistories_;
+};
+
+// QtConcurrent entry point for projectSnapshot::write.
+QString writeProjectSnapshot(projectSnapshot snapshot,
+                             QObject* progressReceiver);
+
+#endif
@@ -23,8 +23,7 @@
 #include <QtWidgets/QSpinBox>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QVBoxLayout>
-#include <QtWidgets/QCheckBox>
-#include <QtWidgets/QScrollArea>
+#include <QtWidgets/QListView>
 #include <QPainter>
 
 #include "colorLists.h"
@@ -42,9 +41,145 @@ class qRgbIntensity {
   }
 };
 
+// order colors by their count on <counts> (and by color for equal
+// counts, so the order doesn't depend on the hash)
+class qRgbCount {
+ public:
+  explicit qRgbCount(const QHash<QRgb, int>& counts) : counts_(counts) {}
+  bool operator()(QRgb c1, QRgb c2) const {
+    const int count1 = counts_[c1];
+    const int count2 = counts_[c2];
+    return (count1 < count2) || (count1 == count2 && c1 < c2);
+  }
+ private:
+  const QHash<QRgb, int>& counts_;
+};
+
+// compare a count with a color's count on <counts>, for searching a list
+// sorted by qRgbCount
+class countBelowColor {
+ public:
+  explicit countBelowColor(const QHash<QRgb, int>& counts)
+    : counts_(counts) {}
+  bool operator()(int count, QRgb color) const {
+    return count < counts_[color];
+  }
+ private:
+  const QHash<QRgb, int>& counts_;
+};
+
+void rareColorsModel::setColors(const QVector<QRgbPair>& colors) {
+
+  beginResetModel();
+  colors_ = colors;
+  checked_ = QVector<bool>(colors_.size(), true);
+  icons_.clear();
+  endResetModel();
+}
+
+void rareColorsModel::setAllChecked(bool checked) {
+
+  if (colors_.isEmpty()) {
+    return;
+  }
+  checked_.fill(checked);
+  emit dataChanged(index(0), index(colors_.size() - 1),
+                   QVector<int>() << Qt::CheckStateRole);
+}
+
+QList<QRgbPair> rareColorsModel::checkedColors() const {
+
+  QList<QRgbPair> returnPairs;
+  for (int i = 0, size = colors_.size(); i < size; ++i) {
+    if (checked_[i]) {
+      returnPairs.push_back(colors_[i]);
+    }
+  }
+  return returnPairs;
+}
+
+int rareColorsModel::rowCount(const QModelIndex& parent) const {
+
+  return parent.isValid() ? 0 : colors_.size();
+}
+
+QVariant rareColorsModel::data(const QModelIndex& index, int role) const {
+
+  if (!index.isValid() || index.row() >= colors_.size()) {
+    return QVariant();
+  }
+  const int row = index.row();
+  const QRgbPair& pair = colors_[row];
+  switch (role) {
+  case Qt::DisplayRole: {
+    const QString squareString =
+      rareColorsDialog::tr("%n square(s)", "",
+                           colorCounts_.value(pair.first));
+    return QString(squareString + " " +
+                   ::colorToPrettyString(pair.first) + " --> " +
+                   ::colorToPrettyString(pair.second));
+  }
+  case Qt::DecorationRole: {
+    QHash<int, QIcon>::const_iterator it = icons_.find(row);
+    if (it == icons_.end()) {
+      it = icons_.insert(row,
+                         QIcon(createIconPixmap(pair.first, pair.second)));
+    }
+    return it.value();
+  }
+  case Qt::CheckStateRole:
+    return checked_[row] ? Qt::Checked : Qt::Unchecked;
+  default:
+    return QVariant();
+  }
+}
+
+bool rareColorsModel::setData(const QModelIndex& index,
+                              const QVariant& value, int role) {
+
+  if (!index.isValid() || index.row() >= colors_.size() ||
+      role != Qt::CheckStateRole) {
+    return false;
+  }
+  checked_[index.row()] = (value.toInt() == Qt::Checked);
+  emit dataChanged(index, index, QVector<int>() << Qt::CheckStateRole);
+  return true;
+}
+
+Qt::ItemFlags rareColorsModel::flags(const QModelIndex& index) const {
+
+  if (!index.isValid()) {
+    return Qt::NoItemFlags;
+  }
+  return Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+}
+
+QPixmap rareColorsModel::createIconPixmap(QRgb oldColor, QRgb newColor)
+  const {
+
+  const int iconDim = ICON_SIZE;
+  const int halfDim = iconDim/2;
+  QPixmap pixmap(iconDim, iconDim);
+  QPainter painter(&pixmap);
+  painter.fillRect(0, 0, halfDim, iconDim, QColor(oldColor));
+  painter.fillRect(halfDim, 0, halfDim, iconDim, QColor(newColor));
+  painter.drawRect(0, 0, halfDim - 1, iconDim - 1);
+  painter.drawRect(halfDim, 0, halfDim - 1, iconDim - 1);
+
+  return pixmap;
+}
+
 rareColorsDialog::rareColorsDialog(const QHash<QRgb, int>& colorCounts)
   : cancelAcceptDialogBase(NULL), colorCounts_(colorCounts) {
 
+  sortedColors_.reserve(colorCounts_.size());
+  for (QHash<QRgb, int>::const_iterator it = colorCounts_.begin();
+       it != colorCounts_.end(); ++it) {
+    sortedColors_.push_back(it.key());
+  }
+  std::sort(sortedColors_.begin(), sortedColors_.end(),
+            qRgbCount(colorCounts_));
+
   //: Between this text and the next goes a box that lets the user choose
   //: a number
   minCountLeftLabel_ = new QLabel(tr("Replace checked colors that occur "));
@@ -66,29 +201,29 @@ rareColorsDialog::rareColorsDialog(const QHash<QRgb, int>& colorCounts)
   minCountLayout_->addWidget(minCountBox_);
   minCountLayout_->addWidget(minCountRightLabel_);
 
-  scroll_ = new QScrollArea;
-  // Qt tells me to use stylesheets to style widgets (instead of palettes),
-  // but if you change one style property of a complex widget, you have to
-  // change _every_ property of the widget.  Huh?
-  // http://doc.trolltech.com/4.7-snapshot/stylesheet-customizing.html
-  //Note: With complex widgets such as QComboBox and QScrollBar, if one
-  //property or sub-control is customized, all the other properties or
-  //sub-controls must be customized as well.
-//  scroll_->setStyleSheet("QWidget { background-color: white; }");
-  scroll_->viewport()->setStyleSheet("background-color: white;");
-  // make the scroll as wide as the widest possible row
+  model_ = new rareColorsModel(colorCounts_, this);
+  colorsView_ = new QListView;
+  colorsView_->setModel(model_);
+  // every row is the same size, so the view can lay out only the rows
+  // it shows
+  colorsView_->setUniformItemSizes(true);
+  colorsView_->setIconSize(QSize(ICON_SIZE, ICON_SIZE));
+  colorsView_->setSelectionMode(QAbstractItemView::NoSelection);
+  // make the list as wide as the widest possible row
   const QString testString(::itoqs(rangeMax) +
                            " squares (255, 255, 255) --> (255, 255, 255)");
   // PM_IndicatorWidth is the width of a checkbox
   const int maxWidth = fontMetrics.horizontalAdvance(testString) +
-    scroll_->style()->pixelMetric(QStyle::PM_IndicatorWidth) +
+    colorsView_->style()->pixelMetric(QStyle::PM_IndicatorWidth) +
     ::scrollbarWidth() + ICON_SIZE + 35;
-  scroll_->setMinimumWidth(maxWidth);
-  scroll_->setMinimumHeight(200);
-  scrollWidget_ = NULL;
-  colorsLayout_ = NULL;
-  noReplacementColorsLabel_ = NULL;
-  noRareColorsLabel_ = NULL;
+  colorsView_->setMinimumWidth(maxWidth);
+  colorsView_->setMinimumHeight(200);
+
+  messageLabel_ = new QLabel;
+  messageLabel_->setAlignment(Qt::AlignCenter);
+  messageLabel_->setMinimumWidth(maxWidth);
+  messageLabel_->setMinimumHeight(200);
+  messageLabel_->hide();
 
   selectAllLabel_ = new QLabel(tr("<a href=\"check\">Check all boxes</a>"),
                                this);
@@ -103,7 +238,8 @@ rareColorsDialog::rareColorsDialog(const QHash<QRgb, int>& colorCounts)
 
   mainLayout_ = new QVBoxLayout;
   mainLayout_->addLayout(minCountLayout_);
-  mainLayout_->addWidget(scroll_);
+  mainLayout_->addWidget(colorsView_);
+  mainLayout_->addWidget(messageLabel_);
   mainLayout_->addWidget(selectAllLabel_);
   mainLayout_->addWidget(selectNoneLabel_);
   mainLayout_->addWidget(cancelAcceptWidget());
@@ -115,116 +251,68 @@ rareColorsDialog::rareColorsDialog(const QHash<QRgb, int>& colorCounts)
 
 void rareColorsDialog::processNewMin(int min) {
 
-  // clean out the old rows
-  for (int i = checkboxes_.size() - 1; i >= 0; --i) {
-    delete checkboxes_.takeAt(i);
-  }
-  // see sarcastic note about this krap at the bottom of this bleepin
-  // function
-  delete scrollWidget_; // deletes any children
-  scrollWidget_ = new QWidget(scroll_);
-  colorsLayout_ = new QVBoxLayout;
-  scrollWidget_->setLayout(colorsLayout_);
+  // the rare colors are the first rareCount colors on sortedColors_
+  const int rareCount =
+    std::upper_bound(sortedColors_.begin(), sortedColors_.end(), min,
+                     countBelowColor(colorCounts_)) - sortedColors_.begin();
 
-  QList<QRgb> rareColors;
-  QList<QRgb> commonColors;
-  for (QHash<QRgb, int>::const_iterator it = colorCounts_.begin();
-       it != colorCounts_.end(); ++it) {
-    if (it.value() <= min) {
-      rareColors.push_back(it.key());
+  if (rareCount > 0 && rareCount < sortedColors_.size()) {
+    model_->setColors(replacements(rareCount));
+    messageLabel_->hide();
+    colorsView_->show();
+    colorsView_->scrollToTop();
+  }
+  else {
+    model_->setColors(QVector<QRgbPair>());
+    if (rareCount == 0) {
+      messageLabel_->
+        setText(tr("There aren't any colors that occur %1 or fewer times!")
+                .arg(::itoqs(minCountBox_->value())));
     }
     else {
-      commonColors.push_back(it.key());
-    }
-  }
-  // sort the rare colors by intensity
-  std::sort(rareColors.begin(), rareColors.end(), qRgbIntensity());
-  if (!commonColors.isEmpty() && !rareColors.isEmpty()) {
-    // each row consists of a checkbox saying whether or not to include
-    // the row's color, followed by the rare color and its count and then
-    // the replacement color for the rare color
-    for (int i = 0, size = rareColors.size(); i < size; ++i) {
-
-      QRgb thisOldColor = rareColors[i];
-
-      // find the new color
-      QRgb thisNewColor = ::closestMatch(thisOldColor, commonColors);
-      const int thisColorCount = colorCounts_[thisOldColor];
-      const QString squareString = tr("%n square(s)", "", thisColorCount);
-      const QString iconString(squareString + " " +
-                               ::colorToPrettyString(thisOldColor) + " --> " +
-                               ::colorToPrettyString(thisNewColor));
-      QCheckBox* checkBox = new QCheckBox(iconString);
-      const QPixmap iconPixmap = createIconPixmap(thisOldColor, thisNewColor);
-      checkBox->setIconSize(QSize(ICON_SIZE, ICON_SIZE));
-      checkBox->setIcon(QIcon(iconPixmap));
-      checkBox->setChecked(true);
-      checkboxes_.push_back(checkBox);
-      colorsLayout_->addWidget(checkBox);
+      messageLabel_->
+        setText(tr("There are no replacement colors available!"));
     }
+    colorsView_->hide();
+    messageLabel_->show();
   }
-  else if (rareColors.isEmpty()) {
-    noRareColorsLabel_ =
-      new QLabel(tr("There aren't any colors that occur %1 or fewer times!")
-                 .arg(::itoqs(minCountBox_->value())));
-    colorsLayout_->addWidget(noRareColorsLabel_);
-  }
-  else if (commonColors.isEmpty()) {
-    noReplacementColorsLabel_ =
-      new QLabel(tr("There are no replacement colors available!"));
-    colorsLayout_->addWidget(noReplacementColorsLabel_);
-  }
-
-  scrollWidget_->resize(colorsLayout_->sizeHint());
-  // if you put this up where the other stuff gets recreated (or you don't
-  // recreate the other stuff) then on the second and all later runs
-  // through this function colorsLayout_->sizeHint() will return (18, 18).
-  // Obviously.
-  scroll_->setWidget(scrollWidget_);
 }
 
-QPixmap rareColorsDialog::createIconPixmap(QRgb oldColor, QRgb newColor)
-  const {
+QVector<QRgbPair> rareColorsDialog::replacements(int rareCount) {
 
-  const int iconDim = ICON_SIZE;
-  const int halfDim = iconDim/2;
-  QPixmap pixmap(iconDim, iconDim);
-  QPainter painter(&pixmap);
-  painter.fillRect(0, 0, halfDim, iconDim, QColor(oldColor));
-  painter.fillRect(halfDim, 0, halfDim, iconDim, QColor(newColor));
-  painter.drawRect(0, 0, halfDim - 1, iconDim - 1);
-  painter.drawRect(halfDim, 0, halfDim - 1, iconDim - 1);
+  QHash<int, QVector<QRgbPair> >::const_iterator it =
+    replacementsCache_.find(rareCount);
+  if (it != replacementsCache_.end()) {
+    return it.value();
+  }
 
-  return pixmap;
+  QVector<QRgb> rareColors(sortedColors_.mid(0, rareCount));
+  QList<QRgb> commonColors;
+  commonColors.reserve(sortedColors_.size() - rareCount);
+  for (int i = rareCount, size = sortedColors_.size(); i < size; ++i) {
+    commonColors.push_back(sortedColors_[i]);
+  }
+  // sort the rare colors by intensity
+  std::sort(rareColors.begin(), rareColors.end(), qRgbIntensity());
+  const paletteIndex commonIndex(commonColors);
+  QVector<QRgbPair> returnPairs;
+  returnPairs.reserve(rareCount);
+  for (int i = 0; i < rareCount; ++i) {
+    const QRgb thisOldColor = rareColors[i];
+    returnPairs.push_back(QRgbPair(thisOldColor,
+                                   commonIndex.closestMatch(thisOldColor)));
+  }
+  replacementsCache_.insert(rareCount, returnPairs);
+  return returnPairs;
 }
 
 void rareColorsDialog::checkUncheckCheckboxes(const QString& checkOrUncheck) {
 
   bool checkAll = (checkOrUncheck == "check") ? true : false;
-  for (int i = 0, size = checkboxes_.size(); i < size; ++i) {
-    checkboxes_[i]->setChecked(checkAll);
-  }
+  model_->setAllChecked(checkAll);
 }
 
 QList<QRgbPair> rareColorsDialog::colorsToChange() const {
 
-  QList<QRgbPair> returnPairs;
-  QRegularExpression regex("\\((\\d+), (\\d+), (\\d+)\\).*\\((\\d+), (\\d+), (\\d+)\\)");
-  for (int i = 0, size = checkboxes_.size(); i < size; ++i) {
-    QRegularExpressionMatch match = regex.match(checkboxes_[i]->text());
-    if (checkboxes_[i]->isChecked() &&
-         match.hasMatch()) {
-      QStringList matches = match.capturedTexts();
-      // remember that matches[0] is the entire match
-      returnPairs.push_back(QRgbPair(qRgb(matches[1].toInt(),
-                                          matches[2].toInt(),
-                                          matches[3].toInt()),
-                                     qRgb(matches[4].toInt(),
-                                          matches[5].toInt(),
-                                          matches[6].toInt())));
-    }
-  }
-  return returnPairs;
+  return model_->checkedColors();
 }
-
-
@@ -21,20 +21,64 @@
 #define RARECOLORSDIALOG_H
 
 #include <QtCore/QList>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+#include <QtCore/QAbstractListModel>
+#include <QtGui/QIcon>
 
 #include "cancelAcceptDialogBase.h"
 
 class QVBoxLayout;
 class QHBoxLayout;
-class QCheckBox;
 class QLabel;
 class QSpinBox;
-class QScrollArea;
-class QWidget;
+class QListView;
 //template<class T1, class T2> struct QPair;
 
 typedef QPair<QRgb, QRgb> QRgbPair;
 
+//
+// class rareColorsModel
+//
+// rareColorsModel is the list model behind the rareColorsDialog color
+// list: each row is a rare color, its square count and its replacement,
+// with a checkbox saying whether or not to make the replacement.  Row
+// text and icons are only made when the view asks for them, so only the
+// rows on screen ever get an icon.
+//
+class rareColorsModel : public QAbstractListModel {
+
+  Q_OBJECT
+
+ public:
+  // <colorCounts> provides the square count for each color
+  rareColorsModel(const QHash<QRgb, int>& colorCounts, QObject* parent)
+    : QAbstractListModel(parent), colorCounts_(colorCounts) {}
+  // replace the rows with <colors> (old color, replacement color), all
+  // checked
+  void setColors(const QVector<QRgbPair>& colors);
+  // check or uncheck every row
+  void setAllChecked(bool checked);
+  // return the (old color, replacement color) pairs of the checked rows
+  QList<QRgbPair> checkedColors() const;
+  int rowCount(const QModelIndex& parent = QModelIndex()) const;
+  QVariant data(const QModelIndex& index, int role) const;
+  bool setData(const QModelIndex& index, const QVariant& value, int role);
+  Qt::ItemFlags flags(const QModelIndex& index) const;
+
+ private:
+  // returns a pixmap square that's half oldColor, half newColor (in that
+  // order)
+  QPixmap createIconPixmap(QRgb oldColor, QRgb newColor) const;
+
+ private:
+  const QHash<QRgb, int>& colorCounts_;
+  QVector<QRgbPair> colors_;
+  QVector<bool> checked_;
+  // icons made so far for the current rows, by row
+  mutable QHash<int, QIcon> icons_;
+};
+
 //
 // class rareColorsDialog
 //
@@ -45,6 +89,11 @@ typedef QPair<QRgb, QRgb> QRgbPair;
 // where n is chosen by the user from a spinbox (the dialog updates its
 // list as the spinbox changes its value)
 //
+// The colors are sorted by count once, so the rare colors for any n are
+// a prefix of that list; the replacements for each such prefix are
+// found once (through a paletteIndex of the remaining colors) and kept,
+// so moving the spinbox back and forth doesn't redo them.
+//
 
 class rareColorsDialog : public cancelAcceptDialogBase {
 
@@ -61,13 +110,15 @@ class rareColorsDialog : public cancelAcceptDialogBase {
   // the user changed the min spinbox, so recalculate the rare colors and
   // update the dialog
   void processNewMin(int min);
-  // returns a pixmap square that's half oldColor, half newColor (in that
-  // order)
-  QPixmap createIconPixmap(QRgb oldColor, QRgb newColor) const;
   // check or uncheck all color checkboxes (checkOrUncheck is "check" or
   // "uncheck")
   void checkUncheckCheckboxes(const QString& checkOrUncheck);
 
+ private:
+  // return the rare colors (the first <rareCount> of sortedColors_)
+  // sorted by intensity and paired with their replacements
+  QVector<QRgbPair> replacements(int rareCount);
+
  private:
   QVBoxLayout* mainLayout_;
 
@@ -78,14 +129,11 @@ class rareColorsDialog : public cancelAcceptDialogBase {
   QLabel* minCountRightLabel_;
   QSpinBox* minCountBox_;
 
-  QList<QCheckBox*> checkboxes_; // each color gets a checkbox
-  QScrollArea* scroll_; // for the color list
-  QWidget* scrollWidget_;
-  QVBoxLayout* colorsLayout_;
-  // displayed if there are no non-rare colors to choose from
-  QLabel* noReplacementColorsLabel_;
-  // displayed if there are no rare colors
-  QLabel* noRareColorsLabel_;
+  rareColorsModel* model_;
+  QListView* colorsView_; // for the color list
+  // displayed instead of the color list if there are no rare colors or
+  // no non-rare colors to choose from
+  QLabel* messageLabel_;
 
   // clickable text to select all checkboxes
   QLabel* selectAllLabel_;
@@ -95,6 +143,11 @@ class rareColorsDialog : public cancelAcceptDialogBase {
   // keys are colors in the current image, values are the number of times
   // a color appears in that image
   const QHash<QRgb, int>& colorCounts_;
+  // the keys of colorCounts_, sorted by count
+  QVector<QRgb> sortedColors_;
+  // keys are a number of rare colors, values are the result of
+  // replacements() for that number
+  QHash<int, QVector<QRgbPair> > replacementsCache_;
 };
 
 #endif
@@ -19,24 +19,31 @@
 
 #include "squareImageContainer.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <QtConcurrent/QtConcurrentMap>
+
 #include <QtGui/QPainter>
 
 #include "colorLists.h"
 #include "imageProcessing.h"
-#include "grid.h"
 #include "xmlUtility.h"
 #include "rareColorsDialog.h"
 #include "symbolChooser.h"
 #include "versionProcessing.h"
+#include "historyJournal.h"
 
 mutableSquareImageContainer::mutableSquareImageContainer(const QString& name,
                                            const QVector<triC>& colors,
                                            const QImage& image,
-                                           int dimension, flossType type)
+                                           int dimension, flossType type,
+                                           int imageIndex)
   : squareImageContainer(name, image.size(), type), image_(image),
     toolFlossType_(flossVariable), originalDimension_(dimension),
     widthSquareCount_(image.width()/dimension),
-    heightSquareCount_(image.height()/dimension),
+    heightSquareCount_(image.height()/dimension), imageIndex_(imageIndex),
+    backHistory_(&historySpill_), forwardHistory_(&historySpill_),
     colorListCheckNeeded_(false) {
 
   if ((!colors.empty()) &&
@@ -58,8 +65,15 @@ mutableSquareImageContainer::mutableSquareImageContainer(const QString& name,
 QVector<triC> mutableSquareImageContainer::checkColorList() {
 
   if (colorListCheckNeeded_) {
-    const grid gridImage(image_);
-    const QVector<triC> colorsToRemove = ::findColors(gridImage, colors());
+    // (the color index knows which colors are gone without a scan)
+    const QVector<triC> listColors = colors();
+    const colorSquareIndex& index = colorIndex();
+    QVector<triC> colorsToRemove;
+    for (int i = 0, size = listColors.size(); i < size; ++i) {
+      if (index.count(listColors[i].qrgb()) == 0) {
+        colorsToRemove.push_back(listColors[i]);
+      }
+    }
     removeColors(colorsToRemove);
     colorListCheckNeeded_ = false;
     return colorsToRemove;
@@ -83,42 +97,20 @@ flossColor mutableSquareImageContainer::removeColor(const triC& color) {
 }
 
 dockListUpdate mutableSquareImageContainer::
-performDetailing(const QImage& originalImage,
-                 const QList<pixel>& detailSquares,
-                 int numColors, flossType type) {
+commitDetailing(const QVector<historyPixel>& detailPixels, flossType type) {
 
-  if (detailSquares.empty()) {
-    qWarning() << "Detail squares empty" << numColors;
+  if (detailPixels.empty()) {
+    qWarning() << "Detail pixels empty";
     return dockListUpdate(QVector<flossColor>());
   }
-  QVector<historyPixel> history;
-  //// start the history by collecting the old pixels
-  for (QList<pixel>::const_iterator it = detailSquares.constBegin(),
-         end = detailSquares.constEnd(); it != end; ++it) {
-    // we'll have to go back later and insert the new color for this pixel
-    history.push_back(historyPixel(*it));
-  }
-
-  //// do the processing
-  colorTransformerPtr transformer =
-    colorTransformer::createColorTransformer(type);
-  const QVector<triC> colors =
-    ::chooseColors(originalImage, detailSquares, originalDimension_,
-                   numColors, transformer);
-  // this paints over our squareDetail marks (that's good)
-  ::segment(originalImage, &image_, detailSquares, originalDimension_,
-            colors);
-  // median returns colors in the same order as detailSquares lists squares
-  const QVector<triC> newColors = ::median(&image_, originalImage,
-                                           detailSquares, history,
-                                           originalDimension_);
-
-  //// complete the history
+  QVector<historyPixel> history(detailPixels);
   QVector<flossColor> colorsToAdd; // just return the new ones
   for (int i = 0, size = history.size(); i < size; ++i) {
-    const triC thisColor(newColors[i]);
-    history[i].setNewColor(thisColor.qrgb());
-    const flossColor thisFlossColor(thisColor, type);
+    const historyPixel& thisPixel = history[i];
+    // this paints over our squareDetail marks (that's good)
+    ::changeOneBlock(&image_, thisPixel.x(), thisPixel.y(),
+                     thisPixel.newColor().qrgb(), originalDimension_, true);
+    const flossColor thisFlossColor(thisPixel.newColor(), type);
     if (!flossColors_.contains(thisFlossColor)) {
       history[i].setNewColorIsNew(true);
       colorsToAdd.push_back(thisFlossColor);
@@ -127,7 +119,11 @@ performDetailing(const QImage& originalImage,
   }
   colorListCheckNeeded_ = true;
   addToHistory(historyItemPtr(new detailHistoryItem(history, type)));
-  return dockListUpdate(colorsToAdd);
+  const QVector<QRect> dirtySquares = ::squareRuns(history);
+  updateColorIndex(dirtySquares);
+  dockListUpdate update(colorsToAdd);
+  update.setDirtySquares(dirtySquares);
+  return update;
 }
 
 bool mutableSquareImageContainer::addColor(const flossColor& color) {
@@ -167,16 +163,23 @@ mutableSquareImageContainer::changeColor(QRgb oldColor,
   if (oldColor == newColor) {
     return dockListUpdate();
   }
-  const QVector<pairOfInts> changedSquares =
-    ::changeColor(&image_, oldColor, newColor, originalDimension_);
+  // the index has oldColor's squares in the order ::changeColor would
+  // find them, without the scan
+  const QVector<pairOfInts> changedSquares = colorIndex().squares(oldColor);
   if (!changedSquares.empty()) {
+    ::changeBlocks(&image_, changedSquares, newColor, originalDimension_,
+                   true);
+    const QVector<QRect> dirtySquares = ::squareRuns(changedSquares);
+    updateColorIndex(dirtySquares);
     const bool colorAdded = addColor(newFlossColor);
     const flossColor oldFlossColor = removeColor(oldColor);
     addToHistory(historyItemPtr(new changeAllHistoryItem(oldFlossColor,
                                                          newFlossColor,
                                                          colorAdded,
                                                          changedSquares)));
-    return dockListUpdate(newFlossColor, colorAdded, oldColor);
+    dockListUpdate update(newFlossColor, colorAdded, oldColor);
+    update.setDirtySquares(dirtySquares);
+    return update;
   }
   else {
     return dockListUpdate();
@@ -200,54 +203,95 @@ dockListUpdate mutableSquareImageContainer::fillRegion(int x, int y,
                                                         colorAdded,
                                                         coordinates)));
   colorListCheckNeeded_ = true;
-  return dockListUpdate(newColor, colorAdded);
+  const QVector<QRect> dirtySquares = ::squareRuns(coordinates);
+  updateColorIndex(dirtySquares);
+  dockListUpdate update(newColor, colorAdded);
+  update.setDirtySquares(dirtySquares);
+  return update;
 }
 
 dockListUpdate mutableSquareImageContainer::
 commitChangeOneDrag(const QSet<pairOfInts>& squares, flossColor newColor) {
 
-  const QRgb newRgbColor = newColor.qrgb();
   const bool colorAdded = addColor(newColor);
-  QVector<pixel> historyPixels;
-  QVector<triC> pixelColors;
-  for (QSet<pairOfInts>::const_iterator it = squares.begin(),
-          end = squares.end(); it != end; ++it) {
-    const int x = it->x() * originalDimension_;
-    const int y = it->y() * originalDimension_;
-    const QRgb thisColor = image_.pixel(x, y);
-    pixelColors.push_back(thisColor);
-    historyPixels.push_back(pixel(thisColor, pairOfInts(x, y)));
-  }
-  ::changeBlocks(&image_, historyPixels, newRgbColor, originalDimension_);
+  // write the squares a run at a time, collecting their old colors for
+  // the history as we go
+  const QVector<QRect> dirtySquares = ::squareRuns(squares);
+  const QVector<pixel> historyPixels =
+    ::changeSquareRuns(&image_, dirtySquares, newColor.qrgb(),
+                       originalDimension_);
   addToHistory(historyItemPtr(new changeOneHistoryItem(newColor, colorAdded,
                                                        historyPixels)));
   colorListCheckNeeded_ = true;
-  return dockListUpdate(newColor, colorAdded);
+  updateColorIndex(dirtySquares);
+  dockListUpdate update(newColor, colorAdded);
+  update.setDirtySquares(dirtySquares);
+  return update;
+}
+
+void mutableSquareImageContainer::addToHistory(const historyItemPtr& ptr) {
+
+  backHistory_.push_back(ptr);
+  forwardHistory_.clear();
+  maybeResetHistorySpill();
+  enforceHistoryCap();
+  historyJournal::squareEdit(imageIndex_, ptr);
 }
 
 dockListUpdate mutableSquareImageContainer::moveHistoryForward() {
 
   if (!forwardHistory_.empty()) {
-    backHistory_.push_back(forwardHistory_.front());
-    forwardHistory_.pop_front();
-    return backHistory_.back()->performHistoryEdit(this, H_FORWARD);
-  }
-  else {
-    return dockListUpdate();
+    // (an item that can't be read back from disk stays put)
+    const historyItemPtr item = forwardHistory_.moveFrontTo(&backHistory_);
+    if (item) {
+      enforceHistoryCap();
+      historyJournal::squareMove(imageIndex_, true);
+      dockListUpdate update = item->performHistoryEdit(this, H_FORWARD);
+      const QVector<QRect> dirtySquares =
+        item->squaresChanged(originalDimension_);
+      updateColorIndex(dirtySquares);
+      update.setDirtySquares(dirtySquares);
+      return update;
+    }
   }
+  return dockListUpdate();
 }
 
 dockListUpdate mutableSquareImageContainer::moveHistoryBack() {
 
   if (!backHistory_.empty()) {
-    const dockListUpdate update =
-      backHistory_.back()->performHistoryEdit(this, H_BACK);
-    forwardHistory_.push_front(backHistory_.back());
-    backHistory_.pop_back();
-    return update;
+    // (an item that can't be read back from disk stays put)
+    const historyItemPtr item = backHistory_.moveBackTo(&forwardHistory_);
+    if (item) {
+      enforceHistoryCap();
+      historyJournal::squareMove(imageIndex_, false);
+      dockListUpdate update = item->performHistoryEdit(this, H_BACK);
+      const QVector<QRect> dirtySquares =
+        item->squaresChanged(originalDimension_);
+      updateColorIndex(dirtySquares);
+      update.setDirtySquares(dirtySquares);
+      return update;
+    }
   }
-  else {
-    return dockListUpdate();
+  return dockListUpdate();
+}
+
+void mutableSquareImageContainer::enforceHistoryCap() {
+
+  const qint64 cap = historySpillFile::memoryCap();
+  // oldest undo items first, keeping the most recent one resident
+  for (int i = 0, size = backHistory_.size() - 1;
+       i < size && historyBytesInMemory() > cap; ++i) {
+    if (!backHistory_.spill(i)) {
+      return;
+    }
+  }
+  // then the furthest redo items, keeping the next one resident
+  for (int i = forwardHistory_.size() - 1;
+       i > 0 && historyBytesInMemory() > cap; --i) {
+    if (!forwardHistory_.spill(i)) {
+      return;
+    }
   }
 }
 
@@ -265,36 +309,12 @@ QDomDocument mutableSquareImageContainer::backImageHistoryXml() const {
   return doc;
 }
 
-void mutableSquareImageContainer::
-writeImageHistory(QDomDocument* doc, QDomElement* appendee) const {
+squareHistorySnapshot mutableSquareImageContainer::historySnapshot() const {
 
-  ::appendTextElement(doc, "tool_floss_type", toolFlossType_.prefix(),
-                      appendee);
-
-  if (backHistory_.empty() && forwardHistory_.empty()) {
-    return;
-  }
-
-  QDomElement history(doc->createElement("history"));
-  appendee->appendChild(history);
-
-  if (!backHistory_.empty()) {
-    QDomElement back(doc->createElement("backward_history"));
-    history.appendChild(back);
-    back.setAttribute("count", backHistory_.size());
-    for (int i = 0, size = backHistory_.size(); i < size; ++i) {
-      backHistory_[i]->toXml(doc, &back);
-    }
-  }
-
-  if (!forwardHistory_.empty()) {
-    QDomElement forward(doc->createElement("forward_history"));
-    history.appendChild(forward);
-    forward.setAttribute("count", forwardHistory_.size());
-    for (int i = 0, size = forwardHistory_.size(); i < size; ++i) {
-      forwardHistory_[i]->toXml(doc, &forward);
-    }
-  }
+  // (spilled items stay spilled - the snapshot reads them when it's
+  // written out)
+  return squareHistorySnapshot(toolFlossType_.prefix(), backHistory_,
+                               forwardHistory_);
 }
 
 void mutableSquareImageContainer::
@@ -315,6 +335,7 @@ updateImageHistory(const QDomElement& element) {
   for (int i = 0, size = backList.size(); i < size; ++i) {
     forwardHistory_.
       push_back(historyItem::xmlToHistoryItem(backList.item(i).toElement()));
+    enforceHistoryCap();
   }
 
   QDomElement forwardElement =
@@ -324,6 +345,7 @@ updateImageHistory(const QDomElement& element) {
     forwardHistory_.
       push_back(historyItem::xmlToHistoryItem(forwardList.
                                               item(i).toElement()));
+    enforceHistoryCap();
   }
 
   // move forward over the back history items
@@ -338,12 +360,21 @@ void mutableSquareImageContainer::rewindAndClearHistory() {
     moveHistoryBack();
   }
   forwardHistory_.clear();
+  maybeResetHistorySpill();
+}
+
+void mutableSquareImageContainer::maybeResetHistorySpill() {
+
+  if (historySpill_.isOpen() && !backHistory_.usesSpillFile() &&
+      !forwardHistory_.usesSpillFile()) {
+    historySpill_.reset();
+  }
 }
 
 dockListUpdate mutableSquareImageContainer::replaceRareColors() {
 
-  QHash<QRgb, int> countHash;
-  ::colorCounts(image_, originalDimension_, &countHash);
+  // the color index keeps the counts current
+  const QHash<QRgb, int> countHash = colorIndex().counts();
 
   rareColorsDialog countDialog(countHash);
   const int dialogReturnCode = countDialog.exec();
@@ -352,6 +383,7 @@ dockListUpdate mutableSquareImageContainer::replaceRareColors() {
     QList<colorChange> changeHistories;
     QSet<flossColor> oldFloss;
     QVector<triC> oldColors;
+    QVector<pairOfInts> allChangedSquares;
     for (int i = 0, size = pairs.size(); i < size; ++i) {
       const QRgb oldColor = pairs[i].first;
       const triC oldTriColor(oldColor);
@@ -359,16 +391,22 @@ dockListUpdate mutableSquareImageContainer::replaceRareColors() {
       oldFloss.insert(getFlossColorFromColor(oldTriColor));
       const QRgb newColor = pairs[i].second;
       const QVector<pairOfInts> changedSquares =
-        ::changeColor(&image_, oldColor, newColor, originalDimension_);
+        colorIndex().squares(oldColor);
       if (!changedSquares.empty()) {
+        ::changeBlocks(&image_, changedSquares, newColor,
+                       originalDimension_, true);
+        updateColorIndex(::squareRuns(changedSquares));
         removeColor(oldColor);
         changeHistories.push_back(colorChange(oldColor, newColor,
                                               changedSquares));
+        allChangedSquares += changedSquares;
       }
     }
     addToHistory(historyItemPtr(new rareColorsHistoryItem(changeHistories,
                                                           oldFloss)));
-    return dockListUpdate(oldColors);
+    dockListUpdate update(oldColors);
+    update.setDirtySquares(::squareRuns(allChangedSquares));
+    return update;
   }
   else {
     return dockListUpdate();
@@ -435,33 +473,110 @@ QSize mutableSquareImageContainer::setScaledHeight(int heightHint) {
   }
 }
 
-QImage mutableSquareImageContainer::scaledImage() const {
-
-  QHash<triC, QImage> colorSquares;
-  const QVector<triC>& squareColors = colors();
-  const int curDimension = scaledDimension();
-  QImage squareImage(curDimension, curDimension, QImage::Format_RGB32);
-  for (int i = 0, size = squareColors.size(); i < size; ++i) {
-    const triC& thisImageColor = squareColors[i];
-    squareImage.fill(thisImageColor.qrgb());
-    colorSquares[thisImageColor] = squareImage;
+// squareRowUpscaler writes one row of squares (a stitch row) of a
+// scaled square image straight into the output scanlines: the row's first
+// scanline is filled a square at a time, then copied down the rest of the
+// row.  The output may be just a horizontal strip of the scaled image
+// (starting at scaled row <destinationTop>), in which case only the part
+// of the stitch row on the strip is written.  Different rows touch
+// different scanlines, so rows can be written concurrently.
+class squareRowUpscaler {
+
+ public:
+  typedef void result_type;
+  squareRowUpscaler(const QImage& source, int originalDimension,
+                    int widthSquareCount, int scaledDimension,
+                    QImage* destination, int destinationTop)
+    : source_(source), originalDimension_(originalDimension),
+      widthSquareCount_(widthSquareCount), scaledDimension_(scaledDimension),
+      destination_(destination->bits()),
+      destinationBytesPerLine_(destination->bytesPerLine()),
+      destinationWidth_(destination->width()),
+      destinationTop_(destinationTop),
+      destinationBottom_(destinationTop + destination->height()) {}
+  void operator()(int yBox) const {
+
+    const int yStart = qMax(yBox*scaledDimension_, destinationTop_);
+    const int yEnd = qMin((yBox + 1)*scaledDimension_, destinationBottom_);
+    if (yStart >= yEnd) {
+      return;
+    }
+    uchar* const firstLine =
+      destination_ + (yStart - destinationTop_)*destinationBytesPerLine_;
+    QRgb* const firstPixels = reinterpret_cast<QRgb*>(firstLine);
+    const QRgb* sourceLine = reinterpret_cast<const QRgb*>
+      (source_.constScanLine(yBox*originalDimension_));
+    for (int xBox = 0; xBox < widthSquareCount_; ++xBox) {
+      const int xStart = xBox*scaledDimension_;
+      const int xEnd = qMin(xStart + scaledDimension_, destinationWidth_);
+      if (xStart >= xEnd) {
+        break;
+      }
+      // (squares are always opaque)
+      std::fill(firstPixels + xStart, firstPixels + xEnd,
+                sourceLine[xBox*originalDimension_] | 0xff000000);
+    }
+    for (int j = yStart + 1; j < yEnd; ++j) {
+      memcpy(destination_ + (j - destinationTop_)*destinationBytesPerLine_,
+             firstLine, destinationWidth_*sizeof(QRgb));
+    }
   }
 
-  const grid baseImage(image(), originalDimension_);
-  QImage returnImage(scaledSize(), QImage::Format_RGB32);
-  QPainter painter(&returnImage);
-  for (int yBox = 0; yBox < heightSquareCount_; ++yBox) {
-    for (int xBox = 0; xBox < widthSquareCount_; ++xBox) {
-      const triC& thisSquareColor =
-        baseImage(xBox*originalDimension_, yBox*originalDimension_);
-      painter.drawImage(QPoint(xBox*curDimension, yBox*curDimension),
-                        colorSquares[thisSquareColor]);
+ private:
+  const QImage& source_;
+  const int originalDimension_;
+  const int widthSquareCount_;
+  const int scaledDimension_;
+  uchar* const destination_;
+  const int destinationBytesPerLine_;
+  const int destinationWidth_;
+  const int destinationTop_;
+  const int destinationBottom_;
+};
 
-    }
+QImage mutableSquareImageContainer::scaledImage() const {
+
+  QImage returnImage(scaledSize(), QImage::Format_RGB32);
+  if (returnImage.isNull()) {
+    return returnImage;
   }
+  renderScaledStrip(&returnImage, 0);
   return returnImage;
 }
 
+void mutableSquareImageContainer::renderScaledStrip(QImage* strip,
+                                                    int top) const {
+
+  const QImage source = (image().depth() == 32) ? image() :
+    image().convertToFormat(QImage::Format_RGB32);
+  const int curDimension = scaledDimension();
+  if (strip->width() > widthSquareCount_*curDimension ||
+      top + strip->height() > heightSquareCount_*curDimension) {
+    // don't leave garbage past the last full square
+    strip->fill(qRgb(0, 0, 0));
+  }
+
+  const int firstRow = top/curDimension;
+  const int lastRow = qMin((top + strip->height() - 1)/curDimension,
+                           heightSquareCount_ - 1);
+  QVector<int> rows;
+  for (int i = firstRow; i <= lastRow; ++i) {
+    rows.push_back(i);
+  }
+  QtConcurrent::blockingMap(rows,
+                            squareRowUpscaler(source, originalDimension_,
+                                              widthSquareCount_, curDimension,
+                                              strip, top));
+}
+
+void squareImageContainer::renderScaledStrip(QImage* strip, int top) const {
+
+  // the painter clips the scaled draw to the strip, so the full scaled
+  // image is never made
+  QPainter painter(strip);
+  painter.drawImage(QRect(QPoint(0, -top), scaledSize()), image());
+}
+
 QSize immutableSquareImageContainer::setScaledWidth(int widthHint) {
 
   const int newHeight =
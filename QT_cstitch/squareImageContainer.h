@@ -23,8 +23,11 @@
 #include <QtXml/QDomDocument>
 
 #include "imageContainer.h"
+#include "imageUtility.h"
+#include "colorSquareIndex.h"
 #include "squareDockTools.h"
 #include "squareToolHistories.h"
+#include "historyStore.h"
 
 class squareImageContainer;
 typedef QExplicitlySharedDataPointer<squareImageContainer> squareImagePtr;
@@ -87,30 +90,39 @@ class squareImageContainer : public imageContainer {
                                              flossColor newColor) = 0;
   // Fill the region containing (<x>, <y>) with <newColor>.
   virtual dockListUpdate fillRegion(int x, int y, flossColor newColor) = 0;
-  // Perform detailing on <detailSquares> from the container's image,
-  // using <originalImage> for reference colors and
-  // choosing at most <numColors> colors for the detail squares,
-  // making those colors all floss type <type>.
+  // Apply detailing computed by ::computeDetailing: each of
+  // <detailPixels> gets its new color, the new colors being floss type
+  // <type>.
   virtual dockListUpdate
-    performDetailing(const QImage& originalImage,
-                     const QList<pixel>& detailSquares,
-                     int numColors, flossType type) = 0;
+    commitDetailing(const QVector<historyPixel>& detailPixels,
+                    flossType type) = 0;
   // Return the current backward history as xml.
   virtual QDomDocument backImageHistoryXml() const = 0;
   // Append the entire edit history as xml to <appendee>.
   virtual void writeImageHistory(QDomDocument* doc,
                                  QDomElement* appendee) const = 0;
+  // Return a copy of the entire edit history that can be written out
+  // later (possibly from another thread).
+  virtual squareHistorySnapshot historySnapshot() const = 0;
   // Restore this image's history from <element>, running back history
   // if any.
   virtual void updateImageHistory(const QDomElement& element) = 0;
   // Undo back history and then clear both histories.
   virtual void rewindAndClearHistory() = 0;
+  // Return the (approximate) number of bytes used by the edit history in
+  // memory and in the history spill file.
+  virtual qint64 historyBytesInMemory() const = 0;
+  virtual qint64 historyBytesOnDisk() const = 0;
   // SetScaledSize for (mutable) square images is a set once affair; this
   // allows scaled size to be set again.
   virtual void resetZoom() = 0;
   virtual QSize setScaledWidth(int widthHint) = 0;
   virtual QSize setScaledHeight(int heightHint) = 0;
   virtual dockListUpdate replaceRareColors() = 0;
+  // render the rows of scaledImage() starting at <top> onto <strip> (a
+  // Format_RGB32 image as wide as scaledImage() and as tall as the
+  // number of rows wanted); only the strip's pixels are ever allocated
+  virtual void renderScaledStrip(QImage* strip, int top) const;
 };
 
 // A mutableSquareImageContainer copies in its image so that it can be
@@ -135,10 +147,11 @@ class mutableSquareImageContainer : public squareImageContainer {
                                               historyDirection ) const;
 
  public:
+  // <imageIndex> identifies this image in the history journal
   mutableSquareImageContainer(const QString& name,
                               const QVector<triC>& colors,
                               const QImage& image, int dimension,
-                              flossType type);
+                              flossType type, int imageIndex);
   const QImage& image() const { return image_; }
   QVector<triC> colors() const;
   QVector<flossColor> flossColors() const { return flossColors_; }
@@ -167,13 +180,21 @@ class mutableSquareImageContainer : public squareImageContainer {
   dockListUpdate commitChangeOneDrag(const QSet<pairOfInts>& squares,
                                      flossColor newColor);
   dockListUpdate fillRegion(int x, int y, flossColor newColor);
-  dockListUpdate performDetailing(const QImage& originalImage,
-                                  const QList<pixel>& detailSquares,
-                                  int numColors, flossType type);
+  dockListUpdate commitDetailing(const QVector<historyPixel>& detailPixels,
+                                 flossType type);
   QDomDocument backImageHistoryXml() const;
-  void writeImageHistory(QDomDocument* doc, QDomElement* appendee) const;
+  void writeImageHistory(QDomDocument* doc, QDomElement* appendee) const {
+    historySnapshot().toXml(doc, appendee);
+  }
+  squareHistorySnapshot historySnapshot() const;
   void updateImageHistory(const QDomElement& element);
   void rewindAndClearHistory();
+  qint64 historyBytesInMemory() const {
+    return backHistory_.residentBytes() + forwardHistory_.residentBytes();
+  }
+  qint64 historyBytesOnDisk() const {
+    return backHistory_.spilledBytes() + forwardHistory_.spilledBytes();
+  }
   // Increases or decreases the scaled square size by one.
   QSize zoom(bool zoomIn);
   // setScaledSize for (mutable) square images is a set once affair; this
@@ -191,6 +212,7 @@ class mutableSquareImageContainer : public squareImageContainer {
   dockListUpdate replaceRareColors();
   bool isOriginal() const { return false; }
   QImage scaledImage() const;
+  void renderScaledStrip(QImage* strip, int top) const;
 
  private:
   void drawDetail(int xStart, int yStart, const QColor& color);
@@ -204,25 +226,48 @@ class mutableSquareImageContainer : public squareImageContainer {
   flossColor removeColor(const flossColor& color) {
     return removeColor(color.color());
   }
-  void addToHistory(const historyItemPtr& ptr) {
-    backHistory_.push_back(ptr);
-    forwardHistory_.clear();
-  }
+  void addToHistory(const historyItemPtr& ptr);
+  // Spill history items to disk until the history's memory use is under
+  // the cap, starting with the items furthest from the current edit (the
+  // items on either side of the current edit are always kept in memory).
+  void enforceHistoryCap();
+  // start a new history spill file if no history item refers to the
+  // current one (so the file doesn't grow for the whole session)
+  void maybeResetHistorySpill();
   // Return the flossColor corresponding to <color> on flossColors_.
   flossColor getFlossColorFromColor(const triC& color) const;
+  // return the color index for image_, building it if necessary
+  const colorSquareIndex& colorIndex() const {
+    if (colorIndex_.isNull()) {
+      colorIndex_ = colorSquareIndex(image_, originalDimension_);
+    }
+    return colorIndex_;
+  }
+  // the squares covered by <squares> (box coordinate rectangles) changed
+  // on image_ - keep the color index in sync
+  void updateColorIndex(const QVector<QRect>& squares) {
+    colorIndex_.update(image_, squares);
+  }
 
  private:
   QImage image_; // the square image (at its original size)
+  // the squares of each color on image_; built the first time it's
+  // needed, then updated by every edit to image_
+  mutable colorSquareIndex colorIndex_;
   QVector<flossColor> flossColors_;
   flossType toolFlossType_; // current floss type used by the tools
   const int originalDimension_; // square dimension
   // for convenience: the number of horizontal and vertical squares
   const int widthSquareCount_;
   const int heightSquareCount_;
+  const int imageIndex_;
+  // where history items go when the history uses too much memory (must
+  // be declared before the history lists)
+  historySpillFile historySpill_;
   // the most recently performed tool action sits on the back of
   // backHistory
-  QList<historyItemPtr> backHistory_;
-  QList<historyItemPtr> forwardHistory_;
+  historyList backHistory_;
+  historyList forwardHistory_;
   // valid_ if flossColors_.size() <= numSymbols && > 0
   bool valid_;
   // set only if valid = false, in which case colors should be set to 0
@@ -272,14 +317,19 @@ class immutableSquareImageContainer : public squareImageContainer {
   dockListUpdate fillRegion(int , int , flossColor ) {
     return dockListUpdate();
   }
-  dockListUpdate performDetailing(const QImage& , const QList<pixel>& ,
-                                  int , flossType ) {
+  dockListUpdate commitDetailing(const QVector<historyPixel>& ,
+                                 flossType ) {
     return dockListUpdate();
   }
   QDomDocument backImageHistoryXml() const { return QDomDocument(); }
   void writeImageHistory(QDomDocument* , QDomElement* ) const { return; }
+  squareHistorySnapshot historySnapshot() const {
+    return squareHistorySnapshot();
+  }
   void updateImageHistory(const QDomElement& ) { return; }
   void rewindAndClearHistory() { return; }
+  qint64 historyBytesInMemory() const { return 0; }
+  qint64 historyBytesOnDisk() const { return 0; }
   QSize setScaledWidth(int widthHint);
   QSize setScaledHeight(int heightHint);
   void resetZoom() { }
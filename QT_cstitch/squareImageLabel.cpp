@@ -19,8 +19,13 @@
 
 #include "squareImageLabel.h"
 #include "utility.h"
+#include "gridOverlay.h"
+
+#include <algorithm>
+#include <cstring>
 
 #include <QtCore/QDebug>
+#include <QtCore/QSet>
 
 #include <QtGui/QPainter>
 #include <QtGui/QPaintEvent>
@@ -33,31 +38,43 @@ void squareImageLabel::paintEvent(QPaintEvent* event) {
   if (!drawingSquares_ && !drawingHashes_) {
     if (imageIsFlat()) { // paint the entire image at once
       const QRectF viewRectangle(QRectF(event->rect()));
-      painter.drawPixmap(viewRectangle, scaledImage_, viewRectangle);
+      if (scaledImage_.size() == flatSize_ || flatSize_.isEmpty()) {
+        painter.drawPixmap(viewRectangle, scaledImage_, viewRectangle);
+      }
+      else { // placeholder
+        const qreal xScale =
+          static_cast<qreal>(scaledImage_.width())/flatSize_.width();
+        const qreal yScale =
+          static_cast<qreal>(scaledImage_.height())/flatSize_.height();
+        const QRectF sourceRectangle(viewRectangle.x() * xScale,
+                                     viewRectangle.y() * yScale,
+                                     viewRectangle.width() * xScale,
+                                     viewRectangle.height() * yScale);
+        painter.drawPixmap(viewRectangle.intersected
+                           (QRectF(QPointF(0, 0), QSizeF(flatSize_))),
+                           scaledImage_, sourceRectangle);
+      }
       if (imageIsOriginal_) {
         // no decorations for the original image
         event->accept();
         return;
       }
     }
-    else { // draw a square image
-      // we only draw the portion of the image in the viewing rectangle
+    else { // draw a square image from its tiles
+      // we only draw the tiles in the viewing rectangle
       const QRect viewRect = event->rect();
-      const int xBoxStart = viewRect.x()/scaledDimension_;
-      const int xStart = xBoxStart * scaledDimension_;
-      const int xEnd = viewRect.x() + viewRect.width();
-      const int yBoxStart = viewRect.y()/scaledDimension_;
-      const int yStart = yBoxStart * scaledDimension_;
-      const int yEnd = viewRect.y() + viewRect.height();
-      const int originalDimension = baseImage_.width()/xSquareCount_;
-      for (int j = yStart, yBox = yBoxStart;
-           j < yEnd; j += scaledDimension_, ++yBox) {
-        for (int i = xStart, xBox = xBoxStart;
-             i < xEnd; i += scaledDimension_, ++xBox) {
-          painter.drawPixmap
-            (QPoint(i, j),
-             colorSquares_[baseImage_.pixel(xBox*originalDimension,
-                                            yBox*originalDimension)]);
+      const int xTileStart = viewRect.left()/TILE_SIZE;
+      const int xTileEnd = viewRect.right()/TILE_SIZE;
+      const int yTileStart = viewRect.top()/TILE_SIZE;
+      const int yTileEnd = viewRect.bottom()/TILE_SIZE;
+      for (int yTile = yTileStart; yTile <= yTileEnd; ++yTile) {
+        for (int xTile = xTileStart; xTile <= xTileEnd; ++xTile) {
+          const QImage& thisTile = tile(xTile, yTile);
+          const QRect tileRect(xTile*TILE_SIZE, yTile*TILE_SIZE,
+                               thisTile.width(), thisTile.height());
+          const QRect drawRect = tileRect.intersected(viewRect);
+          painter.drawImage(drawRect, thisTile,
+                            drawRect.translated(-tileRect.topLeft()));
         }
       }
     }
@@ -139,20 +156,8 @@ void squareImageLabel::paintEvent(QPaintEvent* event) {
   }
 
   if (gridOn_ && scaledDimension_ > 1) {
-    painter.setPen(QPen(QColor(gridColor_), 1));
-    const QRect eventRectangle(event->rect());
-    const int xStart = eventRectangle.x();
-    const int xEnd = xStart + eventRectangle.width();
-    const int yStart = eventRectangle.y();
-    const int yEnd = yStart + eventRectangle.height();
-    for (int i = (xStart/scaledDimension_)*scaledDimension_; i <= xEnd;
-         i += scaledDimension_) {
-      painter.drawLine(QPoint(i, yStart), QPoint(i, yEnd));
-    }
-    for (int j = (yStart/scaledDimension_)*scaledDimension_; j <= yEnd;
-         j += scaledDimension_) {
-      painter.drawLine(QPoint(xStart, j), QPoint(xEnd, j));
-    }
+    gridOverlay(size(), scaledDimension_, scaledDimension_, gridColor_).
+      draw(&painter, event->rect());
   }
 }
 
@@ -199,11 +204,18 @@ void squareImageLabel::setNewImage(const QImage& image,
   xSquareCount_ = xSquareCount;
   ySquareCount_ = ySquareCount;
   scaledDimension_ = image.width()/xSquareCount_;
-  generateColorSquares(colors);
+  colors_ = colors;
+  tiles_.clear();
+  scaler_.cancel();
   if (imageIsFlat()) {
     scaledImage_ = QPixmap::fromImage(baseImage_);
+    flatSize_ = baseImage_.size();
   }
   else {
+    // tiles read square colors straight from the scanlines
+    if (baseImage_.depth() != 32) {
+      baseImage_ = baseImage_.convertToFormat(QImage::Format_RGB32);
+    }
     scaledImage_ = QPixmap();
   }
 }
@@ -211,14 +223,183 @@ void squareImageLabel::setNewImage(const QImage& image,
 void squareImageLabel::updateImage(const QImage& image, const QList<QRgb>& colors,
                                    const QRect& updateRectangle) {
 
-  baseImage_ = image;
-  generateColorSquares(colors);
-  if (updateRectangle.isNull()) {
+  colors_ = colors;
+  if (imageIsFlat()) {
+    baseImage_ = image;
+    if (updateRectangle.isNull()) {
+      update();
+    }
+    else {
+      update(updateRectangle);
+    }
+    return;
+  }
+
+  const QImage newImage = (image.depth() == 32) ? image :
+    image.convertToFormat(QImage::Format_RGB32);
+  invalidateTiles(newImage, updateRectangle);
+  baseImage_ = newImage;
+}
+
+void squareImageLabel::updateSquares(const QImage& image,
+                                     const QVector<QRect>& dirtySquares) {
+
+  if (imageIsFlat() || image.size() != baseImage_.size()) {
+    updateImage(image, colors_, QRect());
+    return;
+  }
+  baseImage_ = (image.depth() == 32) ? image :
+    image.convertToFormat(QImage::Format_RGB32);
+  // the zooms we have tiles for
+  QSet<int> dimensions;
+  const QList<quint64> keys = tiles_.keys();
+  for (int i = 0, size = keys.size(); i < size; ++i) {
+    dimensions.insert(static_cast<int>(keys[i] >> 40));
+  }
+  for (QSet<int>::const_iterator it = dimensions.begin(),
+         end = dimensions.end(); it != end; ++it) {
+    const int dimension = *it;
+    for (int i = 0, size = dirtySquares.size(); i < size; ++i) {
+      const QRect& squares = dirtySquares[i];
+      const int xTileStart = (squares.left()*dimension)/TILE_SIZE;
+      const int xTileEnd = ((squares.right() + 1)*dimension - 1)/TILE_SIZE;
+      const int yTileStart = (squares.top()*dimension)/TILE_SIZE;
+      const int yTileEnd = ((squares.bottom() + 1)*dimension - 1)/TILE_SIZE;
+      for (int yTile = yTileStart; yTile <= yTileEnd; ++yTile) {
+        for (int xTile = xTileStart; xTile <= xTileEnd; ++xTile) {
+          tiles_.remove(tileKey(dimension, xTile, yTile));
+        }
+      }
+    }
+  }
+  for (int i = 0, size = dirtySquares.size(); i < size; ++i) {
+    const QRect& squares = dirtySquares[i];
+    update(squares.left()*scaledDimension_, squares.top()*scaledDimension_,
+           squares.width()*scaledDimension_,
+           squares.height()*scaledDimension_);
+  }
+}
+
+void squareImageLabel::invalidateTiles(const QImage& newImage,
+                                       const QRect& updateRectangle) {
+
+  if (newImage.size() != baseImage_.size()) {
+    tiles_.clear();
     update();
+    return;
+  }
+  // tile rectangles (in tile coordinates) at the current zoom that need
+  // to be redrawn
+  QList<QRect> dirtyTiles;
+  if (!updateRectangle.isNull()) {
+    const QRect rect = updateRectangle.intersected(QRect(QPoint(0, 0),
+                                                         size()));
+    if (!rect.isEmpty()) {
+      dirtyTiles.push_back(QRect(QPoint(rect.left()/TILE_SIZE,
+                                        rect.top()/TILE_SIZE),
+                                 QPoint(rect.right()/TILE_SIZE,
+                                        rect.bottom()/TILE_SIZE)));
+    }
   }
   else {
-    update(updateRectangle);
+    // compare the two images one pixel per square; once a square on a
+    // tile has changed the rest of that tile's squares on this row can be
+    // skipped
+    const int originalDimension = baseImage_.width()/xSquareCount_;
+    for (int yBox = 0; yBox < ySquareCount_; ++yBox) {
+      const QRgb* oldLine = reinterpret_cast<const QRgb*>
+        (baseImage_.constScanLine(yBox*originalDimension));
+      const QRgb* newLine = reinterpret_cast<const QRgb*>
+        (newImage.constScanLine(yBox*originalDimension));
+      const int yTileStart = (yBox*scaledDimension_)/TILE_SIZE;
+      const int yTileEnd = ((yBox + 1)*scaledDimension_ - 1)/TILE_SIZE;
+      for (int xBox = 0; xBox < xSquareCount_; ++xBox) {
+        const int offset = xBox*originalDimension;
+        if (oldLine[offset] != newLine[offset]) {
+          const int xTileStart = (xBox*scaledDimension_)/TILE_SIZE;
+          const int xTileEnd = ((xBox + 1)*scaledDimension_ - 1)/TILE_SIZE;
+          dirtyTiles.push_back(QRect(QPoint(xTileStart, yTileStart),
+                                     QPoint(xTileEnd, yTileEnd)));
+          // skip to the last square on xTileEnd
+          xBox = qMax(xBox, ((xTileEnd + 1)*TILE_SIZE - 1)/scaledDimension_);
+        }
+      }
+    }
+  }
+  if (dirtyTiles.isEmpty()) {
+    return;
   }
+
+  // tiles at other zoom levels may be stale now
+  const QList<quint64> keys = tiles_.keys();
+  for (int i = 0, size = keys.size(); i < size; ++i) {
+    if (static_cast<int>(keys[i] >> 40) != scaledDimension_) {
+      tiles_.remove(keys[i]);
+    }
+  }
+  QSet<quint64> dirtyKeys;
+  for (int i = 0, size = dirtyTiles.size(); i < size; ++i) {
+    const QRect& tileRect = dirtyTiles[i];
+    for (int yTile = tileRect.top(); yTile <= tileRect.bottom(); ++yTile) {
+      for (int xTile = tileRect.left(); xTile <= tileRect.right(); ++xTile) {
+        const quint64 key = tileKey(xTile, yTile);
+        if (!dirtyKeys.contains(key)) {
+          dirtyKeys.insert(key);
+          tiles_.remove(key);
+          update(xTile*TILE_SIZE, yTile*TILE_SIZE, TILE_SIZE, TILE_SIZE);
+        }
+      }
+    }
+  }
+}
+
+const QImage& squareImageLabel::tile(int tileX, int tileY) {
+
+  const quint64 key = tileKey(tileX, tileY);
+  QImage* cachedTile = tiles_.object(key);
+  if (!cachedTile) {
+    cachedTile = new QImage(renderTile(tileX, tileY));
+    tiles_.insert(key, cachedTile,
+                  qMax(static_cast<int>(cachedTile->sizeInBytes()/1024), 1));
+  }
+  return *cachedTile;
+}
+
+QImage squareImageLabel::renderTile(int tileX, int tileY) const {
+
+  const int xStart = tileX*TILE_SIZE;
+  const int yStart = tileY*TILE_SIZE;
+  const int tileWidth = qMin(TILE_SIZE, width() - xStart);
+  const int tileHeight = qMin(TILE_SIZE, height() - yStart);
+  if (tileWidth <= 0 || tileHeight <= 0) {
+    return QImage();
+  }
+  QImage returnTile(tileWidth, tileHeight, QImage::Format_RGB32);
+  const int originalDimension = baseImage_.width()/xSquareCount_;
+  int lastYBox = -1;
+  for (int j = 0; j < tileHeight; ++j) {
+    QRgb* line = reinterpret_cast<QRgb*>(returnTile.scanLine(j));
+    const int yBox = (yStart + j)/scaledDimension_;
+    if (yBox == lastYBox) { // same squares as the line above
+      memcpy(line, returnTile.constScanLine(j - 1),
+             tileWidth*sizeof(QRgb));
+      continue;
+    }
+    lastYBox = yBox;
+    const QRgb* source = reinterpret_cast<const QRgb*>
+      (baseImage_.constScanLine(yBox*originalDimension));
+    int i = 0;
+    while (i < tileWidth) {
+      const int xBox = (xStart + i)/scaledDimension_;
+      // (squares are always drawn opaque)
+      const QRgb color = source[xBox*originalDimension] | 0xff000000;
+      const int squareEnd = qMin((xBox + 1)*scaledDimension_ - xStart,
+                                 tileWidth);
+      std::fill(line + i, line + squareEnd, color);
+      i = squareEnd;
+    }
+  }
+  return returnTile;
 }
 
 void squareImageLabel::setImageSize(const QSize& newSize) {
@@ -226,7 +407,7 @@ void squareImageLabel::setImageSize(const QSize& newSize) {
   if (imageIsFlat()) {
     xSquareCount_ = newSize.width();
     ySquareCount_ = newSize.height();
-    scaledImage_ = QPixmap::fromImage(baseImage_).scaled(newSize);
+    scaleFlatImage(newSize);
   }
   else {
     scaledDimension_ = qMax(newSize.width()/xSquareCount_, 1);
@@ -239,17 +420,42 @@ void squareImageLabel::setImageSize(const QSize& newSize) {
                        ::itoqs(baseImage_.size().width()) + "x" +
                        ::itoqs(baseImage_.size().height())).
                toStdString().c_str());
-    generateColorSquares(colorSquares_.keys());
   }
   resize(newSize);
   update();
 }
 
+void squareImageLabel::scaleFlatImage(const QSize& size) {
+
+  flatSize_ = size;
+  if (size == baseImage_.size()) {
+    scaler_.cancel();
+    scaledImage_ = QPixmap::fromImage(baseImage_);
+  }
+  else {
+    // (fast, like the QPixmap scale it replaces)
+    scaler_.scale(baseImage_, size, Qt::FastTransformation);
+  }
+}
+
+void squareImageLabel::flatScaleFinished(const QImage& image) {
+
+  // make sure the result is still wanted
+  if (imageIsFlat() && image.size() == flatSize_) {
+    scaledImage_ = QPixmap::fromImage(image);
+    update();
+  }
+}
+
 void squareImageLabel::setImageWidth(int newWidth) {
 
   scaledDimension_ = qMax(newWidth/xSquareCount_, 1);
   if (imageIsFlat()) {
-    scaledImage_ = QPixmap::fromImage(baseImage_).scaledToWidth(newWidth);
+    // (the size QPixmap::scaledToWidth would give)
+    scaleFlatImage(QSize(newWidth,
+                         qRound(baseImage_.height() *
+                                static_cast<qreal>(newWidth)/
+                                baseImage_.width())));
   }
   else {
     Q_ASSERT_X(newWidth % scaledDimension_ == 0, "setImageWidth",
@@ -259,7 +465,6 @@ void squareImageLabel::setImageWidth(int newWidth) {
                        ::itoqs(baseImage_.size().width()) + "x" +
                        ::itoqs(baseImage_.size().height())).
                toStdString().c_str());
-    generateColorSquares(colorSquares_.keys());
   }
   resize(size());
   update();
@@ -269,7 +474,10 @@ void squareImageLabel::setImageHeight(int newHeight) {
 
   scaledDimension_ = qMax(newHeight/ySquareCount_, 1);
   if (imageIsFlat()) {
-    scaledImage_ = QPixmap::fromImage(baseImage_).scaledToHeight(newHeight);
+    scaleFlatImage(QSize(qRound(baseImage_.width() *
+                                static_cast<qreal>(newHeight)/
+                                baseImage_.height()),
+                         newHeight));
   }
   else {
     Q_ASSERT_X(newHeight % scaledDimension_ == 0, "setImageHeight",
@@ -279,19 +487,7 @@ void squareImageLabel::setImageHeight(int newHeight) {
                        ::itoqs(baseImage_.size().width()) + "x" +
                        ::itoqs(baseImage_.size().height())).
                toStdString().c_str());
-    generateColorSquares(colorSquares_.keys());
   }
   resize(size());
   update();
 }
-
-void squareImageLabel::generateColorSquares(const QList<QRgb>& colors) {
-
-  colorSquares_.clear();
-  for (int i = 0, size = colors.size(); i < size; ++i) {
-    QPixmap thisSquare(scaledDimension_, scaledDimension_);
-    const QRgb thisColor = colors[i];
-    thisSquare.fill(thisColor);
-    colorSquares_[thisColor] = thisSquare;
-  }
-}
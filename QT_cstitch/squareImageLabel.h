@@ -20,6 +20,8 @@
 #ifndef SQUAREIMAGELABEL_H
 #define SQUAREIMAGELABEL_H
 
+#include <QtCore/QCache>
+
 #include "imageUtility.h"
 #include "imageLabel.h"
 
@@ -31,6 +33,16 @@
 // clearSquares), and hash drawing (i.e. "x"es through squares, via
 // start/stopDrawingHashes and add/removeHashSquare)
 //
+// A squared image is painted from tiles of TILE_SIZE x TILE_SIZE label
+// pixels, each rasterized straight from the square colors of baseImage_
+// and kept in an LRU cache keyed on the zoom (scaled square dimension)
+// and the tile's position.  Scrolling just blits cached tiles, and an
+// image update only throws away (and repaints) the tiles whose squares
+// actually changed.
+//
+// A flat (original) image is scaled in the background when zoomed; until
+// the new scale arrives the previous one is stretched to the new size.
+//
 class squareImageLabel : public imageLabelBase {
 
   Q_OBJECT
@@ -38,12 +50,15 @@ class squareImageLabel : public imageLabelBase {
  public:
   explicit squareImageLabel(QWidget* parent)
     : imageLabelBase(parent), xSquareCount_(0), ySquareCount_(0),
-    scaledDimension_(-1), gridOn_(false), gridColor_(qRgb(0, 0, 0)),
+    scaledDimension_(-1), tiles_(TILE_CACHE_KB), gridOn_(false),
+    gridColor_(qRgb(0, 0, 0)),
     squareColor_(qRgb(0, 0, 0)), lastSquareDrawn_(0),
     drawingSquares_(false), lastHashDrawn_(0), drawingHashes_(false) {
 
     // don't clear window before painting
     setAttribute(Qt::WA_OpaquePaintEvent);
+    connect(&scaler_, SIGNAL(scaled(const QImage& )),
+            this, SLOT(flatScaleFinished(const QImage& )));
   }
   // the image's current size
   QSize size() const { return QSize(width(), height()); }
@@ -71,6 +86,11 @@ class squareImageLabel : public imageLabelBase {
                    bool imageIsOriginal);
   void updateImage(const QImage& image, const QList<QRgb>& colors,
                    const QRect& updateRectangle);
+  // <image> differs from the current image only in <dirtySquares> (box
+  // coordinate rectangles): drop just the cached tiles (at every zoom)
+  // covering those squares and repaint them.  The color list is
+  // unchanged by definition (tiles read colors from the image itself).
+  void updateSquares(const QImage& image, const QVector<QRect>& dirtySquares);
   // Set the color that squares added via addSquare will be drawn in.
   // Once called, only squares added with addSquare will be drawn on this
   // label, until clearSquares is called.
@@ -118,28 +138,60 @@ class squareImageLabel : public imageLabelBase {
   // return true if we paint the image all at once (as opposed to 
   // drawing each square)
   bool imageIsFlat() const {
-    return colorSquares_.isEmpty();
+    return colors_.isEmpty();
   }
   int originalHeight() const { return baseImage_.height(); }
-  void generateColorSquares(const QList<QRgb>& colors);
   void paintEvent(QPaintEvent* event);
+  // return the tile cache key for the tile at tile coordinates
+  // (<tileX>, <tileY>) at the current zoom
+  quint64 tileKey(int tileX, int tileY) const {
+    return tileKey(scaledDimension_, tileX, tileY);
+  }
+  // the same, at zoom <dimension>
+  static quint64 tileKey(int dimension, int tileX, int tileY) {
+    return (static_cast<quint64>(dimension) << 40) |
+      (static_cast<quint64>(tileY) << 20) | static_cast<quint64>(tileX);
+  }
+  // return the tile at tile coordinates (<tileX>, <tileY>) at the current
+  // zoom, rendering it if it isn't cached
+  const QImage& tile(int tileX, int tileY);
+  // rasterize the tile at tile coordinates (<tileX>, <tileY>) at the
+  // current zoom
+  QImage renderTile(int tileX, int tileY) const;
+  // baseImage_ is changing to <newImage>: drop and repaint the tiles
+  // covering squares that differ between the two (or that intersect
+  // <updateRectangle>, in label coordinates, if it isn't null)
+  void invalidateTiles(const QImage& newImage, const QRect& updateRectangle);
+  // start scaling the flat image to <size>
+  void scaleFlatImage(const QSize& size);
+
+ private slots:
+  // the background scale of the flat image to <image> finished
+  void flatScaleFinished(const QImage& image);
 
  private:
   QImage baseImage_;
   bool imageIsOriginal_; // baseImage_ is the Original image
-  // only used when baseImage_ isFlat()
+  // only used when baseImage_ isFlat(); scaledImage_ is stretched to
+  // flatSize_ until the background scale to flatSize_ arrives
   QPixmap scaledImage_;
+  QSize flatSize_;
+  asyncScaler scaler_;
   
   // number of horizontal squares in baseImage_
   // (just a more convenient way of saying "original square dimension"
   // (but always real scaled width for the original image))
   int xSquareCount_;
   int ySquareCount_; // (for convenience)
-  // key is an image color, value is the square image square to draw for
-  // that color
-  QHash<QRgb, QPixmap> colorSquares_;
+  // the square image colors; empty for a flat image
+  QList<QRgb> colors_;
   // square dimension of the scaled image (always 1 for the original image)
   int scaledDimension_;
+  // the tile cache, costed in KB; tiles for other zoom levels are kept
+  // around for zooming back
+  static const int TILE_SIZE = 256;
+  static const int TILE_CACHE_KB = 64 * 1024;
+  QCache<quint64, QImage> tiles_;
   bool gridOn_;
   QRgb gridColor_;
 
@@ -20,9 +20,11 @@
 #include "squareToolHistories.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QDataStream>
 
 #include "squareImageContainer.h"
 #include "xmlUtility.h"
+#include "binaryUtility.h"
 #include "imageUtility.h"
 #include "imageProcessing.h"
 
@@ -51,6 +53,44 @@ historyItemPtr historyItem::xmlToHistoryItem(const QDomElement& xml) {
   return historyItemPtr(item);
 }
 
+// the tool codes used to identify binary history items (these are
+// written to disk, so don't reorder them)
+enum binaryHistoryTool {B_CHANGE_ALL = 1, B_CHANGE_ONE, B_FILL_REGION,
+                        B_DETAIL, B_RARE_COLORS};
+
+historyItemPtr historyItem::binaryToHistoryItem(QDataStream* stream) {
+
+  quint8 tool = 0;
+  *stream >> tool;
+  historyItem* item = NULL;
+  switch (tool) {
+  case B_CHANGE_ALL:
+    item = new changeAllHistoryItem(stream);
+    break;
+  case B_CHANGE_ONE:
+    item = new changeOneHistoryItem(stream);
+    break;
+  case B_FILL_REGION:
+    item = new fillRegionHistoryItem(stream);
+    break;
+  case B_DETAIL:
+    item = new detailHistoryItem(stream);
+    break;
+  case B_RARE_COLORS:
+    item = new rareColorsHistoryItem(stream);
+    break;
+  default:
+    qWarning() << "Bad tool in binaryToHistoryItem:" << tool;
+    return historyItemPtr(NULL);
+  }
+  if (stream->status() != QDataStream::Ok) {
+    qWarning() << "Truncated history item in binaryToHistoryItem:" << tool;
+    delete item;
+    return historyItemPtr(NULL);
+  }
+  return historyItemPtr(item);
+}
+
 changeAllHistoryItem::changeAllHistoryItem(const QDomElement& xmlHistory)
   : toolColor_(::xmlStringToFlossColor(::getElementText(xmlHistory,
                                                         "tool_color"))),
@@ -62,6 +102,27 @@ changeAllHistoryItem::changeAllHistoryItem(const QDomElement& xmlHistory)
                                                          "coordinate_list")))
 { }
 
+changeAllHistoryItem::changeAllHistoryItem(QDataStream* stream)
+  : toolColor_(::readFlossColor(stream)),
+    toolColorIsNew_(::readBool(stream)),
+    priorColor_(::readFlossColor(stream)),
+    coordinates_(::readCoordinatesList(stream))
+{ }
+
+void changeAllHistoryItem::toBinary(QDataStream* stream) const {
+
+  *stream << static_cast<quint8>(B_CHANGE_ALL);
+  ::writeFlossColor(stream, toolColor_);
+  ::writeBool(stream, toolColorIsNew_);
+  ::writeFlossColor(stream, priorColor_);
+  ::writeCoordinatesList(stream, coordinates_);
+}
+
+qint64 changeAllHistoryItem::byteCount() const {
+
+  return sizeof(*this) + coordinates_.size() * sizeof(pairOfInts);
+}
+
 void changeAllHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   const {
 
@@ -78,6 +139,11 @@ void changeAllHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   ::appendCoordinatesList(doc, coordinates_, &itemElement);
 }
 
+QVector<QRect> changeAllHistoryItem::squaresChanged(int ) const {
+
+  return ::squareRuns(coordinates_);
+}
+
 dockListUpdate changeAllHistoryItem::
 performHistoryEdit(mutableSquareImageContainer* container,
                    historyDirection direction) const {
@@ -120,6 +186,25 @@ changeOneHistoryItem::changeOneHistoryItem(const QDomElement& xmlHistory)
     pixels_(::xmlToPixelList(::getElementText(xmlHistory, "pixel_list")))
 { }
 
+changeOneHistoryItem::changeOneHistoryItem(QDataStream* stream)
+  : toolColor_(::readFlossColor(stream)),
+    toolColorIsNew_(::readBool(stream)),
+    pixels_(::readPixelList(stream))
+{ }
+
+void changeOneHistoryItem::toBinary(QDataStream* stream) const {
+
+  *stream << static_cast<quint8>(B_CHANGE_ONE);
+  ::writeFlossColor(stream, toolColor_);
+  ::writeBool(stream, toolColorIsNew_);
+  ::writePixelList(stream, pixels_);
+}
+
+qint64 changeOneHistoryItem::byteCount() const {
+
+  return sizeof(*this) + pixels_.size() * sizeof(pixel);
+}
+
 void changeOneHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   const {
 
@@ -134,6 +219,13 @@ void changeOneHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   ::appendPixelList(doc, pixels_, &itemElement);
 }
 
+QVector<QRect> changeOneHistoryItem::
+squaresChanged(int originalDimension) const {
+
+  // (pixels_ uses image coordinates)
+  return ::squareRuns(pixels_, originalDimension);
+}
+
 dockListUpdate changeOneHistoryItem::
 performHistoryEdit(mutableSquareImageContainer* container,
                    historyDirection direction) const {
@@ -178,6 +270,27 @@ fillRegionHistoryItem::fillRegionHistoryItem(const QDomElement& xmlHistory)
                                                          "coordinate_list")))
 { }
 
+fillRegionHistoryItem::fillRegionHistoryItem(QDataStream* stream)
+  : toolColor_(::readFlossColor(stream)),
+    toolColorIsNew_(::readBool(stream)),
+    priorColor_(::readFlossColor(stream)),
+    coordinates_(::readCoordinatesList(stream))
+{ }
+
+void fillRegionHistoryItem::toBinary(QDataStream* stream) const {
+
+  *stream << static_cast<quint8>(B_FILL_REGION);
+  ::writeFlossColor(stream, toolColor_);
+  ::writeBool(stream, toolColorIsNew_);
+  ::writeFlossColor(stream, priorColor_);
+  ::writeCoordinatesList(stream, coordinates_);
+}
+
+qint64 fillRegionHistoryItem::byteCount() const {
+
+  return sizeof(*this) + coordinates_.size() * sizeof(pairOfInts);
+}
+
 void fillRegionHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   const {
 
@@ -194,6 +307,11 @@ void fillRegionHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   ::appendCoordinatesList(doc, coordinates_, &itemElement);
 }
 
+QVector<QRect> fillRegionHistoryItem::squaresChanged(int ) const {
+
+  return ::squareRuns(coordinates_);
+}
+
 dockListUpdate fillRegionHistoryItem::
 performHistoryEdit(mutableSquareImageContainer* container,
                    historyDirection direction) const {
@@ -239,6 +357,23 @@ detailHistoryItem::detailHistoryItem(const QDomElement& xmlHistory)
     newColorsType_(::getElementText(xmlHistory, "new_colors_type"))
 {}
 
+detailHistoryItem::detailHistoryItem(QDataStream* stream)
+  : detailPixels_(::readHistoryPixelList(stream)),
+    newColorsType_(::readFlossType(stream))
+{}
+
+void detailHistoryItem::toBinary(QDataStream* stream) const {
+
+  *stream << static_cast<quint8>(B_DETAIL);
+  ::writeHistoryPixelList(stream, detailPixels_);
+  ::writeFlossType(stream, newColorsType_);
+}
+
+qint64 detailHistoryItem::byteCount() const {
+
+  return sizeof(*this) + detailPixels_.size() * sizeof(historyPixel);
+}
+
 void detailHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   const {
 
@@ -250,6 +385,11 @@ void detailHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
                       &itemElement);
 }
 
+QVector<QRect> detailHistoryItem::squaresChanged(int ) const {
+
+  return ::squareRuns(detailPixels_);
+}
+
 dockListUpdate detailHistoryItem::
 performHistoryEdit(mutableSquareImageContainer* container,
                    historyDirection direction) const {
@@ -292,6 +432,27 @@ rareColorsHistoryItem::rareColorsHistoryItem(const QDomElement& xmlHistory)
     rareColorTypes_(::xmlStringToFlossSet(::getElementText(xmlHistory,
                                                            "floss_list"))) {}
 
+rareColorsHistoryItem::rareColorsHistoryItem(QDataStream* stream)
+  : items_(::readColorChangeList(stream)),
+    rareColorTypes_(::readFlossSet(stream)) {}
+
+void rareColorsHistoryItem::toBinary(QDataStream* stream) const {
+
+  *stream << static_cast<quint8>(B_RARE_COLORS);
+  ::writeColorChangeList(stream, items_);
+  ::writeFlossSet(stream, rareColorTypes_);
+}
+
+qint64 rareColorsHistoryItem::byteCount() const {
+
+  qint64 count = sizeof(*this) + rareColorTypes_.size() * sizeof(flossColor);
+  for (int i = 0, size = items_.size(); i < size; ++i) {
+    count += sizeof(colorChange) +
+      items_[i].coordinates().size() * sizeof(pairOfInts);
+  }
+  return count;
+}
+
 void rareColorsHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   const {
 
@@ -302,6 +463,15 @@ void rareColorsHistoryItem::toXml(QDomDocument* doc, QDomElement* appendee)
   ::appendFlossList(doc, rareColorTypes_, &itemElement);
 }
 
+QVector<QRect> rareColorsHistoryItem::squaresChanged(int ) const {
+
+  QVector<pairOfInts> coordinates;
+  for (int i = 0, size = items_.size(); i < size; ++i) {
+    coordinates += items_[i].coordinates();
+  }
+  return ::squareRuns(coordinates);
+}
+
 dockListUpdate rareColorsHistoryItem::
 performHistoryEdit(mutableSquareImageContainer* container,
                    historyDirection direction) const {
@@ -20,7 +20,11 @@
 #ifndef SQUARETOOLHISTORIES_H
 #define SQUARETOOLHISTORIES_H
 
+#include <algorithm>
+
 #include <QtCore/QSharedData>
+#include <QtCore/QRect>
+#include <QtCore/QVector>
 
 #include "triC.h"
 #include "floss.h"
@@ -34,33 +38,67 @@ class mutableSquareImageContainer;
 class historyItem;
 class QDomDocument;
 class QDomElement;
+class QDataStream;
 template<class T> class QExplicitlySharedDataPointer;
 
 typedef QExplicitlySharedDataPointer<historyItem> historyItemPtr;
 
 enum historyDirection {H_BACK, H_FORWARD};
 
+// orders points by row, then column
+inline bool rowMajorLessThan(const QPoint& p1, const QPoint& p2) {
+  return p1.y() < p2.y() || (p1.y() == p2.y() && p1.x() < p2.x());
+}
+
+// return the squares on <squares> (a container of items with x() and
+// y(), in box coordinates times <scale>) as box coordinate rectangles,
+// one per horizontal run of squares
+template<class T>
+QVector<QRect> squareRuns(const T& squares, int scale = 1) {
+
+  QVector<QPoint> points;
+  points.reserve(squares.size());
+  for (typename T::const_iterator it = squares.begin(), end = squares.end();
+       it != end; ++it) {
+    points.push_back(QPoint(it->x()/scale, it->y()/scale));
+  }
+  std::sort(points.begin(), points.end(), ::rowMajorLessThan);
+  QVector<QRect> runs;
+  for (int i = 0, size = points.size(); i < size; ) {
+    const QPoint start = points[i];
+    int end = start.x();
+    // (duplicates are possible)
+    for (++i; i < size && points[i].y() == start.y() &&
+           points[i].x() <= end + 1; ++i) {
+      end = points[i].x();
+    }
+    runs.push_back(QRect(start, QPoint(end, start.y())));
+  }
+  return runs;
+}
+
 // dockListUpdate holds the record of how the color list dock needs to be
 // updated after completion of a tool use
 class dockListUpdate {
  public:
   dockListUpdate() : singleColor_(true), colorsToAdd_(1, flossColor()),
-    colorIsNew_(false) {}
+    colorIsNew_(false), dirtySquaresKnown_(false) {}
   dockListUpdate(const flossColor& color, bool colorIsNew)
-    : singleColor_(true), colorsToAdd_(1, color), colorIsNew_(colorIsNew)
-  { }
+    : singleColor_(true), colorsToAdd_(1, color), colorIsNew_(colorIsNew),
+      dirtySquaresKnown_(false) { }
   dockListUpdate(const flossColor& color, bool colorIsNew, const triC& removeColor)
     : singleColor_(true), colorsToAdd_(1, color), colorIsNew_(colorIsNew),
-    colorsToRemove_(1, removeColor) { }
+    colorsToRemove_(1, removeColor), dirtySquaresKnown_(false) { }
   dockListUpdate(const flossColor& color, bool colorIsNew,
                  const QVector<triC>& colorsToRemove)
     : singleColor_(true), colorsToAdd_(1, color), colorIsNew_(colorIsNew),
-    colorsToRemove_(colorsToRemove) {}
+    colorsToRemove_(colorsToRemove), dirtySquaresKnown_(false) {}
   explicit dockListUpdate(const QVector<flossColor>& colorsToAdd)
-    : singleColor_(false), colorsToAdd_(colorsToAdd), colorIsNew_(false) {}
+    : singleColor_(false), colorsToAdd_(colorsToAdd), colorIsNew_(false),
+      dirtySquaresKnown_(false) {}
   dockListUpdate(const QVector<triC>& colorsToRemove)
     : singleColor_(false), colorIsNew_(false),
-      colorsToRemove_(colorsToRemove) {}
+      colorsToRemove_(colorsToRemove), dirtySquaresKnown_(false) {}
   // return true if the update is for a single color
   bool singleColor() const { return singleColor_; }
   // return true if the tool color for this update is a color that wasn't
@@ -72,6 +110,16 @@ class dockListUpdate {
   QVector<flossColor> colors() const { return colorsToAdd_; }
   bool removeColors() const { return !colorsToRemove_.empty(); }
   QVector<triC> colorsToRemove() const { return colorsToRemove_; }
+  // record that the tool use changed exactly the squares covered by
+  // <squares> (box coordinates, see squareRuns)
+  void setDirtySquares(const QVector<QRect>& squares) {
+    dirtySquares_ = squares;
+    dirtySquaresKnown_ = true;
+  }
+  // return true if the squares changed by the tool use are known (if
+  // not, the whole image has to be checked for changes)
+  bool dirtySquaresKnown() const { return dirtySquaresKnown_; }
+  QVector<QRect> dirtySquares() const { return dirtySquares_; }
  private:
   bool singleColor_; // true if this update is for a single color
   // colors that need to be added to the color list dock (if they don't
@@ -82,6 +130,9 @@ class dockListUpdate {
   bool colorIsNew_;
   // colors that need to be removed from the color list dock
   QVector<triC> colorsToRemove_;
+  // the squares changed by the tool use, if dirtySquaresKnown_
+  QVector<QRect> dirtySquares_;
+  bool dirtySquaresKnown_;
 };
 
 class historyItem : public QSharedData {
@@ -90,14 +141,24 @@ class historyItem : public QSharedData {
   virtual ~historyItem() {}
   // append the xml version of this history item to <appendee>
   virtual void toXml(QDomDocument* doc, QDomElement* appendee) const = 0;
+  // write the compact binary version of this history item to <stream>
+  virtual void toBinary(QDataStream* stream) const = 0;
+  // return the (approximate) number of bytes of memory this item uses
+  virtual qint64 byteCount() const = 0;
   // perform a history edit on <container> given the data of this history
   // item and the <direction> of the edit (forward or backward)
   virtual dockListUpdate
     performHistoryEdit(mutableSquareImageContainer* container,
                        historyDirection direction) const = 0;
+  // return the squares (box coordinates, see squareRuns) changed by
+  // performHistoryEdit on an image with squares of <originalDimension>
+  virtual QVector<QRect> squaresChanged(int originalDimension) const = 0;
   // a "factory" that returns a historyItem pointer to a derived history
   // item whose type and data are determined by the <xml> content
   static historyItemPtr xmlToHistoryItem(const QDomElement& xml);
+  // the binary version of xmlToHistoryItem; returns a null pointer if
+  // <stream> doesn't hold a valid history item
+  static historyItemPtr binaryToHistoryItem(QDataStream* stream);
 };
 
 class changeAllHistoryItem : public historyItem {
@@ -109,9 +170,13 @@ class changeAllHistoryItem : public historyItem {
     : toolColor_(toolColor), toolColorIsNew_(toolColorIsNew),
       priorColor_(oldColor), coordinates_(coordinates) {}
   explicit changeAllHistoryItem(const QDomElement& xmlHistory);
+  explicit changeAllHistoryItem(QDataStream* stream);
   void toXml(QDomDocument* doc, QDomElement* appendee) const;
+  void toBinary(QDataStream* stream) const;
+  qint64 byteCount() const;
   dockListUpdate performHistoryEdit(mutableSquareImageContainer* container,
                                     historyDirection direction) const;
+  QVector<QRect> squaresChanged(int originalDimension) const;
   flossColor toolColor() const { return toolColor_; }
   flossColor oldColor() const { return priorColor_; }
   QVector<pairOfInts> coordinates() const { return coordinates_; }
@@ -131,9 +196,13 @@ class changeOneHistoryItem : public historyItem {
     :  toolColor_(toolColor), toolColorIsNew_(toolColorIsNew),
        pixels_(pixels) {}
   explicit changeOneHistoryItem(const QDomElement& xmlHistory);
+  explicit changeOneHistoryItem(QDataStream* stream);
   void toXml(QDomDocument* doc, QDomElement* appendee) const;
+  void toBinary(QDataStream* stream) const;
+  qint64 byteCount() const;
   dockListUpdate performHistoryEdit(mutableSquareImageContainer* container,
                                     historyDirection direction) const;
+  QVector<QRect> squaresChanged(int originalDimension) const;
 
  private:
   const flossColor toolColor_; // the color associated with the tool used
@@ -150,9 +219,13 @@ class fillRegionHistoryItem : public historyItem {
     :  toolColor_(toolColor), toolColorIsNew_(toolColorIsNew),
        priorColor_(oldColor), coordinates_(coordinates) {}
   explicit fillRegionHistoryItem(const QDomElement& xmlHistory);
+  explicit fillRegionHistoryItem(QDataStream* stream);
   void toXml(QDomDocument* doc, QDomElement* appendee) const;
+  void toBinary(QDataStream* stream) const;
+  qint64 byteCount() const;
   dockListUpdate performHistoryEdit(mutableSquareImageContainer* container,
                                     historyDirection direction) const;
+  QVector<QRect> squaresChanged(int originalDimension) const;
 
  private:
   const flossColor toolColor_; // the color associated with the tool used
@@ -170,9 +243,13 @@ class detailHistoryItem : public historyItem {
                              flossType newColorsType)
     : detailPixels_(detailPixels), newColorsType_(newColorsType) {}
   explicit detailHistoryItem(const QDomElement& xmlHistory);
+  explicit detailHistoryItem(QDataStream* stream);
   void toXml(QDomDocument* doc, QDomElement* appendee) const;
+  void toBinary(QDataStream* stream) const;
+  qint64 byteCount() const;
   dockListUpdate performHistoryEdit(mutableSquareImageContainer* container,
                                     historyDirection direction) const;
+  QVector<QRect> squaresChanged(int originalDimension) const;
 
  private:
   const QVector<historyPixel> detailPixels_;
@@ -187,9 +264,13 @@ class rareColorsHistoryItem : public historyItem {
                         const QSet<flossColor>& rareColorTypes)
     : items_(items), rareColorTypes_(rareColorTypes) {}
   explicit rareColorsHistoryItem(const QDomElement& xmlHistory);
+  explicit rareColorsHistoryItem(QDataStream* stream);
   void toXml(QDomDocument* doc, QDomElement* appendee) const;
+  void toBinary(QDataStream* stream) const;
+  qint64 byteCount() const;
   dockListUpdate performHistoryEdit(mutableSquareImageContainer* container,
                                     historyDirection direction) const;
+  QVector<QRect> squaresChanged(int originalDimension) const;
 
  private:
   // a changeAllHistoryItem for each rare color that is replaced
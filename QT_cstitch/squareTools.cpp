@@ -127,6 +127,7 @@ void changeOneTool::activeImageClick(QMouseEvent* event) {
     const flossColor newColor = parent()->toolDock_->getToolLabelColor();
     dragCache_.newColor = newColor;
     dragCache_.squaresVisited.insert(boxCoordinates);
+    dragCache_.lastSquare = boxCoordinates;
     label->setSquaresColor(newColor.qrgb());
     label->addSquare(boxCoordinates);
     const int d = parent()->roughCurDim();
@@ -240,7 +241,7 @@ void changeOneTool::activeMouseMove(QMouseEvent* event) {
     squareTool::activeMouseMove(event);
   }
   // note: event->button is always nobutton, so have to use buttons()
-  if (event->buttons() & Qt::LeftButton) {
+  if (dragCache_.cacheIsActive && (event->buttons() & Qt::LeftButton)) {
     const int labelWidth = dragCache_.labelWidth;
     const int labelHeight = dragCache_.labelHeight;
     const int originalImageWidth = dragCache_.imageWidth;
@@ -256,28 +257,69 @@ void changeOneTool::activeMouseMove(QMouseEvent* event) {
     const int squareDim = dragCache_.squareDim;
     const int boxX = originalX/squareDim;
     const int boxY = originalY/squareDim;
-    // only process if we haven't already changed this square
     const pairOfInts boxCoordinates(boxX, boxY);
-    if (!dragCache_.squaresVisited.contains(boxCoordinates)) {
-      dragCache_.squaresVisited.insert(boxCoordinates);
-      squareImageLabel* label = parent()->activeSquareLabel();
-      label->addSquare(boxCoordinates);
-      const int xstart = boxX*squareDim;
-      const int ystart = boxY*squareDim;
-      //create 
-      QPoint start(xstart, ystart);
-      QPoint end(xstart + squareDim, ystart + squareDim);
-
-      const QMatrix4x4& matrix = dragCache_.matrix;
-      matrix.map(start);
-      matrix.map(end);
-      //matrix.map(xstart, ystart, &sxstart, &systart);
-      //matrix.map(xstart + squareDim, ystart + squareDim, &sxend, &syend);
-      const int dx = end.x() - start.x();
-      const int dy = end.y() - start.y();
-      label->update(x - dx, y - dy, 2*dx, 2*dy);
+    if (!(boxCoordinates == dragCache_.lastSquare)) {
+      // collect the squares this move crossed and repaint them all with
+      // one update (which Qt merges with any others still pending)
+      const QRect dirtyRect = visitSquaresTo(boxCoordinates);
+      dragCache_.lastSquare = boxCoordinates;
+      if (!dirtyRect.isNull()) {
+        parent()->activeSquareLabel()->update(dirtyRect);
+      }
+    }
+  }
+}
+
+QRect changeOneTool::visitSquaresTo(const pairOfInts& boxCoordinates) {
+
+  // Bresenham's line from the last square to this one
+  int x = dragCache_.lastSquare.x();
+  int y = dragCache_.lastSquare.y();
+  const int xEnd = boxCoordinates.x();
+  const int yEnd = boxCoordinates.y();
+  const int dx = qAbs(xEnd - x);
+  const int dy = -qAbs(yEnd - y);
+  const int xStep = (x < xEnd) ? 1 : -1;
+  const int yStep = (y < yEnd) ? 1 : -1;
+  int error = dx + dy;
+  QRect dirtyRect;
+  while (true) {
+    dirtyRect |= visitSquare(pairOfInts(x, y));
+    if (x == xEnd && y == yEnd) {
+      break;
+    }
+    const int error2 = 2*error;
+    if (error2 >= dy) {
+      error += dy;
+      x += xStep;
     }
+    if (error2 <= dx) {
+      error += dx;
+      y += yStep;
+    }
+  }
+  return dirtyRect;
+}
+
+QRect changeOneTool::visitSquare(const pairOfInts& boxCoordinates) {
+
+  const int squareDim = dragCache_.squareDim;
+  const int boxX = boxCoordinates.x();
+  const int boxY = boxCoordinates.y();
+  // the mouse can be dragged off of the image
+  if (boxX < 0 || boxY < 0 || boxX >= dragCache_.imageWidth/squareDim ||
+      boxY >= dragCache_.imageHeight/squareDim) {
+    return QRect();
+  }
+  // only process if we haven't already changed this square
+  if (dragCache_.squaresVisited.contains(boxCoordinates)) {
+    return QRect();
   }
+  dragCache_.squaresVisited.insert(boxCoordinates);
+  parent()->activeSquareLabel()->addSquare(boxCoordinates);
+  const QRect square(boxX*squareDim, boxY*squareDim, squareDim, squareDim);
+  // (pad by a pixel for rounding in the scaling)
+  return dragCache_.matrix.mapRect(square).adjusted(-1, -1, 1, 1);
 }
 
 void detailTool::activeMouseMove(QMouseEvent* event) {
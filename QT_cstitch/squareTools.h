@@ -21,6 +21,7 @@
 #define SQUARETOOLS_H
 
 #include <QtCore/QSet>
+#include <QtCore/QRect>
 #include <QCoreApplication>
 #include <QMatrix4x4>
 
@@ -42,6 +43,7 @@ struct changeOneDragCache {
   int labelWidth, labelHeight, imageWidth, imageHeight, squareDim;
   bool cacheIsActive; // true if this cache is currently being used
   QSet<pairOfInts> squaresVisited; // squares we've already drawn on
+  pairOfInts lastSquare; // the square under the last mouse position
   QMatrix4x4 matrix; // scaling matrix between displayed and original images
 };
 
@@ -136,6 +138,14 @@ class changeOneTool  : public inactiveImageClickBase {
   void mouseRelease();
   void setMouseHint();
  private:
+  // draw on every square on the line from dragCache_.lastSquare to
+  // <boxCoordinates> (inclusive), so that a fast drag doesn't skip
+  // squares between mouse events; return the label rectangle that needs
+  // repainting
+  QRect visitSquaresTo(const pairOfInts& boxCoordinates);
+  // draw on square <boxCoordinates> if it's on the image and we haven't
+  // already; return the label rectangle that needs repainting
+  QRect visitSquare(const pairOfInts& boxCoordinates);
   // cached values when the mouse is being dragged
   changeOneDragCache dragCache_;
 };
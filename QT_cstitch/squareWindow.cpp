@@ -27,12 +27,18 @@
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QMenuBar>
 #include <QtWidgets/QColorDialog>
+#include <QtWidgets/QProgressDialog>
+
+#include <QtCore/QFutureWatcher>
+
+#include <QtConcurrent/QtConcurrentRun>
 
 #include "symbolChooser.h"
 #include "colorDialog.h"
 #include "windowManager.h"
 #include "utility.h"
 #include "grid.h"
+#include "gridOverlay.h"
 #include "imageProcessing.h"
 #include "leftRightAccessors.h"
 #include "squareToolDock.h"
@@ -211,7 +217,8 @@ void squareWindow::addImage(const QImage& image, int squareDimension,
   // create a new right image
   if (index) { // not the original image
     rightImage_ = new mutableSquareImageContainer(name, colors, image,
-                                                  squareDimension, type);
+                                                  squareDimension, type,
+                                                  index);
   }
   else {
     rightImage_ = new immutableSquareImageContainer(name, image);
@@ -754,22 +761,19 @@ void squareWindow::requestSquareColor(int originalX, int originalY,
   activateColorDialog(oldColor, toolDock_->getFlossType(), neighborColors);
 }
 
-QImage squareWindow::gridedImage(const QImage& image, int originalSquareDim,
+QImage squareWindow::gridedImage(QImage image, int originalSquareDim,
                                  int originalWidth,
                                  int originalHeight) const {
 
-  if (!gridOn()) {
-    return image;
-  }
-  QImage returnImage = image.copy();
-  if (returnImage.isNull()) {
-    qWarning() << "Empty image in squareWindow::gridedImage" <<
-      image.width() << image.height();
-    return image;
+  if (gridOn()) {
+    // (<image> is our own copy, so this doesn't copy any pixels unless
+    // the caller is still holding on to them)
+    gridOverlay::forScaledImage(image.size(), originalSquareDim,
+                                QSize(originalWidth, originalHeight),
+                                leftLabel_->gridColor()).
+      drawOnStrip(&image, 0);
   }
-  ::gridImage(&returnImage, originalSquareDim, originalWidth,
-              originalHeight, leftLabel_->gridColor());
-  return returnImage;
+  return image;
 }
 
 void squareWindow::updateImageLabelImage(const QRect& updateRectangle) {
@@ -804,7 +808,14 @@ void squareWindow::curImageUpdated(const dockListUpdate& update,
   if (curImage_->colorListCheckNeeded()) {
     updateColorListAction_->setEnabled(true);
   }
-  updateImageLabelImage(updateRectangle);
+  if (update.dirtySquaresKnown() && updateRectangle.isNull()) {
+    // only the tool's squares need repainting
+    activeSquareLabel()->updateSquares(curImage_->image(),
+                                       update.dirtySquares());
+  }
+  else {
+    updateImageLabelImage(updateRectangle);
+  }
   updateHistoryButtonStates();
 }
 
@@ -828,6 +839,18 @@ QImage squareWindow::curImageForSaving() const {
                      curImage_->originalHeight());
 }
 
+imageStripRendererPtr squareWindow::curImageStripRenderer() const {
+
+  gridOverlay grid;
+  if (gridOn()) {
+    grid = gridOverlay::forScaledImage(curImage_->scaledSize(),
+                                       curImage_->originalDimension(),
+                                       curImage_->originalSize(),
+                                       leftLabel_->gridColor());
+  }
+  return imageStripRendererPtr(new squareStripRenderer(curImage_, grid));
+}
+
 void squareWindow::keyPressEvent(QKeyEvent* event) {
 
   imageCompareBase::keyPressEvent(event);
@@ -835,9 +858,23 @@ void squareWindow::keyPressEvent(QKeyEvent* event) {
 
 void squareWindow::processDetailCall(int numColors) {
 
+  const flossType type = toolDock_->getFlossType();
+  // the detailing is computed on the thread pool; the window keeps
+  // painting meanwhile but takes no input, so the image can't change
+  // before the result is committed
+  QFutureWatcher<QVector<historyPixel> > watcher;
+  watcher.setFuture(QtConcurrent::run(::computeDetailing, originalImage(),
+                                      detailTool_.coordinates(),
+                                      curImage_->originalDimension(),
+                                      numColors,
+                                      colorTransformer::
+                                      createColorTransformer(type)));
+  QProgressDialog meter(tr("Detailing..."), QString(), 0, 0, this);
+  meter.setWindowModality(Qt::WindowModal);
+  meter.setMinimumDuration(500);
+  ::waitForFuture(&watcher, &meter);
   const dockListUpdate update =
-    curImage_->performDetailing(originalImage(), detailTool_.coordinates(),
-                                numColors, toolDock_->getFlossType());
+    curImage_->commitDetailing(watcher.result(), type);
   ensureDetailSquaresCleared();
   curImageUpdated(update);
 }
@@ -862,6 +899,10 @@ void squareWindow::displayImageInfo() {
     const int yBoxes = curImage_->originalHeight()/squareDim;
     const flossType colorsType = ::getFlossType(curImage_->flossColors());
     const QString flossString = imageInfoFlossString(colorsType);
+    const QString historyString =
+      tr("Its edit history uses %1 KB of memory and %2 KB on disk.")
+      .arg(curImage_->historyBytesInMemory()/1024)
+      .arg(curImage_->historyBytesOnDisk()/1024);
     // for translation purposes, it seems best to not be clever about
     // splitting the cases...
     if (flossString == "") {
@@ -873,7 +914,8 @@ void squareWindow::displayImageInfo() {
                                .arg(::itoqs(height))
                                .arg(::itoqs(squareDim))
                                .arg(::itoqs(xBoxes))
-                               .arg(::itoqs(yBoxes)));
+                               .arg(::itoqs(yBoxes)) +
+                               "\n\n" + historyString);
     }
     else {
       QMessageBox::information(this, curImage_->name(),
@@ -885,7 +927,8 @@ void squareWindow::displayImageInfo() {
                                .arg(::itoqs(squareDim))
                                .arg(::itoqs(xBoxes))
                                .arg(::itoqs(yBoxes))
-                               .arg(flossString));
+                               .arg(flossString) +
+                               "\n\n" + historyString);
                                     
     }
   }
@@ -896,16 +939,15 @@ void squareWindow::imageDeleted(int imageIndex) {
   winManager()->squareWindowImageDeleted(imageIndex);
 }
 
-void squareWindow::writeCurrentHistory(QDomDocument* doc,
-                                       QDomElement* appendee,
-                                       int imageIndex) {
+squareHistorySnapshot squareWindow::currentHistorySnapshot(int imageIndex) {
 
   squareImagePtr container = squareImageFromIndex(imageIndex);
   if (container) {
-    container->writeImageHistory(doc, appendee);
+    return container->historySnapshot();
   }
   else {
-    qWarning() << "Lost image in imageHistoryFromIndex:" << imageIndex;
+    qWarning() << "Lost image in currentHistorySnapshot:" << imageIndex;
+    return squareHistorySnapshot();
   }
 }
 
@@ -154,10 +154,9 @@ class squareWindow : public imageCompareBase {
   // recreate a pattern image using the data in <saver> as part of a
   // project restore
   void recreatePatternImage(const patternWindowSaver& saver);
-  // append the current history and tool floss mode of the image with
-  // index <imageIndex> to <appendee> as xml
-  void writeCurrentHistory(QDomDocument* doc, QDomElement* appendee,
-                           int imageIndex);
+  // return a snapshot of the current history and tool floss mode of the
+  // image with index <imageIndex> (for writing out as xml later)
+  squareHistorySnapshot currentHistorySnapshot(int imageIndex);
   // update the edit history of the image whose information is contained
   // in <xml> and run the back history if it exists
   void updateImageHistory(const QDomElement& xml);
@@ -196,12 +195,12 @@ class squareWindow : public imageCompareBase {
     rightImage_ = container->squareContainer();
   }
   imagePtr rightImage() const { return rightImage_; }
-  // return a new grided version of the <image> (if the currently selected
-  // image supports gridding) using the last set grid color.
+  // return <image> grided in place (if the currently selected image
+  // supports gridding) using the last set grid color.
   // <image> may be scaled, but the other dimensions are from the original
   // unscaled <image>.
   // Returns <image> if <image> doesn't support gridding.
-  QImage gridedImage(const QImage& image, int originalSquareDim,
+  QImage gridedImage(QImage image, int originalSquareDim,
                      int originalWidth, int originalHeight) const;
   // returns true if the current image accepts gridding
   bool gridOn() const;
@@ -271,6 +270,8 @@ class squareWindow : public imageCompareBase {
   // a null image
   // implements imageSaverWindow::
   QImage curImageForSaving() const;
+  // implements imageSaverWindow::
+  imageStripRendererPtr curImageStripRenderer() const;
   // return approximately one square dim at the current zoom scale
   // used for updating images around a tool edit point
   int roughCurDim() const {
@@ -0,0 +1,132 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "stitchRegions.h"
+
+#include <algorithm>
+
+#include <QtGui/QImage>
+
+#include "imageUtility.h"
+
+// a horizontal run of one color on one row
+class regionRun {
+ public:
+  regionRun() : left_(0), right_(0), row_(0), color_(0) {}
+  regionRun(int left, int right, int row, QRgb color)
+    : left_(left), right_(right), row_(row), color_(color) {}
+  int left_;
+  int right_;
+  int row_;
+  QRgb color_;
+};
+
+// return the union-find root of <node>, halving the path on the way
+static int findRoot(QVector<int>* parents, int node) {
+
+  QVector<int>& parent = *parents;
+  while (parent[node] != node) {
+    parent[node] = parent[parent[node]];
+    node = parent[node];
+  }
+  return node;
+}
+
+stitchRegions::stitchRegions(const QImage& image, int dimension)
+  : xSquareCount_(image.width()/dimension),
+    ySquareCount_(image.height()/dimension) {
+
+  const QImage source = (image.depth() == 32) ? image :
+    image.convertToFormat(QImage::Format_RGB32);
+  QVector<regionRun> runs;
+  QVector<int> parents;
+  int previousRowStart = 0; // index on runs of the previous row's first run
+  for (int j = 0; j < ySquareCount_; ++j) {
+    const QRgb* line =
+      reinterpret_cast<const QRgb*>(source.constScanLine(j*dimension));
+    const int rowStart = runs.size();
+    int above = previousRowStart; // the first run above not yet passed
+    for (int i = 0; i < xSquareCount_; ) {
+      const QRgb color = line[i*dimension];
+      const int left = i;
+      for (++i; i < xSquareCount_ && line[i*dimension] == color; ++i) {}
+      const int right = i - 1;
+      const int thisRun = runs.size();
+      runs.push_back(regionRun(left, right, j, color));
+      parents.push_back(thisRun);
+      // join the same color runs above that overlap this one
+      while (above < rowStart && runs[above].right_ < left) {
+        ++above;
+      }
+      for (int k = above; k < rowStart && runs[k].left_ <= right; ++k) {
+        if (runs[k].color_ == color) {
+          const int rootAbove = ::findRoot(&parents, k);
+          const int rootHere = ::findRoot(&parents, thisRun);
+          if (rootAbove != rootHere) {
+            // (the older root wins, so roots are always a region's
+            // first run)
+            parents[qMax(rootAbove, rootHere)] = qMin(rootAbove, rootHere);
+          }
+        }
+      }
+    }
+    previousRowStart = rowStart;
+  }
+
+  // number the regions and label the squares
+  labels_.resize(xSquareCount_ * ySquareCount_);
+  QVector<int> regionOfRoot(runs.size(), -1);
+  for (int r = 0, size = runs.size(); r < size; ++r) {
+    const int root = ::findRoot(&parents, r);
+    int& region = regionOfRoot[root];
+    if (region == -1) {
+      region = regionColors_.size();
+      regionColors_.push_back(runs[r].color_);
+      regionSizes_.push_back(0);
+    }
+    const regionRun& run = runs[r];
+    regionSizes_[region] += run.right_ - run.left_ + 1;
+    int* label = labels_.data() + run.row_*xSquareCount_;
+    std::fill(label + run.left_, label + run.right_ + 1, region);
+  }
+}
+
+QHash<QRgb, QVector<int> > stitchRegions::regionSizesByColor() const {
+
+  QHash<QRgb, QVector<int> > returnSizes;
+  for (int i = 0, size = regionColors_.size(); i < size; ++i) {
+    returnSizes[regionColors_[i]].push_back(regionSizes_[i]);
+  }
+  return returnSizes;
+}
+
+QVector<pairOfInts> stitchRegions::squaresInRegionsUpTo(int maxSize) const {
+
+  QVector<pairOfInts> returnSquares;
+  for (int j = 0; j < ySquareCount_; ++j) {
+    const int* label = labels_.constData() + j*xSquareCount_;
+    for (int i = 0; i < xSquareCount_; ++i) {
+      if (regionSizes_[label[i]] <= maxSize) {
+        returnSquares.push_back(pairOfInts(i, j));
+      }
+    }
+  }
+  return returnSquares;
+}
@@ -0,0 +1,69 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef STITCHREGIONS_H
+#define STITCHREGIONS_H
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include <QtGui/QColor>
+
+class QImage;
+class pairOfInts;
+
+// stitchRegions labels the connected single color regions of a square
+// image (squares are connected if they share an edge and a color), so
+// that region sizes and small "isolated" regions can be found without
+// flood filling from every square.
+//
+//// Implementation notes
+//
+// Labelling is one pass over the image's horizontal runs of squares
+// with a union-find: each run is joined to the runs of the same color
+// that it touches in the row above, then the union-find roots are
+// numbered densely.  That's linear in the number of squares (and nearly
+// linear in the number of runs for the unions).
+class stitchRegions {
+
+ public:
+  // label <image>, which is made of squares of dimension <dimension>
+  stitchRegions(const QImage& image, int dimension);
+  int regionCount() const { return regionColors_.size(); }
+  // return the region of box (<x>, <y>)
+  int region(int x, int y) const { return labels_[y*xSquareCount_ + x]; }
+  int regionSize(int region) const { return regionSizes_[region]; }
+  QRgb regionColor(int region) const { return regionColors_[region]; }
+  // return the sizes of each color's regions
+  QHash<QRgb, QVector<int> > regionSizesByColor() const;
+  // return the squares (box coordinates, row major) of the regions with
+  // no more than <maxSize> squares
+  QVector<pairOfInts> squaresInRegionsUpTo(int maxSize) const;
+
+ private:
+  int xSquareCount_;
+  int ySquareCount_;
+  // the region of each square, row major
+  QVector<int> labels_;
+  QVector<int> regionSizes_;
+  QVector<QRgb> regionColors_;
+};
+
+#endif
@@ -0,0 +1,268 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "stripExporter.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+#include <QtCore/QSaveFile>
+#include <QtCore/QVector>
+
+#include <QtGui/QImage>
+
+#include "utility.h"
+
+// strips are rendered at about this many bytes apiece
+static const qint64 STRIP_BYTES = 16*1024*1024;
+
+void patternStripRenderer::renderStrip(QImage* strip, int top) const {
+
+  image_->renderPatternStrip(atlas_, strip, top);
+  grid_.drawOnStrip(strip, top);
+}
+
+void squareStripRenderer::renderStrip(QImage* strip, int top) const {
+
+  image_->renderScaledStrip(strip, top);
+  grid_.drawOnStrip(strip, top);
+}
+
+// tiffStripWriter writes a little endian, RGB, deflate compressed TIFF
+// one strip at a time.  The image file directory (which lists the strip
+// offsets) can only be written once all of the strips have been, so it
+// goes at the end and the header's pointer to it is patched on close.
+class tiffStripWriter {
+
+ public:
+  tiffStripWriter(const QString& fileName, const QSize& size,
+                  int rowsPerStrip)
+    : file_(fileName), size_(size), rowsPerStrip_(rowsPerStrip) {}
+  bool open();
+  // append <strip>'s pixels (Format_RGB32)
+  bool writeStrip(const QImage& strip);
+  // write the directory and commit the file
+  bool close();
+  void cancel() { file_.cancelWriting(); }
+  QString errorString() const { return error_; }
+
+ private:
+  // pad the file to a word boundary, as TIFF requires of offsets
+  void align();
+  // write a directory entry for a single SHORT or LONG <value>
+  void writeEntry(quint16 tag, quint16 type, quint32 count, quint32 value);
+  bool setError(const QString& error) {
+    error_ = error;
+    file_.cancelWriting();
+    return false;
+  }
+
+ private:
+  QSaveFile file_;
+  QDataStream stream_;
+  const QSize size_;
+  const int rowsPerStrip_;
+  QVector<quint32> stripOffsets_;
+  QVector<quint32> stripByteCounts_;
+  QString error_;
+};
+
+bool tiffStripWriter::open() {
+
+  if (!file_.open(QIODevice::WriteOnly)) {
+    return setError(file_.errorString());
+  }
+  stream_.setDevice(&file_);
+  stream_.setByteOrder(QDataStream::LittleEndian);
+  stream_.writeRawData("II", 2);
+  // the directory offset is filled in by close()
+  stream_ << quint16(42) << quint32(0);
+  return true;
+}
+
+bool tiffStripWriter::writeStrip(const QImage& strip) {
+
+  const int width = size_.width();
+  QByteArray rgb(width*3*strip.height(), Qt::Uninitialized);
+  uchar* out = reinterpret_cast<uchar*>(rgb.data());
+  for (int j = 0, height = strip.height(); j < height; ++j) {
+    const QRgb* line = reinterpret_cast<const QRgb*>(strip.constScanLine(j));
+    for (int i = 0; i < width; ++i) {
+      *out++ = qRed(line[i]);
+      *out++ = qGreen(line[i]);
+      *out++ = qBlue(line[i]);
+    }
+  }
+  // qCompress produces a zlib stream (which is what TIFF's deflate
+  // compression wants) behind a four byte length prefix
+  const QByteArray compressed = qCompress(rgb);
+  const int compressedSize = compressed.size() - 4;
+  align();
+  const qint64 offset = file_.pos();
+  if (offset + compressedSize > Q_INT64_C(0xffffffff)) {
+    return setError(QObject::tr("The image is too large for a TIFF file."));
+  }
+  stripOffsets_.push_back(static_cast<quint32>(offset));
+  stripByteCounts_.push_back(compressedSize);
+  if (stream_.writeRawData(compressed.constData() + 4, compressedSize) !=
+      compressedSize) {
+    return setError(file_.errorString());
+  }
+  return true;
+}
+
+void tiffStripWriter::align() {
+
+  if (file_.pos() % 2) {
+    stream_ << quint8(0);
+  }
+}
+
+void tiffStripWriter::writeEntry(quint16 tag, quint16 type, quint32 count,
+                                 quint32 value) {
+
+  stream_ << tag << type << count;
+  if (type == 3 && count == 1) { // a SHORT goes in the first two bytes
+    stream_ << quint16(value) << quint16(0);
+  }
+  else {
+    stream_ << value;
+  }
+}
+
+bool tiffStripWriter::close() {
+
+  const quint32 stripCount = stripOffsets_.size();
+  // values too large for their directory entry go before the directory
+  align();
+  const quint32 bitsPerSampleOffset = file_.pos();
+  stream_ << quint16(8) << quint16(8) << quint16(8);
+  const quint32 resolutionOffset = file_.pos();
+  stream_ << quint32(72) << quint32(1);
+  quint32 stripOffsetsOffset = stripOffsets_.isEmpty() ? 0 : stripOffsets_[0];
+  quint32 stripByteCountsOffset =
+    stripByteCounts_.isEmpty() ? 0 : stripByteCounts_[0];
+  if (stripCount > 1) {
+    stripOffsetsOffset = file_.pos();
+    for (quint32 i = 0; i < stripCount; ++i) {
+      stream_ << stripOffsets_[i];
+    }
+    stripByteCountsOffset = file_.pos();
+    for (quint32 i = 0; i < stripCount; ++i) {
+      stream_ << stripByteCounts_[i];
+    }
+  }
+
+  // the directory, with its entries in tag order
+  const quint32 directoryOffset = file_.pos();
+  const quint16 SHORT = 3, LONG = 4, RATIONAL = 5;
+  stream_ << quint16(13);
+  writeEntry(256, LONG, 1, size_.width()); // ImageWidth
+  writeEntry(257, LONG, 1, size_.height()); // ImageLength
+  writeEntry(258, SHORT, 3, bitsPerSampleOffset); // BitsPerSample
+  writeEntry(259, SHORT, 1, 8); // Compression: deflate
+  writeEntry(262, SHORT, 1, 2); // PhotometricInterpretation: RGB
+  writeEntry(273, LONG, stripCount, stripOffsetsOffset); // StripOffsets
+  writeEntry(277, SHORT, 1, 3); // SamplesPerPixel
+  writeEntry(278, LONG, 1, rowsPerStrip_); // RowsPerStrip
+  writeEntry(279, LONG, stripCount, stripByteCountsOffset); // StripByteCounts
+  writeEntry(282, RATIONAL, 1, resolutionOffset); // XResolution
+  writeEntry(283, RATIONAL, 1, resolutionOffset); // YResolution
+  writeEntry(284, SHORT, 1, 1); // PlanarConfiguration: chunky
+  writeEntry(296, SHORT, 1, 2); // ResolutionUnit: inch
+  stream_ << quint32(0); // no more directories
+
+  if (!file_.seek(4)) {
+    return setError(file_.errorString());
+  }
+  stream_ << directoryOffset;
+  if (stream_.status() != QDataStream::Ok) {
+    return setError(file_.errorString());
+  }
+  if (!file_.commit()) {
+    error_ = file_.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool stripExporter::canStream(const QString& fileName) {
+
+  const QString fileExtension = ::extension(fileName).toLower();
+  return fileExtension == "tif" || fileExtension == "tiff";
+}
+
+bool stripExporter::save(const imageStripRenderer& renderer,
+                         const QString& fileName, QString* error) {
+
+  const QSize size = renderer.size();
+  const int rowsPerStrip =
+    qBound(1, static_cast<int>(STRIP_BYTES/(qMax(size.width(), 1)*4)),
+           qMax(size.height(), 1));
+  QImage strip(size.width(), rowsPerStrip, QImage::Format_RGB32);
+  if (strip.isNull()) {
+    qWarning() << "Strip allocation failed in stripExporter:" << size;
+    if (error) {
+      *error = QObject::tr("There wasn't enough memory to save the image.");
+    }
+    return false;
+  }
+
+  tiffStripWriter writer(fileName, size, rowsPerStrip);
+  if (!writer.open()) {
+    if (error) {
+      *error = writer.errorString();
+    }
+    return false;
+  }
+  const int stripCount = (size.height() + rowsPerStrip - 1)/rowsPerStrip;
+  altMeter meter(QObject::tr("Saving image..."), QObject::tr("Cancel"),
+                 0, stripCount);
+  meter.setMinimumDuration(500);
+  for (int i = 0; i < stripCount; ++i) {
+    meter.setValue(i);
+    if (meter.wasCanceled()) {
+      writer.cancel();
+      if (error) {
+        error->clear();
+      }
+      return false;
+    }
+    const int top = i*rowsPerStrip;
+    const int rows = qMin(rowsPerStrip, size.height() - top);
+    if (rows != strip.height()) { // the last strip may be short
+      strip = strip.copy(0, 0, size.width(), rows);
+    }
+    renderer.renderStrip(&strip, top);
+    if (!writer.writeStrip(strip)) {
+      if (error) {
+        *error = writer.errorString();
+      }
+      return false;
+    }
+  }
+  meter.setValue(stripCount);
+  if (!writer.close()) {
+    if (error) {
+      *error = writer.errorString();
+    }
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef STRIPEXPORTER_H
+#define STRIPEXPORTER_H
+
+#include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
+
+#include "gridOverlay.h"
+#include "patternImageContainer.h"
+#include "squareImageContainer.h"
+
+class QImage;
+class QString;
+
+// imageStripRenderer renders an image a horizontal strip at a time, so
+// that an image can be saved without ever holding all of its pixels.
+class imageStripRenderer {
+
+ public:
+  virtual ~imageStripRenderer() {}
+  // the size of the full image
+  virtual QSize size() const = 0;
+  // render the image rows starting at <top> onto <strip>, a Format_RGB32
+  // image as wide as the full image
+  virtual void renderStrip(QImage* strip, int top) const = 0;
+};
+typedef QSharedPointer<imageStripRenderer> imageStripRendererPtr;
+
+// render a pattern's symbol image (at the current symbol size) plus
+// <grid>
+class patternStripRenderer : public imageStripRenderer {
+
+ public:
+  patternStripRenderer(patternImagePtr image, const gridOverlay& grid)
+    : image_(image), atlas_(image->atlasCurSymbolSize()), grid_(grid) {}
+  QSize size() const { return image_->patternSizeCurSymbolSize(); }
+  void renderStrip(QImage* strip, int top) const;
+
+ private:
+  patternImagePtr image_;
+  const symbolAtlas atlas_;
+  const gridOverlay grid_;
+};
+
+// render a square image at its current scaled size plus <grid>
+class squareStripRenderer : public imageStripRenderer {
+
+ public:
+  squareStripRenderer(squareImagePtr image, const gridOverlay& grid)
+    : image_(image), grid_(grid) {}
+  QSize size() const { return image_->scaledSize(); }
+  void renderStrip(QImage* strip, int top) const;
+
+ private:
+  squareImagePtr image_;
+  const gridOverlay grid_;
+};
+
+// stripExporter writes the image from an imageStripRenderer to a TIFF
+// file one strip at a time: each strip is rendered, deflate compressed
+// and written out before the next is rendered, so memory use is bounded
+// by the strip size no matter how large the image is.  (Qt's image
+// writers all need the complete image, and Qt has no incremental png
+// writer, so TIFF - whose strips are independently compressed - is the
+// streaming format.)
+class stripExporter {
+
+ public:
+  // return true if <fileName>'s extension is one stripExporter writes
+  static bool canStream(const QString& fileName);
+  // write <renderer>'s image to <fileName>, showing a cancelable progress
+  // meter.  Return false if the save failed or was canceled, in which
+  // case <fileName> is left untouched and <error> (if not NULL) is set to
+  // the reason (empty for cancel).
+  static bool save(const imageStripRenderer& renderer,
+                   const QString& fileName, QString* error);
+};
+
+#endif
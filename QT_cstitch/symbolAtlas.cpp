@@ -0,0 +1,137 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "symbolAtlas.h"
+
+#include <cstring>
+
+#include <QtCore/QDebug>
+#include <QtCore/QVector>
+
+#include <QtGui/QPainter>
+
+symbolAtlas::symbolAtlas(const QHash<QRgb, QPixmap>& symbols)
+  : dimension_(0), badSlot_(0) {
+
+  if (symbols.isEmpty()) {
+    return;
+  }
+  dimension_ = symbols.begin().value().width();
+  if (dimension_ <= 0) {
+    dimension_ = 0;
+    return;
+  }
+  badSlot_ = symbols.size();
+  atlas_ = QImage(dimension_, dimension_*(badSlot_ + 1),
+                  QImage::Format_RGB32);
+  if (atlas_.isNull()) {
+    qWarning() << "Atlas allocation failed:" << dimension_ << badSlot_;
+    dimension_ = 0;
+    return;
+  }
+  QPainter painter(&atlas_);
+  int slot = 0;
+  for (QHash<QRgb, QPixmap>::const_iterator it = symbols.begin(),
+         end = symbols.end(); it != end; ++it, ++slot) {
+    if (it.value().width() != dimension_ ||
+        it.value().height() != dimension_) {
+      qWarning() << "Mismatched symbol size in symbolAtlas:"
+                 << it.value().size() << dimension_;
+      continue; // leave it on the bad slot
+    }
+    painter.fillRect(0, slot*dimension_, dimension_, dimension_, Qt::white);
+    painter.drawPixmap(0, slot*dimension_, it.value());
+    slots_.insert(it.key(), slot);
+  }
+  painter.fillRect(0, badSlot_*dimension_, dimension_, dimension_,
+                   QColor(255, 0, 0));
+}
+
+bool symbolAtlas::replaceSymbol(QRgb color, const QPixmap& symbol) {
+
+  const QHash<QRgb, int>::const_iterator it = slots_.find(color);
+  if (it == slots_.end() || symbol.width() != dimension_ ||
+      symbol.height() != dimension_) {
+    return false;
+  }
+  QPainter painter(&atlas_);
+  painter.fillRect(0, it.value()*dimension_, dimension_, dimension_,
+                   Qt::white);
+  painter.drawPixmap(0, it.value()*dimension_, symbol);
+  return true;
+}
+
+void symbolAtlas::render(const QImage& squareImage, int squareDim,
+                         QImage* target, const QPoint& origin) const {
+
+  if (isNull() || squareDim <= 0) {
+    return;
+  }
+  const QImage source = (squareImage.depth() == 32) ? squareImage :
+    squareImage.convertToFormat(QImage::Format_RGB32);
+  const int xBoxes = squareImage.width()/squareDim;
+  const int yBoxes = squareImage.height()/squareDim;
+  // the part of the pattern on the target, in pattern coordinates
+  const QRect area = QRect(origin, target->size()).
+    intersected(QRect(0, 0, xBoxes*dimension_, yBoxes*dimension_));
+  if (area.isEmpty()) {
+    return;
+  }
+  const int xBoxStart = area.left()/dimension_;
+  const int xBoxEnd = area.right()/dimension_ + 1;
+  const int atlasBytesPerLine = atlas_.bytesPerLine();
+  const uchar* const atlasBits = atlas_.constBits();
+  // the atlas line offset of each box's symbol on the current box row
+  QVector<int> slotLines(xBoxEnd - xBoxStart);
+  int curYBox = -1;
+  for (int y = area.top(); y <= area.bottom(); ++y) {
+    const int yBox = y/dimension_;
+    if (yBox != curYBox) {
+      curYBox = yBox;
+      const QRgb* squareLine = reinterpret_cast<const QRgb*>
+        (source.constScanLine(yBox*squareDim));
+      // neighboring squares are usually the same color, so skip the
+      // lookup for runs
+      QRgb lastColor = 0;
+      int lastSlot = -1;
+      for (int i = xBoxStart; i < xBoxEnd; ++i) {
+        const QRgb color = squareLine[i*squareDim];
+        if (lastSlot == -1 || color != lastColor) {
+          lastColor = color;
+          lastSlot = slot(color);
+        }
+        slotLines[i - xBoxStart] = lastSlot*dimension_;
+      }
+    }
+    const int symbolRow = y - yBox*dimension_;
+    QRgb* targetLine =
+      reinterpret_cast<QRgb*>(target->scanLine(y - origin.y()));
+    for (int i = xBoxStart; i < xBoxEnd; ++i) {
+      const int boxLeft = i*dimension_;
+      const int xStart = qMax(boxLeft, area.left());
+      const int xEnd = qMin(boxLeft + dimension_, area.right() + 1);
+      const QRgb* atlasLine = reinterpret_cast<const QRgb*>
+        (atlasBits +
+         (slotLines[i - xBoxStart] + symbolRow)*atlasBytesPerLine);
+      memcpy(targetLine + (xStart - origin.x()), atlasLine + (xStart - boxLeft),
+             (xEnd - xStart)*sizeof(QRgb));
+    }
+  }
+}
@@ -0,0 +1,74 @@
+//
+// Copyright 2010, 2011 Tom Klein.
+//
+// This file is part of cstitch.
+//
+// cstitch is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SYMBOLATLAS_H
+#define SYMBOLATLAS_H
+
+#include <QtCore/QHash>
+
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+
+class QPoint;
+
+// symbolAtlas holds a set of same sized symbols (or color squares) in
+// one contiguous image, together with a color->slot table, so that a
+// pattern can be rendered by copying symbol rows straight into the
+// target's scanlines instead of looking up and drawing a pixmap per
+// stitch.
+//
+// Slots are stacked vertically, so each symbol is a contiguous block of
+// the atlas.  The last slot is solid red and is used for any color
+// without a symbol, to make the problem obvious.
+//
+// symbolAtlas is cheap to copy (its image and table are implicitly
+// shared).
+class symbolAtlas {
+
+ public:
+  symbolAtlas() : dimension_(0), badSlot_(0) {}
+  // build the atlas from <symbols>, which must all be square and the
+  // same size
+  explicit symbolAtlas(const QHash<QRgb, QPixmap>& symbols);
+  bool isNull() const { return dimension_ == 0; }
+  // the size of the symbols
+  int dimension() const { return dimension_; }
+  // redraw the slot for <color> with <symbol> (which must have the
+  // atlas' dimension).  Return false if <color> has no slot.
+  bool replaceSymbol(QRgb color, const QPixmap& symbol);
+  // render the pattern for <squareImage> (made of squares of dimension
+  // <squareDim>, one symbol per square) onto <target>, a Format_RGB32
+  // image whose top left pixel is pattern pixel <origin>.  Target pixels
+  // off of the pattern are left alone.
+  void render(const QImage& squareImage, int squareDim,
+              QImage* target, const QPoint& origin) const;
+
+ private:
+  // return the slot for <color>
+  int slot(QRgb color) const { return slots_.value(color, badSlot_); }
+
+ private:
+  int dimension_;
+  QImage atlas_;
+  QHash<QRgb, int> slots_;
+  int badSlot_;
+};
+
+#endif
@@ -23,7 +23,18 @@
 
 #include <QOperatingSystemVersion>
 
+#include <QtCore/QCache>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
 #include <QtCore/QDebug>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThreadPool>
+
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <QFontDatabase>
 #include <QPainter>
@@ -36,6 +47,67 @@ extern const int MAX_NUM_SYMBOL_TYPES = 4;
 QVector<QChar> symbolChooser::unicodeCharacters_ = QVector<QChar>();
 symbolChooser::cheapFont symbolChooser::unicodeFont_ = symbolChooser::cheapFont();
 
+// the glyph cache holds about this many kilobytes of glyphs
+static const int GLYPH_CACHE_KB = 32*1024;
+
+// key for a rendered glyph in the glyph cache
+class glyphKey {
+ public:
+  glyphKey(int index, int dimension, int border, QRgb background)
+    : index_(index), dimension_(dimension), border_(border),
+      // the background only shows in the border
+      background_(border ? background : qRgb(255, 255, 255)) {}
+  bool operator==(const glyphKey& other) const {
+    return index_ == other.index_ && dimension_ == other.dimension_ &&
+      border_ == other.border_ && background_ == other.background_;
+  }
+  uint hash() const {
+    return ::qHash((index_ << 16) ^ (dimension_ << 8) ^ border_) ^
+      ::qHash(background_);
+  }
+ private:
+  int index_;
+  int dimension_;
+  int border_;
+  QRgb background_;
+};
+
+inline uint qHash(const glyphKey& key) { return key.hash(); }
+
+// the process wide glyph cache; glyphs may be rendered (and cached) from
+// worker threads, so access is locked
+static QMutex glyphCacheMutex;
+static QCache<glyphKey, QImage> glyphCache(GLYPH_CACHE_KB);
+// runs warmSymbols' renders; defined after the cache so that at exit it's
+// destroyed (which waits for any running render) before the cache is
+static QThreadPool glyphWarmingPool;
+
+// return a fingerprint of everything the symbol font probe depends on:
+// the characters we'd like to use, the installed font families, the
+// application font, the font directories' modification times (which
+// change whenever fonts are installed or removed) and the Qt version
+static QString symbolFontFingerprint(const QVector<QChar>& maybeChars,
+                                     const QStringList& fontList,
+                                     const QString& appFontFamily) {
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QString(maybeChars.constData(), maybeChars.size()).toUtf8());
+  hash.addData(fontList.join("\n").toUtf8());
+  hash.addData(appFontFamily.toUtf8());
+  const QStringList fontDirectories =
+    QStandardPaths::standardLocations(QStandardPaths::FontsLocation);
+  for (int i = 0, size = fontDirectories.size(); i < size; ++i) {
+    const QFileInfo directory(fontDirectories[i]);
+    hash.addData(fontDirectories[i].toUtf8());
+    if (directory.exists()) {
+      hash.addData(QByteArray::number(directory.lastModified().
+                                      toMSecsSinceEpoch()));
+    }
+  }
+  hash.addData(QT_VERSION_STR);
+  return QString(hash.result().toHex());
+}
+
 // functor for comparing two triCs by intensity
 class triCIntensityDefinite {
  public:
@@ -122,10 +194,47 @@ QHash<QRgb, QPixmap> symbolChooser::getSymbols(int symbolDim) {
 
 QPixmap symbolChooser::createSymbol(int index, const triC& color) const {
 
-  const int drawDimension = symbolDimension_ - 2 * borderDimension_;
-  QPixmap drawSymbol(drawDimension, drawDimension);
-  drawSymbol.fill(Qt::white);
   if (index < numberOfSymbols()) {
+    return QPixmap::fromImage(cachedGlyph(index, symbolDimension_,
+                                          borderDimension_, color.qrgb()));
+  }
+  // no symbols left, so just make it the original color
+  QPixmap symbol(symbolDimension_, symbolDimension_);
+  symbol.fill(color.qc());
+  return symbol;
+}
+
+QImage symbolChooser::cachedGlyph(int index, int symbolDim, int borderDim,
+                                  QRgb color) {
+
+  const glyphKey key(index, symbolDim, borderDim, color);
+  {
+    QMutexLocker locker(&glyphCacheMutex);
+    const QImage* glyph = glyphCache.object(key);
+    if (glyph) {
+      return *glyph;
+    }
+  }
+  // render unlocked; if another thread beats us to it, no harm done
+  const QImage glyph = renderGlyph(index, symbolDim, borderDim, color);
+  if (!glyph.isNull()) {
+    QMutexLocker locker(&glyphCacheMutex);
+    glyphCache.insert(key, new QImage(glyph),
+                      qMax(1, static_cast<int>(glyph.sizeInBytes()/1024)));
+  }
+  return glyph;
+}
+
+QImage symbolChooser::renderGlyph(int index, int symbolDim, int borderDim,
+                                  QRgb color) {
+
+  const int drawDimension = symbolDim - 2 * borderDim;
+  QImage drawSymbol(drawDimension, drawDimension, QImage::Format_RGB32);
+  if (drawSymbol.isNull()) {
+    return drawSymbol;
+  }
+  drawSymbol.fill(qRgb(255, 255, 255));
+  {
     QPainter painter(&drawSymbol);
     painter.setRenderHint(QPainter::Antialiasing, true);
     const int interval = unicodeCharacters_.size();
@@ -151,19 +260,12 @@ QPixmap symbolChooser::createSymbol(int index, const triC& color) const {
                          drawDimension - heightBuffer/2);
     painter.drawText(textRect, Qt::AlignCenter, symbolString);
   }
-  else { // no symbols left, so just make it the original color
-    QPainter painter(&drawSymbol);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.fillRect(0, 0, drawDimension, drawDimension, color.qc());
-  }
 
-  if (borderDimension_) {
-    QPixmap newSymbol(symbolDimension_, symbolDimension_);
-    newSymbol.fill(color.qrgb());
+  if (borderDim) {
+    QImage newSymbol(symbolDim, symbolDim, QImage::Format_RGB32);
+    newSymbol.fill(color);
     QPainter painter(&newSymbol);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.drawPixmap(QPoint(borderDimension_, borderDimension_),
-                       drawSymbol);
+    painter.drawImage(QPoint(borderDim, borderDim), drawSymbol);
     return newSymbol;
   }
   else {
@@ -171,9 +273,47 @@ QPixmap symbolChooser::createSymbol(int index, const triC& color) const {
   }
 }
 
+void symbolChooser::warmGlyphs(const QVector<QPair<int, QRgb> >& glyphs,
+                               int symbolDim, int borderDim) {
+
+  for (int i = 0, size = glyphs.size(); i < size; ++i) {
+    cachedGlyph(glyphs[i].first, symbolDim, borderDim, glyphs[i].second);
+  }
+}
+
+void symbolChooser::warmSymbols(int symbolDim) const {
+
+  if (symbolDim - 2 * borderDimension_ <= 0) {
+    return;
+  }
+  QVector<QPair<int, QRgb> > glyphs;
+  {
+    QMutexLocker locker(&glyphCacheMutex);
+    for (QHash<QRgb, patternSymbolIndex>::const_iterator
+           it = symbolMap_.begin(), end = symbolMap_.end(); it != end; ++it) {
+      const int index = it.value().index();
+      if (index < numberOfSymbols() &&
+          !glyphCache.contains(glyphKey(index, symbolDim, borderDimension_,
+                                        it.key()))) {
+        glyphs.push_back(qMakePair(index, it.key()));
+      }
+    }
+  }
+  if (!glyphs.isEmpty()) {
+    QtConcurrent::run(&glyphWarmingPool, &symbolChooser::warmGlyphs,
+                      glyphs, symbolDim, borderDimension_);
+  }
+}
+
+void symbolChooser::stopWarmingSymbols() {
+
+  glyphWarmingPool.clear();
+  glyphWarmingPool.waitForDone();
+}
+
 // circle
 void symbolChooser::createSymbolType2(QPainter* painter,
-                                      int drawDimension) const {
+                                      int drawDimension) {
 
   painter->save();
   painter->drawEllipse(0, 0, drawDimension, drawDimension);
@@ -182,7 +322,7 @@ void symbolChooser::createSymbolType2(QPainter* painter,
 
 // NW and SE diagonals
 void symbolChooser::createSymbolType3(QPainter* painter,
-                                      int drawDimension) const {
+                                      int drawDimension) {
 
   const qreal d1 = static_cast<qreal>(drawDimension)/3;
   const qreal d2 = drawDimension - d1;
@@ -193,7 +333,7 @@ void symbolChooser::createSymbolType3(QPainter* painter,
 
 // NE and SW diagonals
 void symbolChooser::createSymbolType4(QPainter* painter,
-                                      int drawDimension) const {
+                                      int drawDimension) {
 
   const qreal d1 = static_cast<qreal>(drawDimension)/3;
   const qreal d2 = drawDimension - d1;
@@ -454,6 +594,28 @@ void symbolChooser::initializeSymbolList() {
   QStringList fontList(database.families());
   const QFont appFont(QApplication::font());
   const QString appFontFamily = appFont.family();
+  // the probe below checks every character on every candidate font, so
+  // its result is kept in the settings for as long as the fonts don't
+  // change
+  const QString fingerprint =
+    ::symbolFontFingerprint(maybeChars, fontList, appFontFamily);
+  QSettings settings("cstitch", "cstitch");
+  if (settings.value("symbol_font_fingerprint").toString() == fingerprint) {
+    const QString cachedCharacters =
+      settings.value("symbol_font_characters").toString();
+    if (!cachedCharacters.isEmpty()) {
+      for (int i = 0, size = cachedCharacters.size(); i < size; ++i) {
+        unicodeCharacters_.push_back(cachedCharacters[i]);
+      }
+      unicodeFont_.setFont(QFont(settings.value("symbol_font_family").
+                                 toString(),
+                                 settings.value("symbol_font_point_size").
+                                 toInt(),
+                                 settings.value("symbol_font_weight").
+                                 toInt()));
+      return;
+    }
+  }
 //  qDebug() << "Application font: " << appFont.family();
 //  qDebug() << "Available fonts: " << fontList;
   // who knows what we'll get if we just blindly choose a font
@@ -541,4 +703,11 @@ void symbolChooser::initializeSymbolList() {
   }
 //  qDebug() << "Number of font symbols available: " << unicodeCharacters_.length();
   unicodeFont_.setFont(chosenFont);
+  settings.setValue("symbol_font_fingerprint", fingerprint);
+  settings.setValue("symbol_font_family", chosenFont.family());
+  settings.setValue("symbol_font_point_size", chosenFont.pointSize());
+  settings.setValue("symbol_font_weight", chosenFont.weight());
+  settings.setValue("symbol_font_characters",
+                    QString(unicodeCharacters_.constData(),
+                            unicodeCharacters_.size()));
 }
@@ -21,6 +21,7 @@
 #define SYMBOLCHOOSER_H
 
 #include <QFont>
+#include <QtCore/QPair>
 
 #include "triC.h"
 #include "stepIndex.h"
@@ -68,6 +69,13 @@ extern const int MAX_NUM_SYMBOL_TYPES;
 // multiple combinations of size/border stored in the symbol map at
 // any given time.
 //
+// Rendering a symbol (font sizing, antialiased text, outline) is slow,
+// so rendered glyphs are also kept in a process wide LRU cache keyed by
+// (symbol index, size, border, border color) and shared by all
+// symbolChoosers; replacing a symbolMap_ entry at a size that was seen
+// before (zooming back and forth, printing again) is then just a
+// lookup.
+//
 class symbolChooser {
 
  public:
@@ -141,6 +149,13 @@ class symbolChooser {
   }
   // return a sample symbol of size <symbolSize> using the symbol font
   static QPixmap getSampleSymbol(int symbolSize);
+  // start rendering the current symbols at total size <symbolDim> (and
+  // the current border) into the glyph cache in the background, so that
+  // a later request for them (on a zoom, say) is a cache hit
+  void warmSymbols(int symbolDim) const;
+  // drop any warmSymbols renders that haven't started and wait for the
+  // running ones to finish (call before quitting)
+  static void stopWarmingSymbols();
 
  private:
   // return the next available index;
@@ -153,11 +168,25 @@ class symbolChooser {
   // border; doesn't update symbolMap_
   QPixmap createSymbol(int index,
                        const triC& color = triC(255, 255, 255)) const;
+  // return the glyph for symbol <index> with total size <symbolDim>,
+  // border <borderDim> and border color <color> from the process wide
+  // glyph cache, rendering it first if it isn't cached.
+  // <index> must be less than numberOfSymbols().
+  // Safe to call from any thread.
+  static QImage cachedGlyph(int index, int symbolDim, int borderDim,
+                            QRgb color);
+  // render the glyph for cachedGlyph
+  static QImage renderGlyph(int index, int symbolDim, int borderDim,
+                            QRgb color);
+  // cache the glyphs for the (index, color) pairs on <glyphs>
+  // (run in the background by warmSymbols)
+  static void warmGlyphs(const QVector<QPair<int, QRgb> >& glyphs,
+                         int symbolDim, int borderDim);
   // draw the background pixmap for the different types of symbols
   // (type1 is "plain")
-  void createSymbolType2(QPainter* painter, int drawDim) const;
-  void createSymbolType3(QPainter* painter, int drawDim) const;
-  void createSymbolType4(QPainter* painter, int drawDim) const;
+  static void createSymbolType2(QPainter* painter, int drawDim);
+  static void createSymbolType3(QPainter* painter, int drawDim);
+  static void createSymbolType4(QPainter* painter, int drawDim);
   // return the total number of possible symbols
   int numberOfSymbols() const {
     return unicodeCharacters_.size() * numSymbolTypes_;
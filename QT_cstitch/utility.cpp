@@ -20,9 +20,13 @@
 #include "utility.h"
 
 #include <QtCore/qmath.h>
+#include <QtCore/QEventLoop>
 #include <QtCore/QFile>
+#include <QtCore/QFutureWatcherBase>
 #include <QtCore/QTextStream>
+#include <QtCore/QThread>
 
+#include <QtWidgets/QApplication>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QFileDialog>
 #include <QImageWriter>
@@ -86,7 +90,10 @@ groupProgressDialog::groupProgressDialog(int numDialogs)
 altMeter::altMeter(const QString& labelText, const QString& cancelButtonText,
                    int minimum, int maximum) {
 
-  if (!groupDialog_) {
+  if (QThread::currentThread() != qApp->thread()) {
+    dialog_ = NULL;
+  }
+  else if (!groupDialog_) {
     dialog_ = new QProgressDialog;
     dialog_->setLabelText(labelText);
     dialog_->setCancelButtonText(cancelButtonText);
@@ -138,3 +145,26 @@ QStringList existingFiles(const QStringList& fileList) {
   }
   return returnList;
 }
+
+void waitForFuture(QFutureWatcherBase* watcher, QProgressDialog* meter) {
+
+  // (the meter may be a group meter whose range belongs to someone else,
+  // so the future's progress is mapped onto its range rather than
+  // replacing it)
+  QEventLoop loop;
+  QObject::connect(watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+  QObject::connect(watcher, SIGNAL(progressValueChanged(int)),
+                   &loop, SLOT(quit()));
+  while (!watcher->isFinished()) {
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    const int jobRange =
+      watcher->progressMaximum() - watcher->progressMinimum();
+    const int meterRange = meter->maximum() - meter->minimum();
+    if (jobRange > 0 && meterRange > 0) {
+      const qint64 jobsDone =
+        watcher->progressValue() - watcher->progressMinimum();
+      meter->setValue(meter->minimum() +
+                      static_cast<int>(jobsDone * meterRange/jobRange));
+    }
+  }
+}
@@ -27,6 +27,8 @@
 #include <QtWidgets/QProgressDialog>
 #include <QCloseEvent>
 
+class QFutureWatcherBase;
+
 // special floss color codes
 const int DMC_PRE_0_9_5_30_COUNT = 427;
 const int DMC_POST_0_9_5_29_COUNT = 454;
@@ -142,6 +144,10 @@ QAction* actionFromImageName(const QList<QAction*>& list,
 // case the empty string is returned
 QString getNewImageFileName(QWidget* activeWindow, bool displayWarning);
 
+// run an event loop (ignoring user input) until <watcher>'s future
+// finishes, showing its progress on <meter> (within <meter>'s range)
+void waitForFuture(QFutureWatcherBase* watcher, QProgressDialog* meter);
+
 // groupProgressDialog is used during project restore in combination with
 // altMeters to display which image is currently being restored and the
 // current progress on that image.  The way it works:
@@ -182,22 +188,33 @@ class groupProgressDialog : public QProgressDialog {
 // see documentation above for groupProgressDialog on the interaction
 // between that class and this.
 // setGroupMeter MUST NOT be called while any altMeter is active
+// An altMeter constructed off of the gui thread (by a worker doing part
+// of a parallel project restore, say) has no dialog at all and is
+// never canceled.
 class altMeter {
  public:
   altMeter(const QString& labelText, const QString& cancelButtonText,
            int minimum, int maximum);
   ~altMeter() {
-    if (!groupDialog_) {
+    if (dialog_ && dialog_ != groupDialog_) {
       delete dialog_;
     }
   }
-  void setMinimumDuration(int min) { dialog_->setMinimumDuration(min); }
-  bool wasCanceled() const { return dialog_->wasCanceled(); }
+  void setMinimumDuration(int min) {
+    if (dialog_) {
+      dialog_->setMinimumDuration(min);
+    }
+  }
+  bool wasCanceled() const { return dialog_ && dialog_->wasCanceled(); }
   void setValue(int value) {
-    dialog_->setValue(value);
+    if (dialog_) {
+      dialog_->setValue(value);
+    }
   }
   void show() {
-    dialog_->show();
+    if (dialog_) {
+      dialog_->show();
+    }
   }
   // MUST NOT be called while any altMeter is active
   static void setGroupMeter(groupProgressDialog* meter) {
@@ -22,6 +22,7 @@
 #include <QtCore/QFileInfo>
 #include <QtCore/QSettings>
 #include <QtCore/QDateTime>
+#include <QtConcurrent/QtConcurrentMap>
 #include <QtConcurrent/QtConcurrentRun>
 
 #include <QtWidgets/QMenu>
@@ -34,7 +35,12 @@
 #include "fileListMenu.h"
 #include "imageUtility.h"
 #include "patternWindow.h"
+#include "projectReader.h"
+#include "projectRestore.h"
+#include "projectSnapshot.h"
 #include "squareWindow.h"
+#include "symbolChooser.h"
+#include "utility.h"
 #include "versionProcessing.h"
 #include "xmlUtility.h"
 
@@ -44,8 +50,13 @@ using Qt::endl;
 
 windowManager::windowManager() : originalImageColorCount_(0),
                                  projectFilename_(QString()),
+                                 projectSaveQueued_(false),
+                                 projectSaveJournalPosition_(-1),
                                  hideWindows_(false) {
 
+  connect(&projectSaveWatcher_, SIGNAL(finished()),
+          this, SLOT(projectSaveFinished()));
+
   const QString chooserText(tr("Color Chooser (1/4)"));
   const QString compareText(tr("Color compare (2/4)"));
   const QString squareText(tr("Square compare (3/4)"));
@@ -222,6 +233,25 @@ void windowManager::addColorCompareImage(const QImage& image,
   colorCompareSavers_.push_back(saver);
 }
 
+void windowManager::addLazyColorCompareImage(const QVector<triC>& colors,
+                                             flossType type,
+                                             const colorCompareSaver& saver,
+                                             int imageIndex,
+                                             int numImageColors) {
+
+  colorCompare* compareWindow = colorCompareWindow_.window();
+  if (compareWindow == NULL) {
+    // the image creating colorCompare is shown, so it can't wait
+    addColorCompareImage(::segmentedImage(originalImage_, colors,
+                                          numImageColors),
+                         colors, type, saver, imageIndex);
+    return;
+  }
+  colorCompareCount_.set(imageIndex + 1);
+  compareWindow->addLazyImage(imageIndex, colors, type, numImageColors);
+  colorCompareSavers_.push_back(saver);
+}
+
 static void reportMissingParent(const QString& parentContext, int parent,
                                 const QString& childContext, int child) {
 
@@ -374,6 +404,13 @@ void windowManager::saveAs(const QString projectFilename) {
       return;
     }
   }
+  // one save at a time: the queued save will pick up any changes made
+  // while this one was running
+  if (projectSaveWatcher_.isRunning()) {
+    projectSaveQueued_ = true;
+    activeWindow()->showTemporaryStatusMessage(tr("Saving project..."), 0);
+    return;
+  }
 
   QDomDocument doc;
   QDomElement root = doc.createElement("cstitch");
@@ -389,9 +426,10 @@ void windowManager::saveAs(const QString projectFilename) {
   // date
   ::appendTextElement(&doc, "date", QDateTime::currentDateTime().toString(),
                       &root);
-  // image color count
-  ::appendTextElement(&doc, "color_count",
-                      ::itoqs(getOriginalImageColorCount()), &root);
+  // image color count (filled in by the snapshot, since the count may
+  // still be being computed)
+  QDomElement colorCountElement(doc.createElement("color_count"));
+  root.appendChild(colorCountElement);
   // first write settings that are independent of any particular image
   QDomElement globals(doc.createElement("global_settings"));
   // a disabled window is one that doesn't have any images other than the
@@ -410,6 +448,8 @@ void windowManager::saveAs(const QString projectFilename) {
   }
 
   root.appendChild(globals);
+  // square histories are appended by the snapshot
+  QList<QPair<QDomElement, squareHistorySnapshot> > squareHistories;
   //// colorCompare
   if (!colorCompareSavers_.empty()) {
     QDomElement colorCompareElement = doc.createElement("color_compare");
@@ -438,9 +478,10 @@ void windowManager::saveAs(const QString projectFilename) {
           QDomElement thisSquareXml = thisSquareWindowSaver.toXml(&doc);
           squareWindowElement.appendChild(thisSquareXml);
           if (!thisSquareWindowSaver.hidden()) {
-            // append the current history for this child
-            squareWindowObject->writeCurrentHistory(&doc, &thisSquareXml,
-                                                    thisCompareChild);
+            // the current history for this child
+            squareHistories.
+              push_back(qMakePair(thisSquareXml, squareWindowObject->
+                                  currentHistorySnapshot(thisCompareChild)));
           }
           if (thisSquareWindowSaver.hasChildren()) {
             //// patternWindow
@@ -471,25 +512,61 @@ void windowManager::saveAs(const QString projectFilename) {
       }
     }
   }
-  QString xmlString = doc.toString(2);
-
-  // write the xml portion as text
-  QFile outFile(projectFilename_);
-  outFile.open(QIODevice::WriteOnly);
-  QTextStream textStream(&outFile);
-  textStream << xmlString << endl;
-  textStream.flush();
-  outFile.close();
-
-  // append the image as binary
-  outFile.open(QIODevice::Append);
-  QDataStream dataStream(&outFile);
-  dataStream << originalImageData_;
-  outFile.close();
-  setWindowTitles(QFileInfo(projectFilename_).fileName());
-  activeWindow()->showTemporaryStatusMessage(tr("Saved project to %1")
-                                             .arg(projectFilename_));
-  updateRecentFiles(projectFilename_, recentProjectsMenu_);
+
+  projectSnapshot snapshot(projectFilename_, doc, originalImageData_);
+  for (int i = 0, size = squareHistories.size(); i < size; ++i) {
+    snapshot.addSquareHistory(squareHistories[i].first,
+                              squareHistories[i].second);
+  }
+  // don't wait on the color count here (see getOriginalImageColorCount)
+  if (originalImageColorCount_ == 0 && !hideWindows_ &&
+      colorCountComputation_.isCanceled()) {
+    colorCountComputation_ = QtConcurrent::run(::numberOfColors,
+                                               originalImage_);
+  }
+  snapshot.setColorCount(colorCountElement, originalImageColorCount_,
+                         colorCountComputation_);
+
+  projectSaveFilename_ = projectFilename_;
+  projectSaveJournalPosition_ = journal_.position();
+  activeWindow()->showTemporaryStatusMessage(tr("Saving project..."), 0);
+  projectSaveWatcher_.setFuture(QtConcurrent::run(::writeProjectSnapshot,
+                                                  snapshot,
+                                                  static_cast<QObject*>(this)));
+}
+
+void windowManager::projectSaveProgress(int percent) {
+
+  if (projectSaveWatcher_.isRunning()) {
+    activeWindow()->
+      showTemporaryStatusMessage(tr("Saving project: %1%").arg(percent), 0);
+  }
+}
+
+void windowManager::projectSaveFinished() {
+
+  const QString error = projectSaveWatcher_.result();
+  if (error.isEmpty()) {
+    // (the user may have moved on to a new image or project meanwhile)
+    if (projectSaveFilename_ == projectFilename_) {
+      setWindowTitles(QFileInfo(projectSaveFilename_).fileName());
+      // the save holds everything journaled before it started
+      journal_.compact(projectSaveFilename_, projectSaveJournalPosition_);
+    }
+    activeWindow()->showTemporaryStatusMessage(tr("Saved project to %1")
+                                               .arg(projectSaveFilename_));
+    updateRecentFiles(projectSaveFilename_, recentProjectsMenu_);
+  }
+  else {
+    activeWindow()->showTemporaryStatusMessage("");
+    QMessageBox::critical(activeWindow(), tr("Save failed"),
+                          tr("The project couldn't be saved to %1:<br /><br />"
+                             "%2").arg(projectSaveFilename_).arg(error));
+  }
+  if (projectSaveQueued_) {
+    projectSaveQueued_ = false;
+    saveAs(projectFilename_);
+  }
 }
 
 void windowManager::openProject() {
@@ -527,76 +604,20 @@ static void reportCorruptProject(const QString& message) {
 
 bool windowManager::openProject(const QString& projectFile) {
 
-  QFile inFile(projectFile);
-  if (!inFile.open(QIODevice::ReadOnly)) {
-    QMessageBox::critical(NULL, tr("Bad project file"),
-                          tr("Sorry, %1 is not a valid project file "
-                             "(diagnostic: unable to open file)")
-                          .arg(projectFile));
-    return false;
-  }
-  // the save file starts with xml text, so read that first
-  QTextStream textInStream(&inFile);
-  QString inString;
-  inString = textInStream.readLine() + "\n";
-  // (A day after the initial release I changed the program name from
-  // stitch to cstitch, so check for either...)
-  QRegularExpression rx("^<(cstitch|stitch) version=");
-  QRegularExpressionMatch match = rx.match(inString);
-
-  const QString programName = match.captured(1);
-  if (programName != "cstitch" && programName != "stitch") { // uh oh
-    QMessageBox::critical(NULL, tr("Bad project file"),
-                          tr("Sorry, %1 is not a valid project file "
-                             "(diagnostic: wrong first line)")
-                          .arg(projectFile));
+  projectReader reader;
+  const QString readError = reader.read(projectFile);
+  if (!readError.isEmpty()) {
+    QMessageBox::critical(NULL, tr("Bad project file"), readError);
     return false;
   }
+  QDomDocument doc = reader.doc();
+  const QImage newImage = reader.image();
+  const QByteArray imageByteArray = reader.imageData();
 
-  const QString endTag = "</" + programName + ">";
-  QString thisString = "";
-  do {
-    thisString = textInStream.readLine();
-    if (thisString.isNull()) {
-      // oops, we missed the closing tag and read all the way to the end of the
-      // file...
-      QMessageBox::critical(NULL, tr("Bad project file"),
-                            tr("Sorry, %1 appears to be corrupted "
-                               "(diagnostic: can't find end of data)")
-                            .arg(projectFile));
-      return false;
-    }
-    inString += thisString + "\n";
-  } while (thisString != endTag);
-
-  QDomDocument doc;
-  const bool xmlLoadSuccess = doc.setContent(inString);
-  if (!xmlLoadSuccess) {
-    QMessageBox::critical(NULL, tr("Bad project file"),
-                          tr("Sorry, %1 appears to be corrupted "
-                             "(diagnostic: parse failed)")
-                          .arg(projectFile));
-    return false;
-  }
-  // a blank line between the xml and the image
-  inString += textInStream.readLine() + "\n";
-
-  // now read the binary data image
-  inFile.seek(inString.length());
-  QDataStream imageStream(&inFile);
-  QImage newImage;
-  imageStream >> newImage;
-  if (newImage.isNull()) {
-    QMessageBox::critical(NULL, tr("Bad project file"),
-                          tr("Sorry, %1 appears to be corrupted "
-                             "(diagnostic: empty image)")
-                          .arg(projectFile));
-    return false;
-  }
-  inFile.seek(inString.length());
-  QDataStream imageData(&inFile);
-  QByteArray imageByteArray;
-  imageData >> imageByteArray;
+  // we're abandoning the current project, so its unsaved edits go too;
+  // then apply the new project's unsaved edits (if any) to its xml
+  journal_.discard();
+  const int recoveredEdits = historyJournal::replay(projectFile, &doc);
 
   // hide everything except progress meters while we regenerate this project
   hideWindows_ = true;
@@ -622,17 +643,79 @@ bool windowManager::openProject(const QString& projectFile) {
   colorChooser_.window()->setNewImage(newImage);
   progressMeter.bumpCount();
 
+  // the number of colors in the original image (0 if it wasn't known
+  // when the project was saved)
+  const int colorCount = ::getElementText(doc, "color_count").toInt();
+
   //// colorCompare
   QDomElement colorCompareElement =
     doc.elementsByTagName("color_compare").item(0).toElement();
   if (!colorCompareElement.isNull()) {
-    colorChooser* colorChooserObject = colorChooser_.window();
     QDomNodeList compareImagesList(colorCompareElement.
                                    elementsByTagName("color_compare_image"));
+    //// phase one: regenerate the colorCompare images, and then the
+    //// squareWindow images from them, on the thread pool
+    const bool lazyRestore = QSettings("cstitch", "cstitch").
+      value("lazy_project_restore", false).toBool();
+    QVector<bool> lazyImages;
+    QList<segmentJob> segmentJobs;
+    for (int i = 0, size = compareImagesList.size(); i < size; ++i) {
+      QDomElement thisCompareElement(compareImagesList.item(i).toElement());
+      const colorCompareSaver saver(thisCompareElement);
+      // the first image creates colorCompare, and an image with children
+      // is needed now to restore them
+      const bool lazy = lazyRestore && i > 0 && !saver.hidden() &&
+        thisCompareElement.elementsByTagName("square_window_image").isEmpty();
+      lazyImages.push_back(lazy);
+      segmentJobs.push_back(lazy ? segmentJob() :
+                            segmentJob(originalImage_, saver.colors(),
+                                       colorCount));
+    }
+    progressMeter.setLabelText(tr("Recreating images..."));
+    QFutureWatcher<QImage> segmentWatcher;
+    segmentWatcher.setFuture(QtConcurrent::mapped(segmentJobs,
+                                                  ::runSegmentJob));
+    ::waitForFuture(&segmentWatcher, &progressMeter);
+    const QList<QImage> segmentedImages = segmentWatcher.future().results();
+
+    QList<squareJob> squareJobs;
+    for (int i = 0, size = compareImagesList.size(); i < size; ++i) {
+      QDomNodeList squareImagesList(compareImagesList.item(i).toElement().
+                                    elementsByTagName("square_window_image"));
+      for (int ii = 0, iiSize = squareImagesList.size(); ii < iiSize; ++ii) {
+        const squareWindowSaver saver(squareImagesList.item(ii).toElement());
+        const int squareMode =
+          colorCompare::savedSquareMode(saver.creationMode());
+        if (squareMode == -1) {
+          qWarning() << "Unrecognized squareModeString: \"" <<
+            saver.creationMode() << "\", index: " << saver.index() <<
+            "; things probably won't go well from here.";
+        }
+        squareJobs.push_back(squareJob(segmentedImages[i], originalImage_,
+                                       squareMode, saver.squareDimension()));
+      }
+    }
+    QFutureWatcher<squareJobResult> squareWatcher;
+    squareWatcher.setFuture(QtConcurrent::mapped(squareJobs,
+                                                 ::runSquareJob));
+    ::waitForFuture(&squareWatcher, &progressMeter);
+    const QList<squareJobResult> squaredImages =
+      squareWatcher.future().results();
+
+    //// phase two: add the images to their windows and restore histories
+    colorChooser* colorChooserObject = colorChooser_.window();
+    int squareJobIndex = 0;
     for (int i = 0, size = compareImagesList.size(); i < size; ++i) {
       QDomElement thisCompareElement(compareImagesList.item(i).toElement());
-      const int hiddenColorCompareIndex = colorChooserObject->
-        recreateImage(colorCompareSaver(thisCompareElement));
+      const colorCompareSaver compareSaver(thisCompareElement);
+      int hiddenColorCompareIndex = -1;
+      if (lazyImages[i]) {
+        colorChooserObject->recreateLazyImage(compareSaver, colorCount);
+      }
+      else {
+        hiddenColorCompareIndex =
+          colorChooserObject->recreateImage(compareSaver, segmentedImages[i]);
+      }
       progressMeter.bumpCount();
       //// squareWindow
       colorCompare* colorCompareObject = colorCompareWindow_.window();
@@ -641,8 +724,10 @@ bool windowManager::openProject(const QString& projectFile) {
       if (!squareImagesList.isEmpty()) {
         for (int ii = 0, iiSize = squareImagesList.size(); ii < iiSize; ++ii) {
           QDomElement thisSquareElement(squareImagesList.item(ii).toElement());
+          const squareJobResult& squared = squaredImages[squareJobIndex++];
           const int hiddenSquareImageIndex = colorCompareObject->
-            recreateImage(squareWindowSaver(thisSquareElement));
+            recreateImage(squareWindowSaver(thisSquareElement),
+                          squared.image(), squared.colors());
           progressMeter.bumpCount();
           squareWindow* squareWindowObject = squareWindow_.window();
           //// patternWindow
@@ -710,8 +795,6 @@ bool windowManager::openProject(const QString& projectFile) {
       reportCorruptProject(error);
     }
   }
-  // read the image number of colors (before the reset)
-  const int colorCount = ::getElementText(doc, "color_count").toInt();
   originalImageColorCount_ = colorCount;
   // call while hideWindows_ (if colorCount wasn't 0 it won't be recalculated)
   startOriginalImageColorCount();
@@ -720,12 +803,20 @@ bool windowManager::openProject(const QString& projectFile) {
   projectFilename_ = projectFile;
   setWindowTitles(QFileInfo(projectFilename_).fileName());
   setNewWidgetGeometryAndRaise(colorChooser_.window());
+  journal_.start(projectFilename_);
+  if (recoveredEdits > 0) {
+    activeWindow()->
+      showTemporaryStatusMessage(tr("Recovered %1 unsaved edit(s) from the "
+                                    "autosave journal")
+                                 .arg(recoveredEdits), 10000);
+  }
   return true;
 }
 
 void windowManager::reset(const QImage& image, const QByteArray& byteArray,
                           const QString& imageName) {
 
+  journal_.discard();
   projectFilename_ = QString();
   originalImage_ = image;
   originalImageData_ = byteArray;
@@ -1134,6 +1225,21 @@ void windowManager::updateRecentFiles(const QString& file,
 
 void windowManager::quit() {
 
+  // don't cut off a save in progress
+  projectSaveWatcher_.waitForFinished();
+  if (projectSaveQueued_) {
+    // the user saved again while that save was running; its finished()
+    // won't be delivered now, so finish it here, which starts the queued
+    // save, and then wait that one out and finish it too
+    disconnect(&projectSaveWatcher_, SIGNAL(finished()),
+               this, SLOT(projectSaveFinished()));
+    projectSaveFinished();
+    projectSaveWatcher_.waitForFinished();
+    projectSaveFinished();
+  }
+  symbolChooser::stopWarmingSymbols();
+  // the user has agreed to lose unsaved work
+  journal_.discard();
   QSettings settings("cstitch", "cstitch");
   settings.setValue("recent_images", recentImagesMenu_->files());
   settings.setValue("recent_projects", recentProjectsMenu_->files());
@@ -22,11 +22,13 @@
 
 #include <QtCore/QString>
 #include <QtCore/QFuture>
+#include <QtCore/QFutureWatcher>
 
 #include <QtWidgets/QWidget>
 #include <QtWidgets/QAction>
 
 #include "windowSavers.h"
+#include "historyJournal.h"
 
 class triC;
 class flossType;
@@ -152,6 +154,12 @@ class windowManager : public QObject {
   void addColorCompareImage(const QImage& image,
                             const QVector<triC>& colors, flossType type,
                             colorCompareSaver saver, int imageIndex = -1);
+  // like addColorCompareImage during a project restore, but <saver>'s
+  // image isn't computed (from the original and <colors>) until it's first
+  // viewed; <numImageColors> is the original image's color count if known
+  void addLazyColorCompareImage(const QVector<triC>& colors, flossType type,
+                                const colorCompareSaver& saver,
+                                int imageIndex, int numImageColors);
   // the color compare image with index <imageIndex> was deleted
   void colorCompareImageDeleted(int imageIndex);
   // add <image> with <colors> (all <dmc> or no) and square dimension
@@ -212,6 +220,8 @@ class windowManager : public QObject {
  public slots:
   // save all current data to file
   void save();
+  // saving happens in the background: a snapshot of the project is taken
+  // and written out on another thread, so the user can keep editing
   void saveAs(const QString projectFilename = QString());
   // reload a saved project from file specified by user
   void openProject();
@@ -292,6 +302,10 @@ class windowManager : public QObject {
   void openRecentImage(const QString& imageFile);
   // Open the project in the file <projectFile>.
   void openRecentProject(const QString& projectFile);
+  // show the progress of a background save in the status bar
+  void projectSaveProgress(int percent);
+  // a background save finished (successfully or not)
+  void projectSaveFinished();
 
  private:
   QByteArray originalImageData_; // the user's original image (as raw data)
@@ -306,6 +320,19 @@ class windowManager : public QObject {
   // the result of a "future" computation in a separate thread
   QFuture<int> colorCountComputation_;
   QString projectFilename_; // full path
+  // the background save in progress, if any; its result is an error
+  // message (empty on success)
+  QFutureWatcher<QString> projectSaveWatcher_;
+  // the file being saved to by projectSaveWatcher_
+  QString projectSaveFilename_;
+  // true if the user saved again while a save was in progress (we'll save
+  // again when the current one finishes)
+  bool projectSaveQueued_;
+  // the journal position at the time the running save's snapshot was
+  // taken
+  qint64 projectSaveJournalPosition_;
+  // the autosave journal of edits made since the project was last saved
+  historyJournal journal_;
 
   // all main windows share the same geometry
   QRect currentGeometry_;